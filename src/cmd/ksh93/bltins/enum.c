@@ -277,21 +277,60 @@ static_fn int sh_outenum(Shell_t *shp, Sfio_t *iop, Namval_t *tp) {
     return 0;
 }
 
-int b_enum(int argc, char **argv, Shbltin_t *context) {
-    bool pflag = false, iflag = false;
-    int i, n;
-    ssize_t sz = -1;
-    Namval_t *np, *tp, *mp;
-    Namarr_t *ap;
-    char *cp;
-    const char *sp;
+//
+// Make the type <tp> from the values of the indexed array <np>.
+//
+void sh_mkenum(Shell_t *shp, Namval_t *np, Namval_t *tp, bool iflag) {
+    Namarr_t *ap = nv_arrayptr(np);
+    Namval_t *mp;
     struct Enum *ep;
-    Shell_t *shp = context->shp;
+    int i = 0, n = ap->nelem;
     struct {
         Optdisc_t opt;
         Namval_t *np;
     } optdisc;
 
+    nv_onattr(tp, NV_UINT16);
+    nv_putval(tp, (char *)&i, NV_INTEGER);
+    ep = calloc(1, sizeof(struct Enum));
+    if (!ep) {
+        error(ERROR_system(1), "out of space");
+        __builtin_unreachable();
+    }
+    ep->nelem = n;
+    mp = nv_namptr(ep->node, 0);
+    mp->nvshell = shp;
+    nv_setsize(mp, 10);
+    nv_onattr(mp, NV_UINT16);
+    ep->iflag = iflag;
+
+    ep->values = malloc(n * sizeof(*ep->values));
+    nv_putsub(np, NULL, 0L, ARRAY_SCAN);
+    do {
+        ep->values[i++] = strdup(nv_getval(np));
+    } while (nv_nextsub(np));
+    assert(n == i);
+
+    ep->namfun.dsize = sizeof(struct Enum);
+    ep->namfun.disc = &ENUM_disc;
+    ep->namfun.type = tp;
+    nv_onattr(tp, NV_RDONLY);
+    nv_disc(tp, &ep->namfun, DISC_OP_FIRST);
+    memset(&optdisc, 0, sizeof(optdisc));
+    optdisc.opt.infof = enuminfo;
+    optdisc.np = tp;
+    nv_addtype(tp, enum_type, &optdisc, sizeof(optdisc));
+    nv_onattr(np, NV_LTOU | NV_UTOL);
+}
+
+int b_enum(int argc, char **argv, Shbltin_t *context) {
+    bool pflag = false, iflag = false;
+    int n;
+    Namval_t *np, *tp;
+    Namarr_t *ap;
+    char *cp;
+    Shell_t *shp = context->shp;
+
     if (cmdinit(argc, argv, context, ERROR_NOTIFY)) return -1;
     while ((n = optget(argv, enum_usage))) {
         switch (n) {  //!OCLINT(MissingDefaultStatement)
@@ -334,45 +373,7 @@ int b_enum(int argc, char **argv, Shbltin_t *context) {
             continue;
         }
         stkseek(shp->stk, n);
-        n = ap->nelem;
-        i = 0;
-        nv_onattr(tp, NV_UINT16);
-        nv_putval(tp, (char *)&i, NV_INTEGER);
-        nv_putsub(np, NULL, 0L, ARRAY_SCAN);
-        do {
-            sz += strlen(nv_getval(np));
-        } while (nv_nextsub(np));
-        ep = calloc(1, sizeof(struct Enum));
-        if (!ep) {
-            error(ERROR_system(1), "out of space");
-            __builtin_unreachable();
-        }
-        ep->nelem = n;
-        mp = nv_namptr(ep->node, 0);
-        mp->nvshell = shp;
-        nv_setsize(mp, 10);
-        nv_onattr(mp, NV_UINT16);
-        ep->iflag = iflag;
-
-        ep->values = malloc(n * sizeof(*ep->values));
-        nv_putsub(np, NULL, 0L, ARRAY_SCAN);
-        i = 0;
-        do {
-            sp = nv_getval(np);
-            ep->values[i++] = strdup(sp);
-        } while (nv_nextsub(np));
-        assert(n == i);
-
-        ep->namfun.dsize = sizeof(struct Enum);
-        ep->namfun.disc = &ENUM_disc;
-        ep->namfun.type = tp;
-        nv_onattr(tp, NV_RDONLY);
-        nv_disc(tp, &ep->namfun, DISC_OP_FIRST);
-        memset(&optdisc, 0, sizeof(optdisc));
-        optdisc.opt.infof = enuminfo;
-        optdisc.np = tp;
-        nv_addtype(tp, enum_type, &optdisc, sizeof(optdisc));
-        nv_onattr(np, NV_LTOU | NV_UTOL);
+        sh_mkenum(shp, np, tp, iflag);
     }
     nv_open(0, shp->var_tree, 0);
     return error_info.errors != 0;
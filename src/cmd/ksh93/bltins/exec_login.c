@@ -134,6 +134,8 @@ int B_login(int argc, char *argv[], Shbltin_t *context) {
         pp->mode = SH_JMPEXIT;
         sh_sigreset(shp, 2);
         sh_freeup(shp);
+        sh_profdone(shp);
+        sh_statdump(shp);
         path_exec(shp, pname, argv, NULL);
         sh_done(shp, 0);
     }
@@ -607,7 +607,14 @@ static_fn ssize_t fmtbase64(Shell_t *shp, Sfio_t *iop, char *string, const char
     if (fmt && strncmp(fmt, "json", 4) == 0) nv_onattr(np, NV_JSON);
 #endif
     if (*string == '.') shp->namespace = NULL;
-    cp = nv_getval(np);
+    if (nv_isvtree(np) && nv_outvtree(np, iop)) {
+        // The compound variable was written as it was walked.
+        cp = NULL;
+        size = sftell(iop);
+    } else {
+        cp = nv_getval(np);
+        size = 0;
+    }
     if (*string == '.') shp->namespace = nspace;
     if (alt == 1) {
         nv_offattr(np, NV_EXPORT);
@@ -618,7 +625,7 @@ static_fn ssize_t fmtbase64(Shell_t *shp, Sfio_t *iop, char *string, const char
     }
 #endif
 
-    if (!cp) return 0;
+    if (!cp) return size;
     size = strlen(cp);
     return sfwrite(iop, cp, size);
 #else   // 1
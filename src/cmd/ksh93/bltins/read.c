@@ -79,132 +79,8 @@ struct Method {
     void *fun;
 };
 
-// Support for json in `read` builtin seems very unstable, so this code is kept disabled.
-// See https://github.com/att/ast/issues/820
-#if SUPPORT_JSON
-static_fn int json2sh(Shell_t *shp, Sfio_t *in, Sfio_t *out) {
-    int c, state = 0, lastc = 0, level = 0, line = 1;
-    size_t here, offset = stktell(shp->stk);
-    char *start;
-    bool isname, isnull = false;
-
-    while ((c = sfgetc(in)) > 0) {
-        if (c == '\n') line++;
-        if (state == 0) {
-            switch (c) {
-                case '\t':
-                case ' ': {
-                    if (lastc == ' ' || lastc == '\t') continue;
-                    break;
-                }
-                case ',': {
-                    continue;
-                }
-                case '[':
-                case '{': {
-                    c = '(';
-                    level++;
-                    break;
-                }
-                case ']':
-                case '}': {
-                    c = ')';
-                    level--;
-                    break;
-                }
-                case '"': {
-                    state = 1;
-                    isname = true;
-                    sfputc(shp->stk, c);
-                    continue;
-                }
-                default: { break; }
-            }
-            sfputc(out, c);
-            if (level == 0) break;
-        } else if (state == 1) {
-            if (c == '"' && lastc != '\\') {
-                state = 2;
-            } else if (state == 1 && !isalnum(c) && c != '_') {
-                isname = false;
-            }
-            sfputc(shp->stk, c);
-        } else if (state == 2) {
-            if (c == ' ' || c == '\t') continue;
-            if (c == ':') {
-                int len;
-                while ((c = sfgetc(in)) && iswblank(c)) {
-                    ;  // empty loop
-                }
-                sfungetc(in, c);
-                if (!strchr("[{,\"", c)) {
-                    if (isdigit(c) || c == '.' || c == '-') {
-                        sfwrite(out, "float ", 6);
-                    } else if (c == 't' || c == 'f') {
-                        sfwrite(out, "bool ", 5);
-                    } else if (c == 'n') {
-                        char buff[4];
-                        isnull = true;
-                        sfread(in, buff, 4);
-                        sfwrite(out, "typeset  ", 8);
-                    }
-                }
-                start = stkptr(shp->stk, offset);
-                here = stktell(shp->stk);
-                if (isname && !iswalpha(*(start + 1)) && c != '_') isname = false;
-                len = here - offset - 2;
-                if (!isname) {
-                    char *sp;
-                    sfwrite(out, ".[", 2);
-                    for (sp = start + 1; len-- > 0; sp++) {
-                        if (*sp == '$') {
-                            if (sp > start + 1) sfwrite(out, start, sp - start);
-                            sfputc(out, '\\');
-                            sfputc(out, '$');
-                            start = sp;
-                        }
-                    }
-                    len = (sp - start) - 1;
-                }
-                sfwrite(out, start + 1, len);
-                if (!isname) sfputc(out, ']');
-                if (isnull) {
-                    isnull = false;
-                } else {
-                    sfputc(out, '=');
-                }
-                stkseek(shp->stk, offset);
-                if (c == '{') c = ' ';
-            }
-            if (c == ',' || c == '\n' || c == '}' || c == ']' || c == '{') {
-                start = stkptr(shp->stk, offset);
-                here = stktell(shp->stk);
-                if (here > 1) {
-                    *stkptr(shp->stk, here - 1) = 0;
-                    stresc(start + 1);
-                    sfputr(out, sh_fmtq(start + 1), -1);
-                    stkseek(shp->stk, offset);
-                }
-                if (c == '{') {
-                    sfputc(out, '=');
-                } else {
-                    sfputc(out, ' ');
-                }
-                if (c == '}' || c == ']' || c == '{') sfungetc(in, c);
-            }
-            c = ' ';
-            state = 0;
-        }
-        lastc = c;
-    }
-    return 0;
-}
-#endif
-
 static struct Method methods[] = {
-#if SUPPORT_JSON
-    {"json", json2sh},
-#endif
+    {"json", sh_readjson},
     {"ksh", NULL},
     {NULL, NULL}};
 
@@ -279,13 +155,11 @@ int b_read(int argc, char *argv[], Shbltin_t *context) {
                 }
                 break;
             }
-#if SUPPORT_JSON
             case 'm': {
                 method = opt_info.arg;
                 flags |= C_FLAG;
                 break;
             }
-#endif
             case 'n':
             case 'N': {
                 flags &= ((1 << D_FLAG) - 1);
@@ -466,9 +340,7 @@ int sh_readline(Shell_t *shp, char **names, void *readfn, volatile int fd, int f
         if (flags & C_FLAG) oflags |= NV_ARRAY;
         np = nv_open(name, shp->var_tree, oflags);
         if (np && nv_isarray(np) && (mp = nv_opensub(np))) np = mp;
-        if ((flags & V_FLAG) && shp->gd->ed_context) {
-            ((struct edit *)shp->gd->ed_context)->e_default = np;
-        }
+        if (flags & V_FLAG) (ep = ed_getcontext())->e_default = np;
         if (flags & A_FLAG) {
             Namarr_t *ap;
             flags &= ~A_FLAG;
@@ -502,6 +374,7 @@ int sh_readline(Shell_t *shp, char **names, void *readfn, volatile int fd, int f
         if ((shp->fdstatus[fd] & IOTTY) && !keytrap) tty_raw(sffileno(iop), 1);
         if (!(flags & (N_FLAG | NN_FLAG))) {
             delim = ((unsigned)flags) >> (D_FLAG + 1);
+            ep = ed_getcontext();
             ep->e_nttyparm.c_cc[VEOL] = delim;
             ep->e_nttyparm.c_lflag |= ISIG;
             tty_set(sffileno(iop), TCSADRAIN, &ep->e_nttyparm);
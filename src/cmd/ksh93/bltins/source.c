@@ -113,7 +113,9 @@ int b_source(int n, char *argv[], Shbltin_t *context) {
         }
     }
     *prevscope = shp->st;
-    shp->st.lineno = np ? ((struct functnod *)nv_funtree(np))->functline : 1;
+    // A POSIX function gets its own scope, so the caller keeps its function name.
+    if (np) shp->st.funname = nv_name(np);
+    shp->st.lineno = np ? ((struct functnod *)sh_funtree(shp, np))->functline : 1;
     shp->st.var_local = shp->st.save_tree = shp->var_tree;
     if (filename) {
         shp->st.filename = filename;
@@ -137,9 +139,10 @@ int b_source(int n, char *argv[], Shbltin_t *context) {
     if (jmpval == 0) {
         shp->dot_depth++;
         if (np) {
-            sh_exec(shp, (Shnode_t *)(nv_funtree(np)), sh_isstate(shp, SH_ERREXIT));
+            sh_exec(shp, sh_funtree(shp, np), sh_isstate(shp, SH_ERREXIT));
         } else {
             buffer = malloc(IOBSIZE + 1);
+            fd = sh_pcopen(shp, fd, filename);
             iop = sfnew(NULL, buffer, IOBSIZE, fd, SF_READ);
             sh_offstate(shp, SH_NOFORK);
             sh_eval(shp, iop, sh_isstate(shp, SH_PROFILE) ? SH_FUNEVAL : 0);
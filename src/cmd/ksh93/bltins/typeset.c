@@ -572,11 +572,13 @@ static_fn void print_value(Sfio_t *iop, Namval_t *np, struct tdata *tp) {
     if (nv_isarray(np) && nv_arrayptr(np)) {
         nv_outnode(np, iop, -1, 0);
         sfwrite(iop, ")\n", 2);
+    } else if (nv_isvtree(np)) {
+        nv_onattr(np, NV_EXPORT);
+        if (!nv_outvtree(np, iop) && (name = nv_getval(np))) sfputr(iop, name, -1);
+        sfputc(iop, '\n');
     } else {
-        if (nv_isvtree(np)) nv_onattr(np, NV_EXPORT);
         if (!(name = nv_getval(np))) name = Empty;
-        if (!nv_isvtree(np)) name = sh_fmtq(name);
-        sfputr(iop, name, '\n');
+        sfputr(iop, sh_fmtq(name), '\n');
     }
 }
 
@@ -957,6 +959,17 @@ Shbltin_f sh_getlib(Shell_t *shp, char *sym, Pathcomp_t *pp) {
     return 0;
 }
 
+//
+// Point the plugin index of libdll at the file named by KSH_PLUGININDEX, or turn it off if that is
+// unset or is not an absolute pathname.
+//
+void sh_pluginindex(Shell_t *shp) {
+    Namval_t *np = nv_search("KSH_PLUGININDEX", shp->var_tree, 0);
+    char *file = np ? nv_getval(np) : NULL;
+
+    dllindex(file && *file == '/' ? file : NULL);
+}
+
 //
 // Add change or list built-ins. Adding builtins requires dlopen() interface.
 //
@@ -1039,6 +1052,7 @@ int b_builtin(int argc, char *argv[], Shbltin_t *context) {
     }
 
     if (arg) {
+        sh_pluginindex(tdata.sh);
         if (!(library = dllplugin(SH_ID, arg, NULL, SH_PLUGIN_VERSION, &ver, RTLD_LAZY, path,
                                   sizeof(path)))) {
             errormsg(SH_DICT, ERROR_exit(0), "%s: %s", arg, dllerror(0));
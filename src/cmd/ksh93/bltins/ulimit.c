@@ -157,6 +157,8 @@ int b_ulimit(int argc, char *argv[], Shbltin_t *context) {
                     errormsg(SH_DICT, ERROR_system(1), e_overlimit, limit);
                     __builtin_unreachable();
                 }
+                // The fork server has the old limits.
+                sh_forksrv_stop(shp);
             }
         } else {
             if (!nosupport) {
@@ -134,12 +134,17 @@ const Shtable_t shtab_stats[] = {{"arg_cachehits", NV_RDONLY | NV_MINIMAL | NV_N
                                  {"forks", NV_RDONLY | NV_MINIMAL | NV_NOFREE | NV_INTEGER},
                                  {"funcalls", NV_RDONLY | NV_MINIMAL | NV_NOFREE | NV_INTEGER},
                                  {"globs", NV_RDONLY | NV_MINIMAL | NV_NOFREE | NV_INTEGER},
+                                 {"heredocs", NV_RDONLY | NV_MINIMAL | NV_NOFREE | NV_INTEGER},
                                  {"linesread", NV_RDONLY | NV_MINIMAL | NV_NOFREE | NV_INTEGER},
                                  {"nv_cachehit", NV_RDONLY | NV_MINIMAL | NV_NOFREE | NV_INTEGER},
                                  {"nv_opens", NV_RDONLY | NV_MINIMAL | NV_NOFREE | NV_INTEGER},
+                                 {"nv_stralloc", NV_RDONLY | NV_MINIMAL | NV_NOFREE | NV_INTEGER},
+                                 {"nv_strreuse", NV_RDONLY | NV_MINIMAL | NV_NOFREE | NV_INTEGER},
                                  {"pathsearch", NV_RDONLY | NV_MINIMAL | NV_NOFREE | NV_INTEGER},
                                  {"posixfuncall", NV_RDONLY | NV_MINIMAL | NV_NOFREE | NV_INTEGER},
+                                 {"regcomps", NV_RDONLY | NV_MINIMAL | NV_NOFREE | NV_INTEGER},
                                  {"simplecmds", NV_RDONLY | NV_MINIMAL | NV_NOFREE | NV_INTEGER},
                                  {"spawns", NV_RDONLY | NV_MINIMAL | NV_NOFREE | NV_INTEGER},
                                  {"subshell", NV_RDONLY | NV_MINIMAL | NV_NOFREE | NV_INTEGER},
+                                 {"waits", NV_RDONLY | NV_MINIMAL | NV_NOFREE | NV_INTEGER},
                                  {"", 0}};
@@ -86,7 +86,7 @@ static const char bellchr[] = "\a";  // bell char
 // This routine returns true if fd refers to a terminal. This should be equivalent to isatty.
 //
 int tty_check(int fd) {
-    Edit_t *ep = shgd->ed_context;
+    Edit_t *ep = ed_getcontext();
     struct termios tty;
     ep->e_savefd = -1;
     return tty_get(fd, &tty) == 0;
@@ -97,7 +97,7 @@ int tty_check(int fd) {
 // if it is called again without an intervening tty_set().
 //
 int tty_get(int fd, struct termios *tty) {
-    Edit_t *ep = shgd->ed_context;
+    Edit_t *ep = ed_getcontext();
 
     if (fd == ep->e_savefd) {
         *tty = ep->e_savetty;
@@ -119,7 +119,7 @@ int tty_get(int fd, struct termios *tty) {
 // Set the terminal attributes. If fd<0, then current attributes are invalidated.
 //
 int tty_set(int fd, int action, struct termios *tty) {
-    Edit_t *ep = shgd->ed_context;
+    Edit_t *ep = ed_getcontext();
 
     if (fd >= 0) {
 #if 0
@@ -142,6 +142,8 @@ int tty_set(int fd, int action, struct termios *tty) {
 void tty_cooked(int fd) {
     Edit_t *ep = shgd->ed_context;
 
+    if (!ep) return;  // the terminal was never put in raw mode
+
     if (ep->sh->st.trap[SH_KEYTRAP] && savelex) {
         memcpy(ep->sh->lex_context, savelex, ep->sh->lexsize);
     }
@@ -159,7 +161,7 @@ void tty_cooked(int fd) {
 //
 int tty_raw(int fd, int echomode) {
     int echo = echomode;
-    Edit_t *ep = shgd->ed_context;
+    Edit_t *ep = ed_getcontext();
 
     if (ep->e_raw == RAWMODE) {
         return echo ? -1 : 0;
@@ -1086,7 +1088,9 @@ static int ed_histlencopy(const char *cp, char *dp) {
     int c, n = 1, col = 1;
     const char *oldcp = cp;
 
-    for (n = 0; (c = mb1char((char **)&cp)); oldcp = cp, col++) {
+    // Bytes below 0x80 are characters by themselves, so they are not passed to mbtowc().
+    for (n = 0; (c = (*(unsigned char *)cp < 0x80 ? *cp++ : mb1char((char **)&cp)));
+         oldcp = cp, col++) {
         if (c == '\n' && *cp) {
             n += 2;
             if (dp) {
@@ -1112,8 +1116,9 @@ int ed_histgen(Edit_t *ep, const char *pattern) {
     History_t *hp;
     off_t offset;
     int ac = 0, l, n, index1, index2;
-    size_t m;
+    size_t m, len;
     char *cp, **argv = NULL, **av, **ar;
+    const char *prefix;
     static int maxmatch;
 
     if (!(hp = ep->sh->gd->hist_ptr) && (!nv_getval(HISTFILE) || !sh_histinit(ep->sh))) return 0;
@@ -1126,6 +1131,12 @@ int ed_histgen(Edit_t *ep, const char *pattern) {
     }
     hp = ep->sh->gd->hist_ptr;
     if (*pattern == '#' && *++pattern == '#') return 0;
+    // Commands that do not start with the literal part of the pattern are skipped without calling
+    // strmatch(), which is not needed at all when the whole pattern is literal. The pattern is
+    // matched as @(pattern)*, so with an alternative in it a command can start with anything.
+    prefix = pattern;
+    len = strcspn(prefix, "*?[]()|&!@+{}~\\");
+    if (strpbrk(prefix + len, "|&")) len = 0;
     cp = stkalloc(ep->sh->stk, m = strlen(pattern) + 6);
     sfsprintf(cp, m, "@(%s)*%c", pattern, 0);
     if (ep->hlist) {
@@ -1133,7 +1144,10 @@ int ed_histgen(Edit_t *ep, const char *pattern) {
         if (strncmp(pattern, ep->hpat + 2, m) == 0) {
             n = strcmp(cp, ep->hpat) == 0;
             for (argv = av = (char **)ep->hlist, mp = ep->hfirst; mp; mp = mp->next) {
-                if (n || strmatch(mp->data, cp)) *av++ = (char *)mp;
+                if (n || (prefix[len] ? strmatch(mp->data, cp)
+                                      : strncmp(mp->data, prefix, len) == 0)) {
+                    *av++ = (char *)mp;
+                }
             }
             *av = 0;
             ep->hmax = av - argv;
@@ -1149,10 +1163,13 @@ int ed_histgen(Edit_t *ep, const char *pattern) {
     index1 = (int)hp->histind;
     for (index2 = index1 - hp->histsize; index1 > index2; index1--) {
         offset = hist_tell(hp, index1);
-        sfseek(hp->histfp, offset, SEEK_SET);
-        if (!(cp = sfgetr(hp->histfp, 0, 0))) continue;
+        if (!(cp = hist_text(hp, offset))) {
+            sfseek(hp->histfp, offset, SEEK_SET);
+            if (!(cp = sfgetr(hp->histfp, 0, 0))) continue;
+        }
         if (*cp == '#') continue;
-        if (strmatch(cp, pattern)) {
+        if (strncmp(cp, prefix, len) != 0) continue;
+        if (!prefix[len] || strmatch(cp, pattern)) {
             l = ed_histlencopy(cp, NULL);
             mp = stkalloc(ep->sh->stk, sizeof(Histmatch_t) + l);
             mp->next = mplast;
@@ -1249,6 +1266,15 @@ Edit_t *ed_open(Shell_t *shp) {
     return ed;
 }
 
+//
+// Return the line editor context. It is opened when first needed so that shells which never touch
+// a terminal don't set it up.
+//
+Edit_t *ed_getcontext(void) {
+    if (!shgd->ed_context) shgd->ed_context = ed_open(sh_getinterp());
+    return shgd->ed_context;
+}
+
 #undef tcgetattr
 int sh_tcgetattr(int fd, struct termios *tty) {
     int r, err = errno;
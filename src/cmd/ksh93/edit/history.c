@@ -28,6 +28,7 @@
 #include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -60,6 +61,7 @@ int _Hist = 0;
 static void hist_marker(char *, long);
 static History_t *hist_trim(History_t *, int);
 static int hist_nearend(History_t *, Sfio_t *, off_t);
+static void hist_load(History_t *, int);
 static int hist_check(int);
 static int hist_clean(int);
 #ifdef SF_BUFCONST
@@ -105,7 +107,8 @@ static void hist_touch(void *handle) { tvtouch(handle, NULL, NULL, NULL, 0); }
 
 //
 // Open the history file. If HISTNAME is not given and userid==0 then no history file. If login_sh
-// and HISTFILE is longer than HIST_MAX bytes then it is cleaned up.
+// and HISTFILE is longer than HIST_MAX bytes and holds more than twice the number of commands kept
+// then it is cleaned up.
 //
 // hist_open() returns 1, if history file is opened.
 //
@@ -195,7 +198,7 @@ retry:
     hp->histsize = maxlines;
     hp->histmask = histmask;
     hp->histfp = sfnew(NULL, NULL, HIST_BSIZE, fd, SF_READ | SF_WRITE | SF_APPENDWR | SF_SHARE);
-    hp->histind = 1;
+    hp->histind = hp->histfirst = 1;
     hp->histcmds[1] = 2;
     hp->histcnt = 2;
     hp->histname = strdup(histname);
@@ -205,33 +208,24 @@ retry:
         sfwrite(hp->histfp, (char *)hist_stamp, 2);
         sfsync(hp->histfp);
     } else {
-        // Initialize history list.
-        int first, last;
-        off_t mark, size = (HIST_MAX / 4) + maxlines * HIST_LINE;
+        // Initialize history list from the last few hundred commands. The offsets of older
+        // commands are found by hist_load() when they are first asked for.
+        int first;
+        off_t size = (HIST_MAX / 4) + (maxlines < HIST_DFLT ? maxlines : HIST_DFLT) * HIST_LINE;
         hp->histind = first = hist_nearend(hp, hp->histfp, hsize - size);
+        hp->histcmds[hist_ind(hp, first)] = hp->histcnt;
         histinit = 1;
         hist_eof(hp);  // this sets histind to last command
-        if ((hist_start = (last = (int)hp->histind) - maxlines) <= 0) hist_start = 1;
-        mark = hp->histmarker;
-        while (first > hist_start) {
-            size += size;
-            first = hist_nearend(hp, hp->histfp, hsize - size);
-            hp->histind = first;
-        }
-        histinit = hist_start;
-        hist_eof(hp);
-        if (!histinit) {
-            sfseek(hp->histfp, hp->histcnt = hsize, SEEK_SET);
-            hp->histind = last;
-            hp->histmarker = mark;
-        }
         histinit = 0;
+        if (first < (int)hp->histind - hp->histmask) first = (int)hp->histind - hp->histmask;
+        hp->histfirst = first;
+        if ((hist_start = (int)hp->histind - maxlines) <= 0) hist_start = 1;
     }
     if (fname) {
         unlink(fname);
         free(fname);
     }
-    if (hist_clean(fd) && hist_start > 1 && hsize > HIST_MAX) {
+    if (hist_clean(fd) && hist_start > maxlines && hsize > HIST_MAX) {
 #ifdef DEBUG
         sfprintf(sfstderr, "%d: hist_trim hsize=%d\n", getpid(), hsize);
         sfsync(sfstderr);
@@ -271,6 +265,7 @@ retry:
 //
 void hist_close(History_t *hp) {
     sfclose(hp->histfp);
+    free(hp->histtext);
     if (hp->auditfp) {
         if (hp->tty) free(hp->tty);
         sfclose(hp->auditfp);
@@ -387,6 +382,7 @@ static History_t *hist_trim(History_t *hp, int n) {
     }
     hist_cancel(hist_new);
     sfclose(hist_old->histfp);
+    free(hist_old->histtext);
     if (tmpname) {
         unlink(tmpname);
         free(tmpname);
@@ -410,7 +406,7 @@ static int hist_nearend(History_t *hp, Sfio_t *iop, off_t size) {
     // Skip to marker command and return the number. Numbering commands occur after a null and begin
     // with HIST_CMDNO.
     while (true) {
-        cp = buff = (unsigned char *)sfreserve(iop, SF_UNBOUND, SF_LOCKR | SF_WRITE);
+        cp = buff = (unsigned char *)sfreserve(iop, SF_UNBOUND, SF_LOCKR);
         if (!cp) break;
 
         n = sfvalue(iop);
@@ -454,6 +450,77 @@ begin:
     return 1;
 }
 
+//
+// Count the commands in the <size> bytes at <buff>, which start at a command boundary at byte
+// <offset> of the history file, the way hist_eof() does. Numbering the commands from <n>, the
+// offsets of those numbered <least> or more are put into the in-core table.
+//
+static int hist_scan(History_t *hp, char *buff, size_t size, off_t offset, int n, int least) {
+    char *cp = buff, *endbuff = buff + size;
+    int count = 0;
+
+    while (cp < endbuff) {
+        if (cp + 1 < endbuff && cp[1] == 0) {
+            if (*(unsigned char *)cp == HIST_CMDNO) {
+                cp += HIST_MARKSZ;
+                continue;
+            }
+            if (*(unsigned char *)cp == HIST_UNDO) {
+                if (count > 0) count--;
+                cp += 2;
+                continue;
+            }
+        }
+        if (n + count >= least) hp->histcmds[hist_ind(hp, n + count)] = offset + (cp - buff);
+        count++;
+        if (*(unsigned char *)cp == HIST_CMDNO || *(unsigned char *)cp == HIST_UNDO) {
+            cp++;
+            continue;
+        }
+        cp += strnlen(cp, endbuff - cp);
+        while (cp < endbuff && *cp == 0) cp++;
+    }
+    return count;
+}
+
+//
+// Fill in the in-core table from command <n> up to the oldest command already in it. The offsets
+// are found by reading forward from a command number marker far enough back to reach <n>, so that
+// only the tail of a large history file has to be read when it is opened.
+//
+static void hist_load(History_t *hp, int n) {
+    int least = hist_min(hp), first = hp->histfirst, count = 0;
+    off_t end = hp->histcmds[hist_ind(hp, first)], start = end;
+    off_t cnt = hp->histcnt, marker = hp->histmarker;
+    off_t size = HIST_BSIZE + (off_t)(first - n) * HIST_LINE;
+    char *buff = NULL;
+
+    if (n < least) n = least;
+    if (n >= first) return;
+    while (start > 2) {
+        hist_nearend(hp, hp->histfp, end - size);
+        start = hp->histcnt;
+        size += size;
+        if (start >= end) continue;
+        free(buff);
+        buff = malloc(end - start);
+        if (!buff || sfread(hp->histfp, buff, end - start) != end - start) {
+            free(buff);
+            buff = NULL;
+            break;
+        }
+        count = hist_scan(hp, buff, end - start, start, 0, INT_MAX);
+        if (first - count <= n) break;
+    }
+    if (buff) {
+        hist_scan(hp, buff, end - start, start, first - count, least);
+        free(buff);
+        hp->histfirst = start > 2 && first - count > least ? first - count : least;
+    }
+    hp->histcnt = cnt;
+    hp->histmarker = marker;
+}
+
 //
 // This routine reads the history file from the present position to the end-of-file and puts the
 // information in the in-core history table. Note that HIST_CMDNO is only recognized at the
@@ -473,6 +540,8 @@ void hist_eof(History_t *hp) {
         last = -1;
         count = 2 + HIST_MARKSZ;
         if ((hp->histind -= hp->histsize) < 0) hp->histind = 1;
+        hp->histfirst = hp->histind + 1;
+        hp->histtextlen = 0;
     }
 
 again:
@@ -508,7 +577,7 @@ again:
                             if (!histinit && (cp <= endbuff)) {
                                 unsigned char *marker = (unsigned char *)(cp - 4);
                                 hp->histind =
-                                    ((marker[0] << 16) | (marker[1] << 8) | (marker[2] - 1));
+                                    ((marker[0] << 16) | (marker[1] << 8) | marker[2]) - 1;
                             }
                         }
                         break;
@@ -690,12 +759,16 @@ static void hist_marker(char *buff, long cmdno) {
 //
 // Return byte offset in history file for command <n>.
 //
-off_t hist_tell(History_t *hp, int n) { return hp->histcmds[hist_ind(hp, n)]; }
+off_t hist_tell(History_t *hp, int n) {
+    if (n < hp->histfirst) hist_load(hp, n);
+    return hp->histcmds[hist_ind(hp, n)];
+}
 
 //
 // Seek to the position of command <n>.
 //
 off_t hist_seek(History_t *hp, int n) {
+    if (n < hp->histfirst) hist_load(hp, n);
     return sfseek(hp->histfp, hp->histcmds[hist_ind(hp, n)], SEEK_SET);
 }
 
@@ -784,11 +857,17 @@ int hist_match(History_t *hp, off_t offset, char *string, int *coffset) {
     char *first, *cp;
     int m, n, c = 1, line = 0;
 
-    sfseek(hp->histfp, offset, SEEK_SET);
-    cp = first = sfgetr(hp->histfp, 0, 0);
-    if (!cp) return -1;
-    m = sfvalue(hp->histfp);
     n = (int)strlen(string);
+    cp = first = hist_text(hp, offset);
+    if (cp) {
+        if (coffset ? !strstr(cp, string) : strncmp(cp, string, n)) return -1;
+        m = (int)strlen(cp) + 1;
+    } else {
+        sfseek(hp->histfp, offset, SEEK_SET);
+        cp = first = sfgetr(hp->histfp, 0, 0);
+        if (!cp) return -1;
+        m = sfvalue(hp->histfp);
+    }
     while (m > n) {
         if (*cp == *string && strncmp(cp, string, n) == 0) {
             if (coffset) *coffset = (cp - first);
@@ -804,6 +883,37 @@ int hist_match(History_t *hp, off_t offset, char *string, int *coffset) {
     return -1;
 }
 
+//
+// Return the text of the command at <offset> from a copy of the accessible commands that is kept
+// in memory for searching, or NULL if it is not there. The copy is made when it is first used and
+// the commands added since then are appended to it.
+//
+char *hist_text(History_t *hp, off_t offset) {
+    off_t start = hp->histtextoff, end = start + hp->histtextlen, last;
+    char *cp;
+    int n;
+
+    if (offset >= start && offset < end) return hp->histtext + (offset - start);
+    last = hist_tell(hp, hp->histind);
+    if (offset < start || !hp->histtextlen) {
+        if ((n = hist_min(hp)) < 1) n = 1;
+        if ((start = hist_tell(hp, n)) > offset) start = offset;
+        end = start;
+    }
+    if (offset >= last) return NULL;
+    if (!(cp = realloc(hp->histtext, last - start + 1))) return NULL;
+    hp->histtext = cp;
+    cp += end - start;
+    if (sfseek(hp->histfp, end, SEEK_SET) != end || sfread(hp->histfp, cp, last - end) != last - end) {
+        hp->histtextlen = 0;
+        return NULL;
+    }
+    cp[last - end] = 0;
+    hp->histtextoff = start;
+    hp->histtextlen = last - start;
+    return hp->histtext + (offset - start);
+}
+
 //
 // Copy command <command> from history file to s1. At most <size> characters copied. If s1==0 the
 // number of lines for the command is returned. Set line=linenumber for emacs copy and only this
@@ -943,8 +1053,9 @@ static int hist_exceptf(Sfio_t *fp, int type, Sfdisc_t *handle)
             // cast is to silence Coverity CID #253581.
             (void)lseek(oldfd, 2, SEEK_SET);
             hp->histcnt = 2;
-            hp->histind = 1;
+            hp->histind = hp->histfirst = 1;
             hp->histcmds[1] = 2;
+            hp->histtextlen = 0;
             hist_eof(hp);
             hp->histmarker = hp->histcnt;
             hp->histind = index;
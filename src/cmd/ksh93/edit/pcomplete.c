@@ -472,13 +472,13 @@ again:
 
 static bool delete_and_add(const char *name, struct Complete *comp) {
     struct Complete *old = NULL;
-    Dt_t *compdict = shgd->ed_context->compdict;
+    Dt_t *compdict = ed_getcontext()->compdict;
 
     if (compdict && (old = (struct Complete *)dtmatch(compdict, name))) {
         dtdelete(compdict, old);
         free(old);
     } else if (comp && !compdict) {
-        shgd->ed_context->compdict = compdict = dtopen(&_Compdisc, Dtoset);
+        ed_getcontext()->compdict = compdict = dtopen(&_Compdisc, Dtoset);
     }
     if (!comp && old) return false;
     if (!comp) return true;
@@ -698,7 +698,7 @@ int b_complete(int argc, char *argv[], Shbltin_t *context) {
     if (complete) {
         char *name;
         struct Complete *cp;
-        Dt_t *compdict = shgd->ed_context->compdict;
+        Dt_t *compdict = ed_getcontext()->compdict;
         if (!empty && !argv[0]) {
             if (!print && !delete) {
                 errormsg(SH_DICT, ERROR_usage(0), "complete requires command name");
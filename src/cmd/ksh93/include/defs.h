@@ -239,6 +239,13 @@ extern Sfdouble_t sh_arith(Shell_t *, const char *);
 extern void *sh_arithcomp(Shell_t *, char *);
 extern pid_t sh_fork(Shell_t *, int, int *);
 extern pid_t _sh_fork(Shell_t *, pid_t, int, int *);
+extern bool sh_forksrv_active(Shell_t *);
+extern pid_t sh_forksrv_spawn(Shell_t *, const char *, char *const[], char *const[]);
+extern void sh_forksrv_start(Shell_t *);
+extern void sh_forksrv_stop(Shell_t *);
+extern const Shapi_t sh_api;
+extern volatile sig_atomic_t sh_profticks;
+extern bool sh_profon;
 extern char *sh_mactrim(Shell_t *, char *, int);
 extern int sh_macexpand(Shell_t *, struct argnod *, struct argnod **, int);
 extern bool sh_macfun(Shell_t *, const char *, int);
@@ -246,11 +253,22 @@ extern void sh_machere(Shell_t *, Sfio_t *, Sfio_t *, char *);
 extern Mac_t *sh_macopen(Shell_t *);
 extern char *sh_macpat(Shell_t *, struct argnod *, int);
 extern Sfdouble_t sh_mathfun(Shell_t *, void *, int, Sfdouble_t *);
+extern char *sh_mathnodes(Shell_t *);
+extern void sh_mkenum(Shell_t *, Namval_t *, Namval_t *, bool);
 extern int sh_outtype(Shell_t *, Sfio_t *);
+extern void *sh_pcattach(Shell_t *, Sfio_t *);
+extern void sh_pcclose(Shell_t *, void *, bool);
+extern void sh_pcdump(Shell_t *, void *, const Shnode_t *);
+extern int sh_pcopen(Shell_t *, int, const char *);
 extern char *sh_mactry(Shell_t *, char *);
 extern int sh_mathstd(const char *);
 extern void sh_printopts(Shell_t *, Shopt_t, int, Shopt_t *);
+extern void sh_profdone(Shell_t *);
+extern void sh_profstart(Shell_t *);
+extern void sh_proftick(Shell_t *);
+extern void sh_profwait(Shell_t *, uint64_t);
 extern int sh_readline(Shell_t *, char **, void *, volatile int, int, ssize_t, long);
+extern int sh_readjson(Shell_t *, Namval_t *, Sfio_t *);
 extern Sfio_t *sh_sfeval(const char **);
 extern char *sh_fmtj(const char *);
 extern char *sh_fmtstr(const char *, int);
@@ -335,16 +353,37 @@ extern const char e_dict[];
 #define STAT_FORKS 3
 #define STAT_FUNCT 4
 #define STAT_GLOBS 5
-#define STAT_READS 6
-#define STAT_NVHITS 7
-#define STAT_NVOPEN 8
-#define STAT_PATHS 9
-// #define STAT_SVFUNCT 10
-#define STAT_SCMDS 11
-#define STAT_SPAWN 12
-#define STAT_SUBSHELL 13
+#define STAT_HEREDOCS 6
+#define STAT_READS 7
+#define STAT_NVHITS 8
+#define STAT_NVOPEN 9
+#define STAT_STRALLOC 10
+#define STAT_STRREUSE 11
+#define STAT_PATHS 12
+// #define STAT_SVFUNCT 13
+#define STAT_REGCOMPS 14
+#define STAT_SCMDS 15
+#define STAT_SPAWN 16
+#define STAT_SUBSHELL 17
+#define STAT_WAITS 18
 extern const Shtable_t shtab_stats[];
 #define sh_stats(x) (shgd->stats[(x)]++)
+
+// Latency histograms, see stats.c.
+#define STAT_TFORK 0
+#define STAT_TSPAWN 1
+#define STAT_TWAIT 2
+#define STAT_TCOMSUB 3
+#define STAT_TSUBSHELL 4
+#define STAT_TPATH 5
+#define STAT_TREGCOMP 6
+#define STAT_THEREDOC 7
+#define STAT_NTIMES 8
+extern uint64_t sh_statclock(void);
+extern void sh_statdump(Shell_t *);
+extern void sh_statinit(Shell_t *);
+extern void sh_statreset(Shell_t *);
+extern void sh_stattime(int, uint64_t);
 extern const Shtable_t shtab_siginfo[];
 
 #define timeofday(p) gettimeofday(p, NULL)
@@ -185,6 +185,7 @@ extern int ed_macro(Edit_t *, int);
 extern int ed_expand(Edit_t *, char[], int *, int *, int, int);
 extern int ed_fulledit(Edit_t *);
 extern Edit_t *ed_open(Shell_t *);
+extern Edit_t *ed_getcontext(void);
 extern int ed_internal(const char *, genchar *);
 extern int ed_external(const genchar *, char *);
 extern void ed_gencpy(genchar *, const genchar *);
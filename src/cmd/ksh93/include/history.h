@@ -54,6 +54,7 @@ typedef struct {
     Shell_t *histshell;
     off_t histcnt;                  // offset into history file
     off_t histmarker;               // offset of last command marker
+    int histfirst;                  // oldest command with its offset in histcmds
     int histflush;                  // set if flushed outside of hflush()
     int histmask;                   // power of two mask for histcnt
     char histbuff[HIST_BSIZE + 1];  // history file buffer
@@ -61,6 +62,9 @@ typedef struct {
     Sfio_t *auditfp;
     char *tty;
     int auditmask;
+    char *histtext;     // copy of the commands for searching, see hist_text()
+    off_t histtextoff;  // offset of histtext in history file
+    size_t histtextlen;
     off_t histcmds[2];  // offset for recent commands, must be last
 } History_t;
 
@@ -86,6 +90,7 @@ extern Histloc_t hist_find(History_t *, char *, int, int, int);
 extern void hist_flush(History_t *);
 extern void hist_list(History_t *, Sfio_t *, off_t, int, const char *);
 extern int hist_match(History_t *, off_t, char *, int *);
+extern char *hist_text(History_t *, off_t);
 extern off_t hist_tell(History_t *, int);
 extern off_t hist_seek(History_t *, int);
 extern char *hist_word(char *, int, int);
@@ -104,6 +104,7 @@ struct jobs {
     int savesig;               // active signal
     int numpost;               // number of posted jobs
     int numbjob;               // number of background jobs
+    long maxrss;               // largest resident set size of a reaped child in kilobytes
     short fd;                  // tty descriptor number
     short maxjob;              // must reap after maxjob if > 0
 #ifdef JOBS
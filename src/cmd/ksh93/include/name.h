@@ -79,11 +79,17 @@ enum value_type {
 // The following array in name.c must be kept in sync with enum value_type.
 extern const char *value_type_names[];
 
-struct Value {
+// Where a value was last stored and as what type. Each STORE_VT() has one of these in static
+// storage so that a struct Value, of which there is one in every node, only needs a pointer to it.
+struct Value_site {
     const char *funcname;
-    const char *filename;
+    const char *filename;  // the __FILE__ of the store; see vt_filename()
     int line_num;
     enum value_type type;
+};
+
+struct Value {
+    const struct Value_site *site;  // NULL until a value has been stored
     union {
         void *vp;
         char *cp;
@@ -119,6 +125,14 @@ struct Value {
     } _val;
 };
 
+// The type of the value last stored and the module that stored it.
+#define vt_type(value_obj) ((value_obj).site ? (value_obj).site->type : VT_do_not_use)
+#define vtp_type(value_objp) vt_type(*(value_objp))
+#define vt_filename(site) \
+    ((site) && (site)->filename ? strrchr((site)->filename, '/') + 1 : "undef")
+#define vt_funcname(site) ((site) && (site)->funcname ? (site)->funcname : "undef")
+#define vt_line(site) ((site) ? (site)->line_num : 0)
+
 // I dislike macros like these but since C doesn't support polymorphism directly this is the most
 // straightforward way to access any of the fields of the value union.
 //
@@ -136,60 +150,41 @@ struct Value {
 #define fetch_abort() 0      // abort()
 #define fetch_backtrace() 0  // dump_backtrace(0)
 
-#define fetch_vt(line, value_obj, which)                                                         \
-    (((value_obj).type == VT_##which || (VT_##which == VT_vp) ||                                 \
-      (VT_##which == VT_const_cp && (value_obj).type == VT_cp))                                  \
-         ? (value_obj)._val.which                                                                \
-         : (DPRINTF("fetched value type != stored type:"),                                       \
-            DPRINTF("fetching \"%s\"", value_type_names[VT_##which]),                            \
-            DPRINTF("stored   \"%s\" @ %s:%d in %s()", value_type_names[(value_obj).type],       \
-                    (value_obj).filename ? (value_obj).filename : "undef", (value_obj).line_num, \
-                    (value_obj).funcname ? (value_obj).funcname : "undef"),                      \
+#define fetch_vt(line, value_obj, which)                                                       \
+    ((vt_type(value_obj) == VT_##which || (VT_##which == VT_vp) ||                             \
+      (VT_##which == VT_const_cp && vt_type(value_obj) == VT_cp))                              \
+         ? (value_obj)._val.which                                                              \
+         : (DPRINTF("fetched value type != stored type:"),                                     \
+            DPRINTF("fetching \"%s\"", value_type_names[VT_##which]),                          \
+            DPRINTF("stored   \"%s\" @ %s:%d in %s()", value_type_names[vt_type(value_obj)],   \
+                    vt_filename((value_obj).site), vt_line((value_obj).site),                  \
+                    vt_funcname((value_obj).site)),                                            \
             fetch_backtrace(), fetch_abort(), (value_obj)._val.which))
 
-#define fetch_vtp(line, value_objp, which)                                                   \
-    (((value_objp)->type == VT_##which || (VT_##which == VT_vp) ||                           \
-      (VT_##which == VT_const_cp && (value_objp)->type == VT_cp))                            \
-         ? (value_objp)->_val.which                                                          \
-         : (DPRINTF("fetched value type != stored type:"),                                   \
-            DPRINTF("fetching \"%s\"", value_type_names[VT_##which]),                        \
-            DPRINTF("stored   \"%s\" @ %s:%d in %s()", value_type_names[(value_objp)->type], \
-                    (value_objp)->filename ? (value_objp)->filename : "undef",               \
-                    (value_objp)->line_num,                                                  \
-                    (value_objp)->funcname ? (value_objp)->funcname : "undef"),              \
-            fetch_backtrace(), fetch_abort(), (value_objp)->_val.which))
+#define fetch_vtp(line, value_objp, which) fetch_vt(line, *(value_objp), which)
 
 #endif
 
-#define dprint_vtp(value_objp)                                                                 \
-    DPRINTF("stored value type \"%s\" @ %s:%d in %s()", value_type_names[(value_objp)->type],  \
-            (value_objp)->filename ? (value_objp)->filename : "undef", (value_objp)->line_num, \
-            (value_objp)->funcname ? (value_objp)->funcname : "undef")
+#define dprint_vtp(value_objp)                                                                \
+    DPRINTF("stored value type \"%s\" @ %s:%d in %s()", value_type_names[vtp_type(value_objp)], \
+            vt_filename((value_objp)->site), vt_line((value_objp)->site),                     \
+            vt_funcname((value_objp)->site))
 
-#define is_vt(value_obj, which) ((value_obj).type == VT_##which)
+#define is_vt(value_obj, which) (vt_type(value_obj) == VT_##which)
 
-#define is_vtp(value_objp, which) ((value_objp)->type == VT_##which)
+#define is_vtp(value_objp, which) (vtp_type(value_objp) == VT_##which)
 
-// Always store all the meta data. Even if building without the getter checks enabled. That's
+// Always record all the meta data. Even if building without the getter checks enabled. That's
 // because a) the info may be useful when debugging core dumps, and b) the value type is needed for
-// the IS_VT macro.
-#define store_vt(line, value_obj, which, val)              \
-    do {                                                   \
-        (value_obj).funcname = __FUNCTION__;               \
-        (value_obj).filename = strrchr(__FILE__, '/') + 1; \
-        (value_obj).line_num = line;                       \
-        (value_obj).type = VT_##which;                     \
-        (value_obj)._val.which = val;                      \
+// the IS_VT macro. It is all constant for a given store so it costs one pointer per value.
+#define store_vt(line, value_obj, which, val)                                                \
+    do {                                                                                     \
+        static const struct Value_site _vt_site = {__FUNCTION__, __FILE__, line, VT_##which}; \
+        (value_obj).site = &_vt_site;                                                        \
+        (value_obj)._val.which = val;                                                        \
     } while (0)
 
-#define store_vtp(line, value_objp, which, val)              \
-    do {                                                     \
-        (value_objp)->funcname = __FUNCTION__;               \
-        (value_objp)->filename = strrchr(__FILE__, '/') + 1; \
-        (value_objp)->line_num = line;                       \
-        (value_objp)->type = VT_##which;                     \
-        (value_objp)->_val.which = val;                      \
-    } while (0)
+#define store_vtp(line, value_objp, which, val) store_vt(line, *(value_objp), which, val)
 
 // These four macros must be used when retrieving or storing a value in a `struct Value` object.
 #define FETCH_VT(value_obj, which) fetch_vt(__LINE__, value_obj, which)
@@ -541,6 +536,7 @@ extern char *nv_setdisc(Namval_t *, const void *, Namval_t *, Namfun_t *);
 extern void nv_setref(Namval_t *, Dt_t *, nvflag_t);
 extern int nv_settype(Namval_t *, Namval_t *, nvflag_t);
 extern void nv_setvec(Namval_t *, int, int, char *[]);
+extern int nv_appendvec(Namval_t *, int, const void *, size_t, nvflag_t);
 extern void nv_setvtree(Namval_t *);
 extern int nv_setsize(Namval_t *, int);
 extern Namfun_t *nv_disc(Namval_t *, Namfun_t *, Nvdisc_op_t);
@@ -664,6 +660,7 @@ extern int nv_aipack(Namarr_t *);
 extern bool nv_atypeindex(Namval_t *, const char *);
 extern bool nv_setnotify(Namval_t *, char **);
 extern bool nv_unsetnotify(Namval_t *, char **);
+extern void nv_numflush(void);
 extern struct argnod *nv_onlist(struct argnod *, const char *);
 extern void nv_optimize(Namval_t *);
 extern void nv_unref(Namval_t *);
@@ -674,6 +671,7 @@ extern struct nvdir *nv_diropen(Namval_t *, const char *, void *);
 extern char *nv_dirnext(void *);
 extern void nv_dirclose(struct nvdir *);
 extern char *nv_getvtree(Namval_t *, Namfun_t *);
+extern bool nv_outvtree(Namval_t *, Sfio_t *);
 extern void nv_attribute(Namval_t *, Sfio_t *, char *, int);
 extern Namval_t *nv_bfsearch(const char *, Dt_t *, Namval_t **, char **);
 extern Namval_t *nv_mkclone(Namval_t *);
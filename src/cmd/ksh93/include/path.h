@@ -40,6 +40,20 @@
 #define PATH_OFFSET 2  // path offset for path_join
 #define MAXDEPTH 1024  // maximum recursion depth
 
+//
+// Names in a directory, read in one pass and used until the modification time of the directory
+// changes.
+//
+struct pathindex {
+    dev_t dev;
+    ino_t ino;
+    time_t mtime;
+    long mtimensec;
+    size_t nnames;
+    char **names;  // sorted with strcmp()
+    char *buf;
+};
+
 //
 // Path component structure for path searching.
 //
@@ -53,6 +67,7 @@ struct pathcomp {
     char *lib;
     char *bbuf;
     char *blib;
+    struct pathindex *index;
     unsigned short len;
     unsigned short flags;
     Shell_t *shp;
@@ -70,6 +85,8 @@ extern Pathcomp_t *path_addpath(Shell_t *, Pathcomp_t *, const char *, int);
 extern bool path_cmdlib(Shell_t *, const char *, bool);
 extern Pathcomp_t *path_dup(Pathcomp_t *);
 extern void path_delete(Pathcomp_t *);
+extern struct pathindex *path_index(Pathcomp_t *, bool);
+extern void path_freeindex(struct pathindex *);
 extern void path_alias(Namval_t *, Pathcomp_t *);
 extern Pathcomp_t *path_absolute(Shell_t *, const char *, Pathcomp_t *);
 extern char *path_basename(const char *);
@@ -77,6 +94,9 @@ extern char *path_fullname(Shell_t *, const char *);
 extern int path_expand(Shell_t *, const char *, struct argnod **);
 extern void path_exec(Shell_t *, const char *, char *[], struct argnod *);
 extern pid_t path_spawn(Shell_t *, const char *, char *[], char *[], Pathcomp_t *, int);
+#if USE_VFORK
+extern pid_t path_vforkexec(Shell_t *, const char *, char *const[], char *const[], pid_t);
+#endif
 extern int path_open(Shell_t *, const char *, Pathcomp_t *);
 extern Pathcomp_t *path_get(Shell_t *, const char *);
 extern char *path_pwd(Shell_t *);
@@ -89,6 +109,7 @@ extern int path_generate(Shell_t *, struct argnod *, struct argnod **);
 // Builtin/plugin routines.
 extern int sh_addlib(Shell_t *, void *, char *, Pathcomp_t *);
 extern Shbltin_f sh_getlib(Shell_t *, char *, Pathcomp_t *);
+extern void sh_pluginindex(Shell_t *);
 
 // Constant strings needed for whence.
 extern const char e_timeformat[];
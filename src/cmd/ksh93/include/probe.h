@@ -0,0 +1,45 @@
+//
+// Static tracing probes.
+//
+// When the build finds <sys/sdt.h> the probes below are compiled into the shell as USDT probes of
+// the provider `ksh`, which tools such as bpftrace, perf and SystemTap can attach to, e.g.
+//
+//     bpftrace -e 'usdt:/bin/ksh:ksh:command__start { printf("%s\n", str(arg0)); }'
+//
+// A probe that is not attached costs a nop. Without <sys/sdt.h>, or when the shell is built with
+// `meson -Dusdt=false`, the macros expand to nothing and their arguments are not evaluated.
+//
+//     command__start  name, line             a simple command is about to run
+//     command__done   name, line, exitval    a simple command has finished
+//     fork            pid, flags             the shell has forked a child (in the parent)
+//     spawn           path, pid              a program has been spawned, pid is -1 if it failed
+//     wait__start     pid                    job_wait() starts to wait for a child or job
+//     wait__done      pid, exitval, nsec     job_wait() is done and how long it waited
+//     reap            pid, wstat             job_reap() has collected the status of a child
+//     subshell__start comsub, level          a subshell or command substitution starts
+//     subshell__done  comsub, exitval        a subshell or command substitution is done
+//     comsub__start   line                   a command substitution is expanded
+//     comsub__done    line                   its output has been read
+//     redirect        fd, flags, path        a redirection is about to be done
+//     regcomp         pattern, nsec          a regular expression missed the cache and was compiled
+//
+#ifndef _PROBE_H
+#define _PROBE_H 1
+
+#if _hdr_sys_sdt
+
+#include <sys/sdt.h>
+
+#define SH_PROBE1(name, a) DTRACE_PROBE1(ksh, name, a)
+#define SH_PROBE2(name, a, b) DTRACE_PROBE2(ksh, name, a, b)
+#define SH_PROBE3(name, a, b, c) DTRACE_PROBE3(ksh, name, a, b, c)
+
+#else  // _hdr_sys_sdt
+
+#define SH_PROBE1(name, a) ((void)0)
+#define SH_PROBE2(name, a, b) ((void)0)
+#define SH_PROBE3(name, a, b, c) ((void)0)
+
+#endif  // _hdr_sys_sdt
+
+#endif  // _PROBE_H
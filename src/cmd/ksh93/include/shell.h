@@ -253,6 +253,7 @@ struct Shell_s {
     Namfun_t nvfun;
     char *mathnodes;
     void *coshell;
+    void *pcache;  // parse cache entry waiting for sh_eval()
     char *bltin_dir;
     char exittrap;
     char errtrap;
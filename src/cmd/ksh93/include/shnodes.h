@@ -40,6 +40,7 @@
 #define FLINENO (04 << COMBITS)      // for/case has line number
 #define FSHVALUE (0100 << COMBITS)   // function set .sh.value
 #define FOPTGET (0200 << COMBITS)    // function calls getopts
+#define FLAZY (01000 << COMBITS)     // function body is parsed when first used
 
 #define TNEGATE (01 << COMBITS)  // ! inside [[...]]
 #define TBINARY (02 << COMBITS)  // binary operator in [[...]]
@@ -193,10 +194,35 @@ union Shnode_u {
     struct arithnod ar;
 };
 
+//
+// Binary scripts of version 4 hold an image of their parse trees that starts eight bytes after the
+// start of the script, see tdump.c.
+//
+#define TD_VERSION 4
+#define TD_ALIGN 8
+#define TD_ORDER 0x01020304
+
+struct tdimage {
+    uint32_t order;    // TD_ORDER as written
+    uint32_t unused;
+    uint64_t size;     // size of the image including this header
+    uint64_t ntrees;   // number of top level trees
+    uint64_t strings;  // offset of the string table
+    uint64_t docs;     // offset of the here-documents
+};
+
 extern void sh_freeup(Shell_t *);
 extern void sh_funstaks(struct slnod *, int);
+extern Shnode_t *sh_funparse(Shell_t *, struct slnod *, int *);
+extern Shnode_t *sh_funtree(Shell_t *, Namval_t *);
 extern Sfio_t *sh_subshell(Shell_t *, Shnode_t *, volatile int, int);
-extern int sh_tdump(Sfio_t *, const Shnode_t *);
+extern struct tdump *sh_tdumpopen(bool);
+extern int sh_tdumpadd(struct tdump *, const Shnode_t *);
+extern int sh_tdumpclose(struct tdump *, Sfio_t *);
+extern void sh_tforget(void);
+extern Shnode_t *sh_tmap(Shell_t *, Sfio_t *, int);
+extern bool sh_tmore(Sfio_t *);
+extern Shnode_t *sh_tnext(Shell_t *, Sfio_t *);
 extern Shnode_t *sh_trestore(Shell_t *, Sfio_t *);
 
 #endif  // _SHNODES_H
@@ -601,6 +601,8 @@ void sh_applyopts(Shell_t *shp, Shopt_t newflags) {
     int is_privileged_off = is_option(&(shp->arg_context)->sh->offoptions, SH_PRIVILEGED);
     if ((!sh_isstate(shp, SH_INIT) && is_privileged) ||
         (sh_isstate(shp, SH_INIT) && is_privileged_off && shp->gd->userid != shp->gd->euserid)) {
+        // The fork server has the old ids.
+        sh_forksrv_stop(shp);
         if (!is_option(&newflags, SH_PRIVILEGED)) {
             if (setuid(shp->gd->userid) < 0) {
                 error(ERROR_system(0), "setuid(%d) failed", shp->gd->userid);
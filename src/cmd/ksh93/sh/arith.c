@@ -26,6 +26,7 @@
 
 #include <ctype.h>
 #include <errno.h>
+#include <float.h>
 #include <limits.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -237,6 +238,74 @@ Math_f sh_mathstdfun(const char *fname, size_t fsize, short *nargs) {
 
 int sh_mathstd(const char *name) { return sh_mathstdfun(name, strlen(name), NULL) != 0; }
 
+//
+// Decimal numbers whose significant digits fit in the mantissa of a Sfdouble_t and whose power of
+// ten is exact are converted with a single multiply or divide, which rounds the same way strtold()
+// does. This covers the values read from most data files. Anything else is left to strtold().
+//
+#if LDBL_MANT_DIG >= 64
+#define DEC_DIGITS 19
+#else
+#define DEC_DIGITS 15
+#endif
+#define DEC_POWER 22
+
+static const Sfdouble_t Ptable[DEC_POWER + 1] = {
+    1e0L,  1e1L,  1e2L,  1e3L,  1e4L,  1e5L,  1e6L,  1e7L,  1e8L,  1e9L,  1e10L, 1e11L,
+    1e12L, 1e13L, 1e14L, 1e15L, 1e16L, 1e17L, 1e18L, 1e19L, 1e20L, 1e21L, 1e22L};
+
+static_fn bool decimal(const char *s, char **p, Sfdouble_t *r) {
+    const char *cp = s;
+    uint64_t m = 0;
+    int n = 0, e = 0, x = 0;
+    bool neg = false, digits = false, exact = false;
+
+    if (*cp == '-' || *cp == '+') neg = *cp++ == '-';
+    for (; *cp == '0'; cp++) digits = true;
+    for (; isdigit(*cp); cp++, n++) {
+        if (n >= DEC_DIGITS) return false;
+        m = 10 * m + (*cp - '0');
+        digits = true;
+    }
+    if (*cp == getdecimal()) {
+        exact = true;
+        cp++;
+        if (n == 0) {
+            for (; *cp == '0'; cp++, e--) digits = true;
+        }
+        for (; isdigit(*cp); cp++, n++, e--) {
+            if (n >= DEC_DIGITS) return false;
+            m = 10 * m + (*cp - '0');
+            digits = true;
+        }
+    }
+    if (!digits) return false;
+    if (*cp == 'e' || *cp == 'E') {
+        const char *ep = cp + 1;
+        bool eneg = false;
+        if (*ep == '-' || *ep == '+') eneg = *ep++ == '-';
+        if (!isdigit(*ep)) return false;
+        for (; isdigit(*ep); ep++) {
+            if (x < 10000) x = 10 * x + (*ep - '0');
+        }
+        e += eneg ? -x : x;
+        cp = ep;
+        exact = true;
+    }
+    // Integers are left to strton64() which knows about bases.
+    if (!exact) return false;
+    if (m == 0) {
+        *r = 0;
+    } else if (e < -DEC_POWER || e > DEC_POWER) {
+        return false;
+    } else {
+        *r = e < 0 ? (Sfdouble_t)m / Ptable[-e] : (Sfdouble_t)m * Ptable[e];
+    }
+    if (neg) *r = -*r;
+    *p = (char *)cp;
+    return true;
+}
+
 static_fn Sfdouble_t number(const char *s, char **p, int b, struct lval *lvalue) {
     Sfdouble_t r;
     char *t;
@@ -256,6 +325,10 @@ static_fn Sfdouble_t number(const char *s, char **p, int b, struct lval *lvalue)
     }
     lvalue->eflag = 0;
     lvalue->isfloat = 0;
+    if (decimal(s, &t, &r)) {
+        lvalue->isfloat = TYPE_LD;
+        goto done;
+    }
     r = strton64(s, &t, &base, -1);
     if (*t == '8' || *t == '9') {
         base = 10;
@@ -277,6 +350,7 @@ static_fn Sfdouble_t number(const char *s, char **p, int b, struct lval *lvalue)
         r = strtold(s, &t);
         lvalue->isfloat = TYPE_LD;
     }
+done:
     if (t > s) {
         if (*t == 'f' || *t == 'F') {
             t++;
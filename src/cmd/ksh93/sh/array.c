@@ -1404,9 +1404,12 @@ void *nv_associative(Namval_t *np, const char *sp, Nvassoc_op_t op) {
 }
 
 //
-// Assign values to an array.
+// Assign values to an array. <flags> are passed to nv_putval() with each value. When it is zero the
+// values are strings and <vals> is an array of pointers to them, otherwise <vals> is an array of
+// values of <size> bytes each. Returns the index of the first value.
 //
-void nv_setvec(Namval_t *np, int append, int argc, char *argv[]) {
+static_fn int array_setvec(Namval_t *np, int append, int argc, const void *vals, size_t size,
+                           nvflag_t flags) {
     int arg0 = 0;
     struct index_array *ap = NULL;
     // struct index_array *aq;  // see TODO below
@@ -1437,7 +1440,24 @@ void nv_setvec(Namval_t *np, int append, int argc, char *argv[]) {
     if (ap) ap->last = arg0 + argc;
     while (--argc >= 0) {
         nv_putsub(np, NULL, (long)argc + arg0, ARRAY_FILL | ARRAY_ADD);
-        nv_putval(np, argv[argc], 0);
+        if (flags) {
+            nv_putval(np, (const char *)vals + argc * size, flags);
+        } else {
+            nv_putval(np, ((char *const *)vals)[argc], 0);
+        }
     }
     if (!ap && (ap = (struct index_array *)nv_arrayptr(np))) ap->last = array_maxindex(np);
+    return arg0;
+}
+
+void nv_setvec(Namval_t *np, int append, int argc, char *argv[]) {
+    array_setvec(np, append, argc, argv, 0, 0);
+}
+
+//
+// Append <argc> values to the indexed array <np> and return the index of the first one. The values
+// are described by <vals>, <size> and <flags> as for array_setvec().
+//
+int nv_appendvec(Namval_t *np, int argc, const void *vals, size_t size, nvflag_t flags) {
+    return array_setvec(np, 1, argc, vals, size, flags);
 }
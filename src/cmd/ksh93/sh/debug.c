@@ -464,9 +464,10 @@ void _dprint_vtp(const char *file_name, int lineno, const char *func_name, int l
     // expression that causes lint warnings.
     const struct Value *vtp = vp;
     assert(dprint_vtp_dispatch[VT_sentinal] == NULL);  // ensure table is valid
-    assert(vtp->type >= VT_do_not_use && vtp->type < VT_sentinal);
+    enum value_type type = vtp_type(vtp);
+    assert(type >= VT_do_not_use && type < VT_sentinal);
 
-    if (vtp->type == VT_do_not_use) {
+    if (type == VT_do_not_use) {
         _dprintf(file_name, lineno, func_name,
                  indent(level, "struct Value %s is undefined (type is VT_do_not_use)"), var_name);
         errno = oerrno;
@@ -475,12 +476,12 @@ void _dprint_vtp(const char *file_name, int lineno, const char *func_name, int l
 
     _dprintf(file_name, lineno, func_name,
              indent(level, "struct Value %s.%s stored @ %s:%d in %s() is..."), var_name,
-             value_type_names[vtp->type], vtp->filename ? vtp->filename : "undef",
-             _dprint_fixed_line ? _dprint_fixed_line : vtp->line_num,
-             vtp->funcname ? vtp->funcname : "undef");
+             value_type_names[type], vt_filename(vtp->site),
+             _dprint_fixed_line ? _dprint_fixed_line : vt_line(vtp->site),
+             vt_funcname(vtp->site));
     debug_trap_sigsegv();
     if (sigsetjmp(jbuf, 1) == 0) {
-        (dprint_vtp_dispatch[vtp->type])(file_name, lineno, func_name, level + 1, var_name, vtp);
+        (dprint_vtp_dispatch[type])(file_name, lineno, func_name, level + 1, var_name, vtp);
     } else {
         _dprintf(file_name, lineno, func_name,
                  indent(level, "SIGSEGV on invalid void* 0x%" PRIXPTR ""),
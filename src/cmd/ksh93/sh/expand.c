@@ -26,6 +26,7 @@
 #include "config_ast.h"  // IWYU pragma: keep
 
 #include <ctype.h>
+#include <dirent.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -35,6 +36,7 @@
 #include "ast_glob.h"
 #include "cdt.h"
 #include "defs.h"
+#include "error.h"
 #include "name.h"
 #include "path.h"
 #include "sfio.h"
@@ -68,6 +70,43 @@ static_fn char *nextdir(glob_t *gp, char *dir) {
     return NULL;
 }
 
+//
+// Directories on PATH are read from their index when command names are completed.
+//
+struct dirscan {
+    struct pathindex *ip;
+    size_t next;
+};
+
+static_fn DIR *diropen(glob_t *gp, const char *dir) {
+    UNUSED(dir);
+    struct dirscan *dp;
+    struct pathindex *ip = path_index(gp->gl_handle, true);
+
+    if (!ip) return NULL;
+    dp = malloc(sizeof(struct dirscan));
+    if (!dp) errormsg(SH_DICT, ERROR_system(1), e_nospace);
+    dp->ip = ip;
+    dp->next = 0;
+    return (DIR *)dp;
+}
+
+static_fn char *dirnext(glob_t *gp, DIR *dir) {
+    UNUSED(gp);
+    struct dirscan *dp = (struct dirscan *)dir;
+
+    if (dp->next >= dp->ip->nnames) return NULL;
+    return dp->ip->names[dp->next++];
+}
+
+static_fn int dirclose(glob_t *gp, DIR *dir) {
+    struct dirscan *dp = (struct dirscan *)dir;
+
+    if (dp->ip != ((Pathcomp_t *)gp->gl_handle)->index) path_freeindex(dp->ip);
+    free(dp);
+    return 0;
+}
+
 int path_expand(Shell_t *shp, const char *pattern, struct argnod **arghead) {
     glob_t gdata;
     struct argnod *ap;
@@ -96,6 +135,11 @@ int path_expand(Shell_t *shp, const char *pattern, struct argnod **arghead) {
         extra += scantree(shp, shp->alias_tree, pattern, arghead);
         extra += scantree(shp, shp->fun_tree, pattern, arghead);
         gp->gl_nextdir = nextdir;
+        if (!strchr(pattern, '/')) {
+            gp->gl_diropen = diropen;
+            gp->gl_dirnext = dirnext;
+            gp->gl_dirclose = dirclose;
+        }
         flags |= GLOB_COMPLETE;
         flags &= ~GLOB_NOCHECK;
     }
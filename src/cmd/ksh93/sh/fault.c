@@ -555,6 +555,8 @@ __attribute__((noreturn)) void sh_done(void *ptr, int sig) {
     }
 #endif  // JOBS
     job_close(shp);
+    sh_profdone(shp);
+    sh_statdump(shp);
     sfsync((Sfio_t *)sfstdin);
     sfsync((Sfio_t *)shp->outpool);
     sfsync((Sfio_t *)sfstdout);
@@ -0,0 +1,447 @@
+//
+// Fork server.
+//
+// Every fork of a shell with a large heap copies page tables in proportion to its size, so the
+// cost of running a command grows with the memory the shell uses. When KSH_FORKSERVER is set in
+// the environment of a shell that is not interactive, the shell starts a helper process before it
+// runs any commands, while it is still small, and asks it to start simple external commands.
+//
+// For each command the shell sends the pathname, the arguments, the environment, the file creation
+// mask and the signals that are ignored over a socket, and passes its working directory and its
+// descriptors that stay open across exec with SCM_RIGHTS. The helper clones itself with
+// CLONE_PARENT, so that the command is a child of the shell, sets up the child and executes the
+// command. It replies with the process id once the exec has succeeded. The shell then posts the
+// process as if it had forked it, so that waiting, exit status and traps go through jobs.c as
+// usual. If the command could not be executed the failed child has been reaped and the shell
+// runs the command the usual way, so that error messages and scripts without #! are unchanged.
+//
+// The helper is made without an exit signal. waitpid(-1) only waits for such children when it is
+// given __WCLONE, so job_reap() never waits for the helper.
+//
+#include "config_ast.h"  // IWYU pragma: keep
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "defs.h"
+#include "fault.h"
+#include "io.h"
+#include "name.h"
+#include "sfio.h"
+#include "stk.h"
+
+#if __linux__ && defined(CLONE_PARENT) && defined(SCM_RIGHTS) && defined(MSG_CMSG_CLOEXEC)
+
+#define SRV_MAXFD 64               // descriptors passed with a request, the directory first
+#define SRV_STACK (64 * 1024 / 8)  // stack size in units of uint64_t
+
+struct srvreq {
+    uint32_t size;      // size of the strings that follow the request
+    uint32_t argc;      // number of arguments
+    uint32_t envc;      // number of environment strings
+    uint32_t nfd;       // number of descriptors passed with the request
+    mode_t mask;        // file creation mask
+    sigset_t ignore;    // signals that are ignored by the command
+    int fd[SRV_MAXFD];  // descriptor numbers in the command, fd[0] is unused
+};
+
+struct srvrep {
+    pid_t pid;  // process id of the command
+    int err;    // errno of the failed exec or zero
+};
+
+// A request as the helper sees it.
+struct srvcmd {
+    struct srvreq req;
+    int fds[SRV_MAXFD];  // the passed descriptors, fds[0] is the working directory
+    char *path;
+    char **argv;
+    char **envp;
+    sigset_t ignore;  // the ignored signals of the request and those ignored at startup
+    int status;       // write end of the pipe that reports a failed exec
+};
+
+static struct {
+    int fd;       // socket to the helper or -1
+    pid_t pid;    // process id of the helper
+    pid_t owner;  // process id of the shell that started it
+} srv = {.fd = -1};
+
+// The helper and each command start on a stack of their own. Neither is shared with the shell
+// since they are cloned without CLONE_VM.
+static uint64_t srv_stack[SRV_STACK];
+static uint64_t srv_cstack[SRV_STACK];
+
+static_fn bool srv_write(int fd, const void *buf, size_t size) {
+    const char *cp = buf;
+    ssize_t n;
+
+    while (size > 0) {
+        n = send(fd, cp, size, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        cp += n;
+        size -= n;
+    }
+    return true;
+}
+
+static_fn bool srv_read(int fd, void *buf, size_t size) {
+    char *cp = buf;
+    ssize_t n;
+
+    while (size > 0) {
+        n = read(fd, cp, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        cp += n;
+        size -= n;
+    }
+    return true;
+}
+
+//
+// Set up the child and execute the command. This runs in the process cloned by the helper.
+//
+static_fn int srv_exec(void *arg) {
+    struct srvcmd *cp = arg;
+    struct srvreq *rp = &cp->req;
+    struct sigaction sa;
+    sigset_t none;
+    int fd, i, top = 2, err;
+    bool used[3] = {false, false, false};
+
+    for (i = 1; i < rp->nfd; i++) {
+        if (rp->fd[i] > top) top = rp->fd[i];
+        if (rp->fd[i] < 3) used[rp->fd[i]] = true;
+    }
+    // Move everything that has to survive the dup2() calls above the descriptors of the command.
+    // All of the descriptors of the helper are close-on-exec.
+    if ((fd = fcntl(cp->status, F_DUPFD_CLOEXEC, top + 1)) >= 0) cp->status = fd;
+    for (i = 1; i < rp->nfd; i++) {
+        if ((fd = fcntl(cp->fds[i], F_DUPFD_CLOEXEC, top + 1)) < 0) goto fail;
+        cp->fds[i] = fd;
+    }
+    if (fchdir(cp->fds[0]) < 0) goto fail;
+    for (i = 1; i < rp->nfd; i++) {
+        if (dup2(cp->fds[i], rp->fd[i]) < 0) goto fail;
+    }
+    // Make sure stdin, stdout and stderr are open like path_pfexecve() does.
+    for (fd = 0; fd < 3; fd++) {
+        if (used[fd]) continue;
+        if ((i = open("/dev/null", O_RDWR | O_CLOEXEC)) < 0) goto fail;
+        if (dup2(i, fd) < 0) goto fail;
+        if (i != fd) close(i);
+    }
+    umask(rp->mask);
+    memset(&sa, 0, sizeof(sa));
+    sigemptyset(&sa.sa_mask);
+    for (i = 1; i < NSIG; i++) {
+        if (i == SIGKILL || i == SIGSTOP) continue;
+        sa.sa_handler = sigismember(&cp->ignore, i) == 1 ? SIG_IGN : SIG_DFL;
+        sigaction(i, &sa, NULL);
+    }
+    sigemptyset(&none);
+    sigprocmask(SIG_SETMASK, &none, NULL);
+    execve(cp->path, cp->argv, cp->envp);
+fail:
+    err = errno;
+    (void)write(cp->status, &err, sizeof(err));
+    _exit(127);
+}
+
+//
+// Read a request from the shell, start the command and reply. Returns false when the shell has
+// gone away.
+//
+static_fn bool srv_serve(int sock, const sigset_t *ignored) {
+    struct srvcmd cmd;
+    struct srvreq *rp = &cmd.req;
+    struct srvrep rep = {.pid = -1, .err = EPROTO};
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(SRV_MAXFD * sizeof(int))];
+    } cbuf;
+    struct iovec iov = {.iov_base = rp, .iov_len = sizeof(*rp)};
+    struct msghdr msg = {
+        .msg_iov = &iov, .msg_iovlen = 1, .msg_control = cbuf.buf, .msg_controllen = sizeof(cbuf)};
+    struct cmsghdr *cmp;
+    char *buf = NULL, *cp, **vp = NULL;
+    int nfd = 0, st[2], i;
+    ssize_t n;
+
+    while ((n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC)) < 0 && errno == EINTR) {
+        ;  // empty loop
+    }
+    if (n <= 0) return false;
+    for (cmp = CMSG_FIRSTHDR(&msg); cmp; cmp = CMSG_NXTHDR(&msg, cmp)) {
+        if (cmp->cmsg_level != SOL_SOCKET || cmp->cmsg_type != SCM_RIGHTS) continue;
+        i = (cmp->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        if (nfd + i > SRV_MAXFD) i = SRV_MAXFD - nfd;
+        memcpy(&cmd.fds[nfd], CMSG_DATA(cmp), i * sizeof(int));
+        nfd += i;
+    }
+    if (n < sizeof(*rp) && !srv_read(sock, (char *)rp + n, sizeof(*rp) - n)) goto done;
+    if (!(buf = malloc(rp->size + 1)) || !srv_read(sock, buf, rp->size)) goto done;
+    buf[rp->size] = 0;
+    if (nfd != rp->nfd || nfd < 1) goto done;
+    if (!(vp = malloc((rp->argc + rp->envc + 2) * sizeof(char *)))) goto done;
+    // The strings are the pathname, the arguments and the environment.
+    cmd.path = cp = buf;
+    cmd.argv = vp;
+    cmd.envp = vp + rp->argc + 1;
+    for (i = 0; i < rp->argc + rp->envc; i++) {
+        cp += strlen(cp) + 1;
+        if (cp >= buf + rp->size) goto done;
+        vp[i < rp->argc ? i : i + 1] = cp;
+    }
+    vp[rp->argc] = NULL;
+    vp[rp->argc + rp->envc + 1] = NULL;
+    cmd.ignore = *ignored;
+    for (i = 1; i < NSIG; i++) {
+        if (sigismember(&rp->ignore, i) == 1) sigaddset(&cmd.ignore, i);
+    }
+    if (pipe2(st, O_CLOEXEC) < 0) {
+        rep.err = errno;
+        goto done;
+    }
+    cmd.status = st[1];
+    rep.pid = clone(srv_exec, srv_cstack + SRV_STACK, CLONE_PARENT | SIGCHLD, &cmd);
+    rep.err = rep.pid < 0 ? errno : 0;
+    close(st[1]);
+    if (rep.pid > 0 && !srv_read(st[0], &rep.err, sizeof(rep.err))) rep.err = 0;
+    close(st[0]);
+done:
+    for (i = 0; i < nfd; i++) close(cmd.fds[i]);
+    free(vp);
+    free(buf);
+    return srv_write(sock, &rep, sizeof(rep));
+}
+
+//
+// The helper process. It keeps nothing of the shell but the socket and the signals that were
+// ignored when it was started, and serves requests until the shell closes the socket.
+//
+static_fn int srv_main(void *arg) {
+    int sock = (int)(intptr_t)arg, fd;
+    static const int quiet[] = {SIGHUP, SIGINT, SIGQUIT, SIGTERM, SIGPIPE, SIGALRM,
+                                SIGTSTP, SIGTTIN, SIGTTOU, SIGUSR1, SIGUSR2};
+    struct sigaction sa;
+    sigset_t ignored, none;
+    DIR *dp;
+    struct dirent *ep;
+    int i;
+
+    if ((dp = opendir("/proc/self/fd"))) {
+        while ((ep = readdir(dp))) {
+            fd = (int)strtol(ep->d_name, NULL, 10);
+            if (*ep->d_name != '.' && fd != sock && fd != dirfd(dp)) close(fd);
+        }
+        closedir(dp);
+    } else {
+        for (fd = sysconf(_SC_OPEN_MAX); --fd >= 0;) {
+            if (fd != sock) close(fd);
+        }
+    }
+    // The handlers of the shell mean nothing here. Signals that were ignored when the shell
+    // started stay ignored in the commands.
+    sigemptyset(&ignored);
+    memset(&sa, 0, sizeof(sa));
+    sigemptyset(&sa.sa_mask);
+    for (i = 1; i < NSIG; i++) {
+        struct sigaction old;
+        if (i == SIGKILL || i == SIGSTOP || sigaction(i, NULL, &old) < 0) continue;
+        if (old.sa_handler == SIG_IGN) {
+            sigaddset(&ignored, i);
+        } else if (old.sa_handler != SIG_DFL) {
+            sa.sa_handler = SIG_DFL;
+            sigaction(i, &sa, NULL);
+        }
+    }
+    // The helper lives as long as the shell, which it learns from the socket.
+    sa.sa_handler = SIG_IGN;
+    for (i = 0; i < sizeof(quiet) / sizeof(*quiet); i++) sigaction(quiet[i], &sa, NULL);
+    sigemptyset(&none);
+    sigprocmask(SIG_SETMASK, &none, NULL);
+    while (srv_serve(sock, &ignored)) {
+        ;  // empty loop
+    }
+    _exit(0);
+}
+
+bool sh_forksrv_active(Shell_t *shp) {
+    UNUSED(shp);
+    return srv.fd >= 0 && srv.owner == getpid();
+}
+
+//
+// Start the helper if KSH_FORKSERVER is set and the shell is not interactive. A shell that runs
+// with other than its real user and group ids doesn't start it, since the helper would keep the
+// ids when `set +p` drops them.
+//
+void sh_forksrv_start(Shell_t *shp) {
+    Namval_t *np = nv_search("KSH_FORKSERVER", shp->var_tree, 0);
+    int sv[2];
+    pid_t pid;
+
+    if (!np || nv_isnull(np) || srv.fd >= 0 || sh_isoption(shp, SH_INTERACTIVE)) return;
+    if (sh_isoption(shp, SH_PRIVILEGED) || shp->gd->userid != shp->gd->euserid ||
+        shp->gd->groupid != shp->gd->egroupid) {
+        return;
+    }
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0) return;
+    pid = clone(srv_main, srv_stack + SRV_STACK, 0, (void *)(intptr_t)sv[1]);
+    close(sv[1]);
+    if (pid < 0) {
+        close(sv[0]);
+        return;
+    }
+    srv.pid = pid;
+    srv.owner = getpid();
+    srv.fd = sh_iomovefd(shp, sv[0]);
+    // Redirections that need the descriptor move it and update srv.fd.
+    shp->fdptrs[srv.fd] = &srv.fd;
+}
+
+//
+// Stop the helper. Commands are then started by forking the shell.
+//
+void sh_forksrv_stop(Shell_t *shp) {
+    int status;
+
+    if (!sh_forksrv_active(shp)) return;
+    sh_close(srv.fd);
+    srv.fd = -1;
+    while (waitpid(srv.pid, &status, __WCLONE) < 0 && errno == EINTR) {
+        ;  // empty loop
+    }
+}
+
+//
+// Have the helper start <path> with arguments <argv> and environment <envp>. Returns the process id
+// of the command, which is a child of the shell, or -1 with errno set when the command could not be
+// started this way.
+//
+pid_t sh_forksrv_spawn(Shell_t *shp, const char *path, char *const argv[], char *const envp[]) {
+    struct srvreq req;
+    struct srvrep rep;
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(SRV_MAXFD * sizeof(int))];
+    } cbuf;
+    struct iovec iov[2];
+    struct msghdr msg;
+    struct cmsghdr *cmp;
+    int fds[SRV_MAXFD], fd, flags, sig, offset;
+    char *const *av, *trap;
+    ssize_t n;
+    size_t size;
+
+    if (!sh_forksrv_active(shp) || shp->pwdfd < 0) return -1;
+    memset(&req, 0, sizeof(req));
+    fds[0] = shp->pwdfd;
+    req.nfd = 1;
+    for (fd = 0; fd < shp->gd->lim.open_max; fd++) {
+        if (fd == srv.fd || (flags = fcntl(fd, F_GETFD)) < 0 || (flags & FD_CLOEXEC)) continue;
+        if (req.nfd == SRV_MAXFD) return -1;
+        req.fd[req.nfd] = fd;
+        fds[req.nfd++] = fd;
+    }
+    req.mask = shp->mask;
+    sigemptyset(&req.ignore);
+    for (sig = 1; sig < shp->gd->sigmax && sig < NSIG; sig++) {
+        if (sig == SIGCHLD) continue;
+        trap = shp->st.trapcom[sig];
+        if ((shp->sigflag[sig] & SH_SIGOFF) || (trap && !*trap)) sigaddset(&req.ignore, sig);
+    }
+    offset = stktell(shp->stk);
+    sfputr(shp->stk, path, 0);
+    for (av = argv; *av; av++, req.argc++) sfputr(shp->stk, *av, 0);
+    for (av = envp; *av; av++, req.envc++) sfputr(shp->stk, *av, 0);
+    req.size = stktell(shp->stk) - offset;
+
+    iov[0].iov_base = &req;
+    iov[0].iov_len = sizeof(req);
+    iov[1].iov_base = stkptr(shp->stk, offset);
+    iov[1].iov_len = req.size;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    msg.msg_control = cbuf.buf;
+    msg.msg_controllen = CMSG_SPACE(req.nfd * sizeof(int));
+    cmp = CMSG_FIRSTHDR(&msg);
+    cmp->cmsg_level = SOL_SOCKET;
+    cmp->cmsg_type = SCM_RIGHTS;
+    cmp->cmsg_len = CMSG_LEN(req.nfd * sizeof(int));
+    memcpy(CMSG_DATA(cmp), fds, req.nfd * sizeof(int));
+    while ((n = sendmsg(srv.fd, &msg, MSG_NOSIGNAL)) < 0 && errno == EINTR) {
+        ;  // empty loop
+    }
+    size = sizeof(req) + req.size;
+    if (n >= 0 && n < size) {
+        // The descriptors went with the first part. Send the rest of the strings.
+        if (n < sizeof(req)) {
+            if (!srv_write(srv.fd, (char *)&req + n, sizeof(req) - n)) n = -1;
+            else n = sizeof(req);
+        }
+        if (n >= 0 && !srv_write(srv.fd, stkptr(shp->stk, offset) + n - sizeof(req),
+                                 size - n)) {
+            n = -1;
+        }
+    }
+    stkseek(shp->stk, offset);
+    if (n < 0 || !srv_read(srv.fd, &rep, sizeof(rep))) {
+        // The helper is gone. Run commands by forking from now on.
+        sh_forksrv_stop(shp);
+        errno = EAGAIN;
+        return -1;
+    }
+    if (rep.err) {
+        // The child exited without running the command. It is not a job, so reap it here. The
+        // caller holds the job lock, so job_reap() can't get to it first.
+        while (rep.pid > 0 && waitpid(rep.pid, &flags, 0) < 0 && errno == EINTR) {
+            ;  // empty loop
+        }
+        errno = rep.err;
+        return -1;
+    }
+    sh_stats(STAT_SPAWN);
+    return rep.pid;
+}
+
+#else  // __linux__ && CLONE_PARENT && SCM_RIGHTS && MSG_CMSG_CLOEXEC
+
+bool sh_forksrv_active(Shell_t *shp) {
+    UNUSED(shp);
+    return false;
+}
+
+void sh_forksrv_start(Shell_t *shp) { UNUSED(shp); }
+
+void sh_forksrv_stop(Shell_t *shp) { UNUSED(shp); }
+
+pid_t sh_forksrv_spawn(Shell_t *shp, const char *path, char *const argv[], char *const envp[]) {
+    UNUSED(shp);
+    UNUSED(path);
+    UNUSED(argv);
+    UNUSED(envp);
+    errno = ENOSYS;
+    return -1;
+}
+
+#endif  // __linux__ && CLONE_PARENT && SCM_RIGHTS && MSG_CMSG_CLOEXEC
@@ -375,6 +375,7 @@ static_fn void put_lang(Namval_t *np, const void *val, nvflag_t flags, Namfun_t
             }
             return;
         }
+        if (type == LC_ALL || type == LC_NUMERIC) nv_numflush();
     }
 
     nv_putv(np, val, flags, fp);
@@ -992,6 +993,14 @@ static_fn void math_init(Shell_t *shp) {
     }
 }
 
+//
+// Return the nodes for the arguments of math functions. They are made when first needed.
+//
+char *sh_mathnodes(Shell_t *shp) {
+    if (!shp->mathnodes) math_init(shp);
+    return shp->mathnodes;
+}
+
 static_fn Namval_t *create_math(Namval_t *np, const void *vp, nvflag_t flag, Namfun_t *fp) {
     UNUSED(flag);
     const char *name = vp;
@@ -1002,7 +1011,7 @@ static_fn Namval_t *create_math(Namval_t *np, const void *vp, nvflag_t flag, Nam
         return 0;
     }
     fp->last = (char *)&name[4];
-    return nv_namptr(shp->mathnodes, name[3] - '1');
+    return nv_namptr(sh_mathnodes(shp), name[3] - '1');
 }
 
 static_fn char *get_math(Namval_t *np, Namfun_t *fp) {
@@ -1208,7 +1217,6 @@ Shell_t *sh_init(int argc, char *argv[], Shinit_f userinit) {
         shgd->lim.child_max = sysconf(_SC_CHILD_MAX);
         if (shgd->lim.arg_max <= 0) shgd->lim.arg_max = ARG_MAX;
         if (shgd->lim.child_max <= 0) shgd->lim.child_max = CHILD_MAX;
-        shgd->ed_context = ed_open(shp);
         error_info.exit = no_shell_context_sh_exit;
         error_info.id = path_basename(argv[0]);
     } else {
@@ -1374,6 +1382,7 @@ Shell_t *sh_init(int argc, char *argv[], Shinit_f userinit) {
     shp->bltindata.shp = shp;
     shp->bltindata.shrun = sh_run;
     shp->bltindata.shexit = sh_exit;
+    shp->bltindata.api = &sh_api;
 
 #if 0
 #define NV_MKINTTYPE(x, y, z) nv_mkinttype(#x, sizeof(x), (x)-1 < 0, (y), (Namdisc_t *)z);
@@ -1430,6 +1439,7 @@ int sh_reinit(Shell_t *shp, char *argv[]) {
         sfclose(shp->heredocs);
         shp->heredocs = NULL;
     }
+    sh_tforget();
     // Remove locals.
     sh_onstate(shp, SH_INIT);
     memset(&data, 0, sizeof(data));
@@ -1627,6 +1637,21 @@ static_fn int svar_init(Shell_t *shp, Namval_t *pp, const Shtable_t *tab, size_t
     return nnodes;
 }
 
+// Unsetting .sh.stats clears the statistics rather than remove the variable.
+static_fn void put_stats(Namval_t *np, const void *val, nvflag_t flags, Namfun_t *fp) {
+    if (!val) {
+        sh_statreset(sh_ptr(np));
+        return;
+    }
+    nv_putv(np, val, flags, fp);
+}
+
+static const Namdisc_t stats_disc = {.dsize = 0,
+                                     .putval = put_stats,
+                                     .createf = create_svar,
+                                     .clonef = clone_svar,
+                                     .nextf = next_svar};
+
 static_fn void stat_init(Shell_t *shp) {
     Namval_t *np;
     struct Svars *sp;
@@ -1634,6 +1659,7 @@ static_fn void stat_init(Shell_t *shp) {
     n = svar_init(shp, SH_STATS, shtab_stats, 0);
     shgd->stats = calloc(sizeof(int), n + 1);
     sp = (struct Svars *)SH_STATS->nvfun->next;
+    sp->namfun.disc = &stats_disc;
     sp->data = shgd->stats;
     sp->dsize = (n + 1) * sizeof(shgd->stats[0]);
     for (i = 0; i < n; i++) {
@@ -1833,8 +1859,10 @@ static_fn Init_t *nv_init(Shell_t *shp) {
     nrp->root = nv_dict(DOTSHNOD);
     nrp->table = DOTSHNOD;
     nv_onattr(VERSIONNOD, NV_REF);
-    math_init(shp);
-    if (!shgd->stats) stat_init(shp);
+    if (!shgd->stats) {
+        stat_init(shp);
+        sh_statinit(shp);
+    }
     siginfo_init(shp);
     return ip;
 }
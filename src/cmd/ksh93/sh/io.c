@@ -55,6 +55,7 @@
 #include "jobs.h"
 #include "name.h"
 #include "path.h"
+#include "probe.h"
 #include "sfio.h"
 #include "shcmd.h"
 #include "shnodes.h"
@@ -1111,6 +1112,7 @@ int sh_redirect(Shell_t *shp, struct ionod *iop, int flag) {
     Spawnvex_t *vc = shp->vex;
 #endif
     Sfio_t *sp;
+    uint64_t start;
 
     flag &= ~(IOHERESTRING | IOUSEVEX);
     if (flag == 2) clexec = 1;
@@ -1163,6 +1165,7 @@ int sh_redirect(Shell_t *shp, struct ionod *iop, int flag) {
         }
         errno = 0;
         np = NULL;
+        SH_PROBE3(redirect, fn, iof, fname);
 #if SHOPT_COSHELL
         if (shp->inpool) {
             if (!(iof & (IODOC | IOLSEEK | IOMOV))) sh_coaddfile(shp, fname);
@@ -1195,7 +1198,10 @@ int sh_redirect(Shell_t *shp, struct ionod *iop, int flag) {
         if (*fname || (iof & (IODOC | IOSTRG)) == (IODOC | IOSTRG)) {
             if (iof & IODOC) {
                 if (traceon) sfputr(sfstderr, io_op, '<');
+                start = sh_statclock();
                 fd = io_heredoc(shp, iop, fname, traceon | herestring);
+                sh_stats(STAT_HEREDOCS);
+                sh_stattime(STAT_THEREDOC, sh_statclock() - start);
                 if (traceon && (flag == SH_SHOWME)) sh_close(fd);
                 fname = 0;
             } else if (iof & IOMOV) {
@@ -2058,7 +2064,7 @@ static_fn ssize_t piperead(Sfio_t *iop, void *buff, size_t size, Sfdisc_t *handl
     }
     sh_onstate(shp, SH_TTYWAIT);
     if (!(shp->fdstatus[fd] & IOCLEX) && (sfset(iop, 0, 0) & SF_SHARE)) {
-        size = ed_read(shgd->ed_context, fd, (char *)buff, size, 0);
+        size = ed_read(ed_getcontext(), fd, (char *)buff, size, 0);
     } else {
         size = sfrd(iop, buff, size, handle);
     }
@@ -2095,7 +2101,7 @@ static_fn ssize_t slowread(Sfio_t *iop, void *buff, size_t size, Sfdisc_t *handl
             timeout = sh_timeradd(sh_isstate(shp, SH_GRACE) ? 1000L * TGRACE : 1000L * shp->timeout,
                                   0, time_grace, shp);
         }
-        rsize = (*readf)(shgd->ed_context, sffileno(iop), (char *)buff, size, reedit);
+        rsize = (*readf)(ed_getcontext(), sffileno(iop), (char *)buff, size, reedit);
         if (timeout) {
             timerdel(timeout);
             timeout = NULL;
@@ -2329,7 +2335,7 @@ static_fn void sftrack(Sfio_t *sp, int flag, void *data) {
     if (sh_isstate(shp, SH_NOTRACK)) return;
 
     mode = sfset(sp, 0, 0);
-    if (sp == shp->heredocs && fd < 10 && flag == SF_SETFD) {
+    if (sp == shp->heredocs && fd < 10 && (flag == SF_SETFD || flag == SF_TMPFILE)) {
         fd = sfsetfd(sp, 10);
         (void)fcntl(fd, F_SETFD, FD_CLOEXEC);
     }
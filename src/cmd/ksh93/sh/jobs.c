@@ -35,8 +35,10 @@
 #include <sched.h>
 #include <signal.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
 #include <sys/wait.h>
 #include <termios.h>
 #include <unistd.h>
@@ -51,6 +53,7 @@
 #include "jobs.h"
 #include "name.h"
 #include "path.h"
+#include "probe.h"
 #include "sfio.h"
 #include "terminal.h"
 #include "variables.h"
@@ -351,6 +354,28 @@ static_fn void job_waitsafe(int sig, siginfo_t *info, void *context) {
     errno = saved_errno;
 }
 
+//
+// Wait for any child like waitpid() and note the largest resident set size of the children that
+// are reaped for the `time` keyword.
+//
+static_fn pid_t job_waitpid(int *wstat, int flags) {
+#if _lib_wait4
+    struct rusage usage;
+    pid_t pid = wait4((pid_t)-1, wstat, flags, &usage);
+
+    if (pid > 0) {
+        long maxrss = usage.ru_maxrss;
+#if __APPLE__
+        maxrss /= 1024;  // macOS counts bytes rather than kilobytes
+#endif
+        if (maxrss > job.maxrss) job.maxrss = maxrss;
+    }
+    return pid;
+#else
+    return waitpid((pid_t)-1, wstat, flags);
+#endif
+}
+
 //
 // Reap one job. // When called with sig==0, it does a blocking wait.
 //
@@ -435,7 +460,7 @@ bool job_reap(int sig) {
             cotimeout = 0;
         }
 #endif  // SHOPT_COSHELL
-        pid = waitpid((pid_t)-1, &wstat, flags);
+        pid = job_waitpid(&wstat, flags);
         if (!was_ttywait_on) sh_offstate(shp, SH_TTYWAIT);
 #if SHOPT_COSHELL
     cojob:
@@ -443,7 +468,7 @@ bool job_reap(int sig) {
 
         // Some systems (linux 2.6) may return EINVAL when there are no continued children.
         if (pid < 0 && errno == EINVAL && (flags & WCONTINUED)) {
-            pid = waitpid((pid_t)-1, &wstat, flags &= ~WCONTINUED);
+            pid = job_waitpid(&wstat, flags &= ~WCONTINUED);
         }
         sh_sigcheck(shp);
         if (pid < 0 && errno == EINTR && (sig || job.savesig)) {
@@ -451,6 +476,7 @@ bool job_reap(int sig) {
             continue;
         }
         if (pid <= 0) break;
+        SH_PROBE2(reap, pid, wstat);
         if (pid == shp->spid) shp->spid = 0;
         if (wstat == 0) job_chksave(pid, -1);
         flags |= WNOHANG;
@@ -1396,6 +1422,7 @@ bool job_wait(pid_t pid) {
     int jobid = 0;
     bool nochild = true;
     char intr = 0;
+    uint64_t start, elapsed;
 
     if (pid < 0) {
         pid = -pid;
@@ -1447,6 +1474,8 @@ bool job_wait(pid_t pid) {
         sh_close(shp->cpipe[1]);
         shp->cpipe[1] = shp->coutpipe = -1;
     }
+    SH_PROBE1(wait__start, pid);
+    start = sh_statclock();
     while (1) {
         if (job.waitsafe) {
             for (px = job.pwlist; px; px = px->p_nxtjob) {
@@ -1506,6 +1535,11 @@ bool job_wait(pid_t pid) {
         if (nochild) break;
         if ((intr && (shp->trapnote & (SH_SIGSET | SH_SIGTRAP))) || (pid == 1 && !intr)) break;
     }
+    elapsed = sh_statclock() - start;
+    sh_stats(STAT_WAITS);
+    sh_stattime(STAT_TWAIT, elapsed);
+    if (sh_profon) sh_profwait(shp, elapsed);
+    SH_PROBE3(wait__done, pid, shp->exitval, elapsed);
     if (intr && (shp->trapnote & (SH_SIGSET | SH_SIGTRAP))) shp->exitval = 1;
     pwfg = 0;
     if (pid == 1) {
@@ -0,0 +1,526 @@
+//
+// Streaming JSON reader used by `read -m json`.
+//
+// The document is consumed a character at a time from the input stream and each value is stored
+// directly into the shell variable tree with the nv_* APIs as soon as it has been scanned. Nothing
+// is converted to shell text and evaluated. Memory use is bounded by the nesting depth of the
+// document and the size of its largest string, not by the size of the document.
+//
+// Objects become compound variables, arrays become indexed arrays, integers `typeset -li`,
+// other numbers `typeset -lE`, `true` and `false` instances of the `_Bool` enum, and members whose
+// value is `null` are left unset. Scalar arrays take the numeric type of their first element and
+// fall back to strings if a later element has a different type.
+//
+#include "config_ast.h"  // IWYU pragma: keep
+
+#include <ctype.h>
+#include <errno.h>
+#include <float.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "defs.h"
+#include "error.h"
+#include "name.h"
+#include "sfio.h"
+#include "stk.h"
+
+// Deeper documents are rejected rather than risk exhausting the C stack.
+#define JSON_MAXDEPTH 1024
+
+// Scalar kinds. Used to type indexed arrays from their first element.
+#define JSON_NONE 0
+#define JSON_STRING 1
+#define JSON_INTEGER 2
+#define JSON_FLOAT 3
+#define JSON_BOOL 4
+#define JSON_CONTAINER 5
+
+#define NV_JSONNUM (NV_INTEGER | NV_DOUBLE | NV_LONG | NV_SHORT | NV_UNSIGN | NV_EXPNOTE)
+
+struct json {
+    Shell_t *shp;
+    Sfio_t *in;
+    Namval_t *booltype;  // the `_Bool` enum, if defined
+    char *name;          // name of the variable the current value is assigned to
+    size_t namelen;
+    size_t namesize;
+    int line;
+    int depth;
+};
+
+static_fn void json_error(struct json *jp, const char *msg) {
+    errormsg(SH_DICT, 2, "json: line %d: %s", jp->line, msg);
+}
+
+static_fn int json_getc(struct json *jp) {
+    int c = sfgetc(jp->in);
+    if (c == '\n') jp->line++;
+    return c;
+}
+
+// Return the next character that is not JSON white space.
+static_fn int json_skipws(struct json *jp) {
+    int c;
+
+    while ((c = json_getc(jp)) == ' ' || c == '\t' || c == '\n' || c == '\r') {
+        ;  // empty loop
+    }
+    return c;
+}
+
+static_fn void json_namegrow(struct json *jp, size_t n) {
+    if (jp->namelen + n + 1 <= jp->namesize) return;
+    while (jp->namelen + n + 1 > jp->namesize) jp->namesize *= 2;
+    jp->name = realloc(jp->name, jp->namesize);
+    if (!jp->name) {
+        errormsg(SH_DICT, ERROR_system(1), e_nospace);
+        __builtin_unreachable();
+    }
+}
+
+static_fn void json_nameadd(struct json *jp, const char *cp, size_t n) {
+    json_namegrow(jp, n);
+    memcpy(jp->name + jp->namelen, cp, n);
+    jp->namelen += n;
+    jp->name[jp->namelen] = 0;
+}
+
+// Append the compound member <key> to the current name. Keys that are not valid identifiers use
+// the `.[key]` form with `[`, `]` and `\` escaped so nv_endsubscript() finds the closing bracket.
+static_fn void json_pushkey(struct json *jp, const char *key) {
+    const char *cp = key;
+    bool isname = isalpha(*(unsigned char *)cp) || *cp == '_';
+
+    while (isname && *++cp) isname = isalnum(*(unsigned char *)cp) || *cp == '_';
+    if (isname) {
+        json_nameadd(jp, ".", 1);
+        json_nameadd(jp, key, strlen(key));
+        return;
+    }
+    json_nameadd(jp, ".[", 2);
+    for (cp = key; *cp; cp++) {
+        if (*cp == '[' || *cp == ']' || *cp == '\\') json_nameadd(jp, "\\", 1);
+        json_nameadd(jp, cp, 1);
+    }
+    json_nameadd(jp, "]", 1);
+}
+
+static_fn void json_pushindex(struct json *jp, long index) {
+    char buf[32];
+    int n = snprintf(buf, sizeof(buf), "[%ld]", index);
+    json_nameadd(jp, buf, n);
+}
+
+static_fn void json_pututf8(Stk_t *stk, uint32_t wc) {
+    if (wc < 0x80) {
+        sfputc(stk, wc);
+    } else if (wc < 0x800) {
+        sfputc(stk, 0xc0 | (wc >> 6));
+        sfputc(stk, 0x80 | (wc & 0x3f));
+    } else if (wc < 0x10000) {
+        sfputc(stk, 0xe0 | (wc >> 12));
+        sfputc(stk, 0x80 | ((wc >> 6) & 0x3f));
+        sfputc(stk, 0x80 | (wc & 0x3f));
+    } else {
+        sfputc(stk, 0xf0 | (wc >> 18));
+        sfputc(stk, 0x80 | ((wc >> 12) & 0x3f));
+        sfputc(stk, 0x80 | ((wc >> 6) & 0x3f));
+        sfputc(stk, 0x80 | (wc & 0x3f));
+    }
+}
+
+static_fn int json_hex4(struct json *jp) {
+    int c, n, wc = 0;
+
+    for (n = 0; n < 4; n++) {
+        c = json_getc(jp);
+        if (!isxdigit(c)) return -1;
+        wc = (wc << 4) | (isdigit(c) ? c - '0' : (tolower(c) - 'a' + 10));
+    }
+    return wc;
+}
+
+// Scan a string whose opening quote has been read onto the stack. Return the offset of the NUL
+// terminated result or -1 on error.
+static_fn ssize_t json_string(struct json *jp) {
+    Stk_t *stk = jp->shp->stk;
+    size_t offset = stktell(stk);
+    int c, wc, lo;
+
+    while ((c = json_getc(jp)) != '"') {
+        if (c < 0x20) {
+            json_error(jp, c < 0 ? "unterminated string" : "control character in string");
+            return -1;
+        }
+        if (c != '\\') {
+            sfputc(stk, c);
+            continue;
+        }
+        switch (c = json_getc(jp)) {
+            case '"':
+            case '\\':
+            case '/': {
+                sfputc(stk, c);
+                break;
+            }
+            case 'b': {
+                sfputc(stk, '\b');
+                break;
+            }
+            case 'f': {
+                sfputc(stk, '\f');
+                break;
+            }
+            case 'n': {
+                sfputc(stk, '\n');
+                break;
+            }
+            case 'r': {
+                sfputc(stk, '\r');
+                break;
+            }
+            case 't': {
+                sfputc(stk, '\t');
+                break;
+            }
+            case 'u': {
+                if ((wc = json_hex4(jp)) < 0) {
+                    json_error(jp, "invalid \\u escape");
+                    return -1;
+                }
+                if (wc >= 0xd800 && wc < 0xdc00) {
+                    // A high surrogate must be followed by an escaped low surrogate.
+                    if (json_getc(jp) != '\\' || json_getc(jp) != 'u' ||
+                        (lo = json_hex4(jp)) < 0xdc00 || lo >= 0xe000) {
+                        json_error(jp, "invalid surrogate pair");
+                        return -1;
+                    }
+                    wc = 0x10000 + ((wc - 0xd800) << 10) + (lo - 0xdc00);
+                } else if (wc >= 0xdc00 && wc < 0xe000) {
+                    json_error(jp, "invalid surrogate pair");
+                    return -1;
+                } else if (wc == 0) {
+                    json_error(jp, "\\u0000 cannot be stored in a variable");
+                    return -1;
+                }
+                json_pututf8(stk, wc);
+                break;
+            }
+            default: {
+                json_error(jp, "invalid escape sequence");
+                return -1;
+            }
+        }
+    }
+    sfputc(stk, 0);
+    return offset;
+}
+
+// Scan a number whose first character is <c> onto the stack. Return the offset of the NUL
+// terminated text or -1 on error. `*isfloat` is set if it has a fraction or exponent.
+static_fn ssize_t json_number(struct json *jp, int c, bool *isfloat) {
+    Stk_t *stk = jp->shp->stk;
+    size_t offset = stktell(stk);
+    int ndigits;
+
+    *isfloat = false;
+    if (c == '-') {
+        sfputc(stk, c);
+        c = json_getc(jp);
+    }
+    if (c == '0') {
+        sfputc(stk, c);
+        c = json_getc(jp);
+    } else if (isdigit(c)) {
+        do {
+            sfputc(stk, c);
+        } while (isdigit(c = json_getc(jp)));
+    } else {
+        goto bad;
+    }
+    if (c == '.') {
+        *isfloat = true;
+        sfputc(stk, c);
+        for (ndigits = 0; isdigit(c = json_getc(jp)); ndigits++) sfputc(stk, c);
+        if (!ndigits) goto bad;
+    }
+    if (c == 'e' || c == 'E') {
+        *isfloat = true;
+        sfputc(stk, 'e');
+        c = json_getc(jp);
+        if (c == '+' || c == '-') {
+            sfputc(stk, c);
+            c = json_getc(jp);
+        }
+        for (ndigits = 0; isdigit(c); ndigits++, c = json_getc(jp)) sfputc(stk, c);
+        if (!ndigits) goto bad;
+    }
+    if (c >= 0) {
+        if (c == '\n') jp->line--;
+        sfungetc(jp->in, c);
+    }
+    sfputc(stk, 0);
+    return offset;
+
+bad:
+    json_error(jp, "invalid number");
+    return -1;
+}
+
+// Match the rest of the literal <word> whose first character has been read.
+static_fn bool json_literal(struct json *jp, const char *word) {
+    while (*++word) {
+        if (json_getc(jp) != *word) {
+            json_error(jp, "invalid literal");
+            return false;
+        }
+    }
+    return true;
+}
+
+static_fn Namval_t *json_open(struct json *jp) {
+    Namval_t *np, *mp;
+
+    np = nv_open(jp->name, jp->shp->var_tree, NV_VARNAME | NV_ARRAY);
+    if (np && nv_isarray(np) && (mp = nv_opensub(np))) np = mp;
+    return np;
+}
+
+// An array whose elements are not all of the same kind is downgraded to a string array. Existing
+// elements are converted. That walks the array so <np> is opened again afterwards.
+static_fn Namval_t *json_mixed(struct json *jp, Namval_t *np) {
+    nv_newattr(np, np->nvflag & ~NV_JSONNUM, 0);
+    nv_close(np);
+    return nv_open(jp->name, jp->shp->var_tree, NV_VARNAME);
+}
+
+// Store a scalar of <kind> in the variable named by the current name. <container> is the kind
+// already established for the enclosing indexed array, if any, and is updated.
+static_fn void json_assign(struct json *jp, const char *val, int kind, int *container) {
+    Namval_t *np = nv_open(jp->name, jp->shp->var_tree, NV_VARNAME | NV_ASSIGN);
+    Sflong_t l;
+    Sfdouble_t d;
+
+    if (!np) return;
+    if (container) {
+        // Booleans in arrays are stored as strings since an enum type can't be removed from an
+        // array when a later element turns out to be of another kind.
+        if (kind == JSON_BOOL) kind = JSON_STRING;
+        if (*container == JSON_NONE) {
+            *container = kind;
+        } else if (*container != kind && *container != JSON_STRING) {
+            np = json_mixed(jp, np);
+            *container = JSON_STRING;
+        }
+        if (kind != JSON_NONE) kind = *container;
+    }
+    switch (kind) {
+        case JSON_INTEGER: {
+            if (nv_isattr(np, NV_JSONNUM) != NV_INT64) nv_newattr(np, NV_INT64, 10);
+            l = strtoll(val, NULL, 10);
+            nv_putval(np, &l, NV_INT64);
+            break;
+        }
+        case JSON_FLOAT: {
+            if (nv_isattr(np, NV_JSONNUM) != (NV_LDOUBLE | NV_EXPNOTE)) {
+                nv_newattr(np, NV_LDOUBLE | NV_EXPNOTE, LDBL_DIG - 2);
+            }
+            d = strtold(val, NULL);
+            nv_putval(np, &d, NV_LDOUBLE);
+            break;
+        }
+        case JSON_BOOL: {
+            if (jp->booltype && nv_type(np) != jp->booltype) nv_settype(np, jp->booltype, 0);
+            nv_putval(np, val, 0);
+            break;
+        }
+        case JSON_STRING: {
+            nv_putval(np, val ? val : "", 0);
+            break;
+        }
+        default: { break; }
+    }
+    nv_close(np);
+}
+
+static_fn bool json_value(struct json *jp, int c, int *container);
+
+static_fn bool json_object(struct json *jp) {
+    Stk_t *stk = jp->shp->stk;
+    size_t namelen = jp->namelen;
+    ssize_t offset;
+    int c;
+
+    c = json_skipws(jp);
+    if (c == '}') return true;
+    while (1) {
+        if (c != '"') {
+            json_error(jp, "object member name expected");
+            return false;
+        }
+        if ((offset = json_string(jp)) < 0) return false;
+        json_pushkey(jp, stkptr(stk, offset));
+        stkseek(stk, offset);
+        if (json_skipws(jp) != ':') {
+            json_error(jp, "':' expected");
+            return false;
+        }
+        if (!json_value(jp, json_skipws(jp), NULL)) return false;
+        jp->namelen = namelen;
+        jp->name[namelen] = 0;
+        c = json_skipws(jp);
+        if (c == '}') return true;
+        if (c != ',') {
+            json_error(jp, "',' or '}' expected");
+            return false;
+        }
+        c = json_skipws(jp);
+    }
+}
+
+static_fn bool json_array(struct json *jp) {
+    Namval_t *np;
+    size_t namelen = jp->namelen;
+    int c, kind = JSON_NONE;
+    long index = 0;
+
+    c = json_skipws(jp);
+    if (c == ']') {
+        np = json_open(jp);
+        if (!np) return false;
+        if (nv_isnull(np)) nv_onattr(np, NV_ARRAY);
+        nv_close(np);
+        return true;
+    }
+    while (1) {
+        json_pushindex(jp, index++);
+        if (!json_value(jp, c, &kind)) return false;
+        jp->namelen = namelen;
+        jp->name[namelen] = 0;
+        c = json_skipws(jp);
+        if (c == ']') return true;
+        if (c != ',') {
+            json_error(jp, "',' or ']' expected");
+            return false;
+        }
+        c = json_skipws(jp);
+    }
+}
+
+// Parse the value whose first character is <c> and assign it to the current name.
+static_fn bool json_value(struct json *jp, int c, int *container) {
+    Stk_t *stk = jp->shp->stk;
+    Namval_t *np;
+    ssize_t offset;
+    bool isfloat, r;
+
+    switch (c) {
+        case '{':
+        case '[': {
+            if (++jp->depth > JSON_MAXDEPTH) {
+                json_error(jp, "nesting too deep");
+                return false;
+            }
+            if (container) {
+                if (*container == JSON_INTEGER || *container == JSON_FLOAT) {
+                    np = nv_open(jp->name, jp->shp->var_tree, NV_VARNAME);
+                    if (np) nv_close(json_mixed(jp, np));
+                }
+                *container = JSON_CONTAINER;
+            }
+            if (c == '[') {
+                // Elements are created by assignment. An empty array is created by json_array().
+                r = json_array(jp);
+                jp->depth--;
+                return r;
+            }
+            np = json_open(jp);
+            if (!np) return false;
+            nv_setvtree(np);
+            nv_close(np);
+            r = json_object(jp);
+            jp->depth--;
+            return r;
+        }
+        case '"': {
+            if ((offset = json_string(jp)) < 0) return false;
+            json_assign(jp, stkptr(stk, offset), JSON_STRING, container);
+            stkseek(stk, offset);
+            return true;
+        }
+        case 't':
+        case 'f': {
+            if (!json_literal(jp, c == 't' ? "true" : "false")) return false;
+            json_assign(jp, c == 't' ? "true" : "false", JSON_BOOL, container);
+            return true;
+        }
+        case 'n': {
+            if (!json_literal(jp, "null")) return false;
+            json_assign(jp, NULL, JSON_NONE, container);
+            return true;
+        }
+        default: {
+            if (c != '-' && !isdigit(c)) break;
+            if ((offset = json_number(jp, c, &isfloat)) < 0) return false;
+            if (!isfloat) {
+                // Integers that do not fit in 64 bits are stored as floating point.
+                errno = 0;
+                (void)strtoll(stkptr(stk, offset), NULL, 10);
+                if (errno == ERANGE) isfloat = true;
+            }
+            json_assign(jp, stkptr(stk, offset), isfloat ? JSON_FLOAT : JSON_INTEGER, container);
+            stkseek(stk, offset);
+            return true;
+        }
+    }
+    json_error(jp, c < 0 ? "unexpected end of input" : "value expected");
+    return false;
+}
+
+//
+// Read one JSON document from <in> into the compound variable <np>. The top level value must be
+// an object or an array. Return 0 on success, non-zero on a syntax error or end of file.
+//
+int sh_readjson(Shell_t *shp, Namval_t *np, Sfio_t *in) {
+    struct json json;
+    size_t offset = stktell(shp->stk);
+    int c;
+    bool r;
+
+    memset(&json, 0, sizeof(json));
+    json.shp = shp;
+    json.in = in;
+    json.line = 1;
+    json.booltype = nv_search("_Bool", shp->typedict, 0);
+    json.namesize = 256;
+    json.name = malloc(json.namesize);
+    if (!json.name) {
+        errormsg(SH_DICT, ERROR_system(1), e_nospace);
+        __builtin_unreachable();
+    }
+    json.name[0] = 0;
+    json_nameadd(&json, nv_name(np), strlen(nv_name(np)));
+
+    c = json_skipws(&json);
+    if (c < 0) {
+        r = false;
+    } else if (c != '{' && c != '[') {
+        json_error(&json, "object or array expected");
+        r = false;
+    } else {
+        if (c == '[') {
+            // The caller prepared a compound variable. Turn it into an indexed array.
+            nv_unset(np);
+            nv_onattr(np, NV_ARRAY);
+        }
+        json.depth = 1;
+        r = c == '{' ? json_object(&json) : json_array(&json);
+    }
+    free(json.name);
+    stkseek(shp->stk, offset);
+    return !r;
+}
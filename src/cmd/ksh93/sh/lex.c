@@ -25,6 +25,7 @@
 //
 #include "config_ast.h"  // IWYU pragma: keep
 
+#include <ctype.h>
 #include <errno.h>
 #include <limits.h>
 #include <stdbool.h>
@@ -1536,6 +1537,135 @@ done:
     return messages;
 }
 
+//
+// Return true if the word that sh_lex() has just read from offset <off> on is one of the words in
+// the null terminated list <words>. A word that is no longer in the input buffer counts as one.
+//
+static_fn bool lexword(const char *const *words, Sfoff_t off) {
+    char *last = fcseek(0), *cp;
+    size_t n;
+
+    if (fctell() - off > last - fcfirst()) return true;
+    for (cp = last - (fctell() - off); cp < last && isspace(*cp); cp++) {
+        ;  // empty loop
+    }
+    for (n = last - cp; *words; words++) {
+        if (strlen(*words) == n && strncmp(*words, cp, n) == 0) return true;
+    }
+    return false;
+}
+
+//
+// Skip the body of a function from the opening brace that was just read to the matching closing
+// brace without making a tree for it, as comsub() does for ${ ...; }, except that braces are only
+// taken as such where a reserved word can be. The input has to be a file. Returns false with the
+// input back at the opening brace if a here-document is started on the line of the closing brace.
+//
+bool sh_lexbody(Lex_t *lp) {
+    static const char *const cmdwords[] = {"!",    "do",   "elif",  "else", "if",
+                                           "then", "time", "until", "while", NULL};
+    static const char *const funwords[] = {"function", "namespace", NULL};
+    static const char *const casewords[] = {"case", NULL};
+    static const char *const esacwords[] = {"esac", NULL};
+    Shell_t *shp = lp->sh;
+    struct lexstate save = lp->lex;
+    struct argnod *arg = lp->arg;
+    struct ionod *doc;
+    char *first = lp->lexd.first;
+    int c, count = 1, csub = lp->comsub, assignok = lp->assignok;
+    int64_t line = shp->inlineno;
+    Sfoff_t start = fctell(), off;
+    bool name = false;
+
+    sh_lexopen(lp, shp, 1);
+    lp->lexd.dolparen++;
+    // Nothing is copied to the stack while the body is read.
+    lp->arg = NULL;
+    lp->lexd.first = NULL;
+    pushlevel(lp, 0, 0);
+    while (count > 0) {
+        off = fctell();
+        c = sh_lex(lp);
+        switch (c) {
+            case 0: {
+                if (name) {
+                    // The body of a function follows its name.
+                    name = false;
+                    lp->lex.reservok = 1;
+                } else if (lp->lex.incase) {
+                    // A pattern, or the end of the case statement.
+                    if (lexword(esacwords, off)) lp->lex.incase = 0;
+                    lp->lex.reservok = 0;
+                } else if (lp->lex.reservok && !lexword(cmdwords, off)) {
+                    lp->lex.incase = lexword(casewords, off);
+                    name = lexword(funwords, off);
+                    lp->lex.reservok = 0;
+                }
+                break;
+            }
+            case LBRACE: {
+                if (!lp->lex.incase) count++;
+                break;
+            }
+            case RBRACE: {
+                if (!lp->lex.incase) count--;
+                break;
+            }
+            case RPAREN: {
+                lp->lex.incase = 0;
+                break;
+            }
+            case BREAKCASESYM:
+            case FALLTHRUSYM: {
+                // The next word is a pattern.
+                lp->lex.incase = 1;
+                break;
+            }
+            case EOFSYM: {
+                lp->lastline = line;
+                lp->lasttok = LBRACE;
+                sh_syntax(lp);
+            }
+            case IOSEEKSYM: {
+                c = fcgetc();
+                if (c != '#' && c > 0) fcseek(-LEN);
+                break;
+            }
+            case IODOCSYM: {
+                lp->lexd.docextra = 0;
+                sh_lex(lp);
+                break;
+            }
+            default: { break; }
+        }
+    }
+    poplevel(lp);
+    lp->lexd.dolparen--;
+    lp->lex = save;
+    lp->arg = arg;
+    lp->lexd.first = first;
+    lp->comsub = csub;
+    lp->assignok = assignok;
+    if (!lp->heredoc) return true;
+    // The here-document is read after the brace, so the body has to be parsed now.
+    while ((doc = lp->heredoc)) {
+        lp->heredoc = doc->iolst;
+        free(doc);
+    }
+    off = fctell() - start;
+    if (off <= fcseek(0) - fcfirst()) {
+        fcseek(-off);
+    } else {
+        Sfio_t *iop = fcfile();
+        fcclose();
+        sfseek(iop, start, SEEK_SET);
+        fcfopen(iop);
+    }
+    shp->inlineno = line;
+    lp->token = LBRACE;
+    return false;
+}
+
 //
 // Here-doc nested in $(...).
 // Allocate ionode with delimiter filled in without disturbing stak.
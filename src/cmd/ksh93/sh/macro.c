@@ -54,6 +54,7 @@
 #include "lexstates.h"
 #include "name.h"
 #include "path.h"
+#include "probe.h"
 #include "sfio.h"
 #include "shcmd.h"
 #include "shlex.h"
@@ -1978,6 +1979,7 @@ static_fn void comsubst(Mac_t *mp, Shnode_t *t, volatile int type) {
         type = 1;
     }
     if (t) {
+        SH_PROBE1(comsub__start, error_info.line + mp->shp->st.firstline);
         fcsave(&save);
         if (t->tre.tretyp == TCOM && !t->com.comarg && !t->com.comset) {
             // Special case $(<file) and $(<#file).
@@ -2073,6 +2075,7 @@ static_fn void comsubst(Mac_t *mp, Shnode_t *t, volatile int type) {
         }
     }
     sfclose(sp);
+    SH_PROBE1(comsub__done, error_info.line + mp->shp->st.firstline);
     return;
 }
 
@@ -162,6 +162,8 @@ int sh_main(int ac, char *av[], Shinit_f userinit) {
             sh_onoption(shp, SH_MONITOR);
         }
         job_init(shp, sh_isoption(shp, SH_LOGIN_SHELL));
+        sh_forksrv_start(shp);
+        sh_profstart(shp);
         if (sh_isoption(shp, SH_LOGIN_SHELL)) {
             //  System profile.
             sh_source(shp, iop, e_sysprofile);
@@ -198,24 +200,16 @@ int sh_main(int ac, char *av[], Shinit_f userinit) {
                 sh_source(shp, iop, e_suidprofile);
             }
         }
-        // Add enum type _Bool.
-        i = 0;
-        if (sh_isoption(shp, SH_XTRACE)) {
-            i = 1;
-            sh_offoption(shp, SH_XTRACE);
+        // Add enum type _Bool. This is what `enum _Bool=(false true)` does without parsing and
+        // running the command.
+        {
+            static char *bool_values[] = {"false", "true", NULL};
+            char type[] = NV_CLASS "._Bool";  // nv_open() writes into the name
+            Namval_t *np = nv_open(type + sizeof(NV_CLASS), shp->var_tree, NV_VARNAME);
+            nv_setvec(np, 0, 2, bool_values);
+            sh_mkenum(shp, np, nv_open(type, shp->var_tree, NV_VARNAME), false);
+            nv_open(NULL, shp->var_tree, 0);
         }
-        if (sh_isoption(shp, SH_NOEXEC)) {
-            i |= 2;
-            sh_offoption(shp, SH_NOEXEC);
-        }
-        if (sh_isoption(shp, SH_VERBOSE)) {
-            i |= 4;
-            sh_offoption(shp, SH_VERBOSE);
-        }
-        sh_trap(shp, "enum _Bool=(false true) ;", 0);
-        if (i & 1) sh_onoption(shp, SH_XTRACE);
-        if (i & 2) sh_onoption(shp, SH_NOEXEC);
-        if (i & 4) sh_onoption(shp, SH_VERBOSE);
         shp->st.cmdname = error_info.id = command;
         sh_offstate(shp, SH_PROFILE);
         if (rshflag) sh_onoption(shp, SH_RESTRICTED);
@@ -468,7 +462,7 @@ static_fn void exfile(Shell_t *shp, Sfio_t *iop, int fno) {
             }
         }
         errno = 0;
-        if (tdone || !sfreserve(iop, 0, 0)) {
+        if (tdone || (!sh_tmore(iop) && !sfreserve(iop, 0, 0))) {
         eof_or_error:
             if (sh_isstate(shp, SH_INTERACTIVE) && !sferror(iop)) {
                 if (--maxtry > 0 && sh_isoption(shp, SH_IGNOREEOF) && !sferror(sfstderr)) {
@@ -521,6 +515,8 @@ static_fn void exfile(Shell_t *shp, Sfio_t *iop, int fno) {
         if (sh_isoption(shp, SH_TFLAG) && !sh_isstate(shp, SH_PROFILE)) tdone++;
     }
 done:
+    // Charge the last command to its line while the line and the name of the script are known.
+    if (sh_profon) sh_proftick(shp);
     sh_popcontext(shp, &buff);
     if (sh_isstate(shp, SH_INTERACTIVE)) {
         sfputc(sfstderr, '\n');
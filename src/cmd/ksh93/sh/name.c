@@ -42,7 +42,9 @@
 #include "stk.h"
 #include "variables.h"
 
-#define NVCACHE 8  // must be a power of 2 and not zero
+#define NVCACHE 8    // must be a power of 2 and not zero
+#define NUMCACHE 16  // must be a power of 2 and not zero
+#define NUMTEXT 48   // longest text kept in numcache
 
 // This var used to be writable but was treated as if it was immutable except for one assignment
 // that failed to validate it was modifying only the first, and only, char. So we now make it
@@ -129,6 +131,22 @@ struct Namcache {
 };
 static struct Namcache nvcache;
 
+//
+// Formatting floating point values is slow and the same values tend to be expanded over and over
+// again, so the text of recently formatted values is kept. Entries are found by the value so they
+// never have to be invalidated when a variable changes, only when the locale does since the text
+// holds its decimal point.
+//
+struct Numcache {
+    struct Num_entry {
+        unsigned char value[sizeof(Sfdouble_t)];
+        const char *format;
+        int size;
+        char text[NUMTEXT];
+    } entries[NUMCACHE];
+};
+static struct Numcache numcache;
+
 bool nv_local = false;
 
 // ======== name value pair routines ========
@@ -136,6 +154,54 @@ bool nv_local = false;
 #include "builtins.h"
 #include "shnodes.h"
 
+//
+// Return the text of the floating point value <ld>, or <d> unless <islong> is set, formatted with
+// <format> and precision <size>.
+//
+static_fn char *fmtdouble(Shell_t *shp, const char *format, int size, bool islong, Sfdouble_t ld,
+                          double d) {
+    union {
+        Sfdouble_t ld;
+        double d;
+        unsigned char bytes[sizeof(Sfdouble_t)];
+    } key;
+    struct Num_entry *ep;
+    unsigned int h = size;
+    char *cp;
+    size_t n;
+
+    memset(&key, 0, sizeof(key));
+    if (islong) {
+        key.ld = ld;
+    } else {
+        key.d = d;
+    }
+    for (n = 0; n < sizeof(key.bytes); n++) h = h * 33 + key.bytes[n];
+    ep = &numcache.entries[(h + (h >> 8)) & (NUMCACHE - 1)];
+    if (ep->format == format && ep->size == size && !memcmp(ep->value, key.bytes, sizeof(key))) {
+        sfputr(shp->strbuf, ep->text, -1);
+        return sfstruse(shp->strbuf);
+    }
+    if (islong) {
+        sfprintf(shp->strbuf, format, size, ld);
+    } else {
+        sfprintf(shp->strbuf, format, size, d);
+    }
+    cp = sfstruse(shp->strbuf);
+    if ((n = strlen(cp)) < NUMTEXT) {
+        memcpy(ep->value, key.bytes, sizeof(key));
+        ep->format = format;
+        ep->size = size;
+        memcpy(ep->text, cp, n + 1);
+    }
+    return cp;
+}
+
+//
+// Forget the formatted values after a change of locale.
+//
+void nv_numflush(void) { memset(&numcache, 0, sizeof(numcache)); }
+
 static_fn char *getbuf(size_t len) {
     static char *buf = NULL;
     static size_t buflen = 0;
@@ -1630,6 +1696,8 @@ void nv_putval(Namval_t *np, const void *vp, nvflag_t flags) {
         char *tofree = NULL;
         int offset = 0;
         int append;
+        size_t oldsize;
+        bool reuse = false;
         if (flags & NV_INTEGER) {
             if ((flags & NV_DOUBLE) == NV_DOUBLE) {
                 if (flags & NV_LONG) {
@@ -1748,6 +1816,17 @@ void nv_putval(Namval_t *np, const void *vp, nvflag_t flags) {
                 if (dot == 0 && !nv_isattr(np, NV_LJUST | NV_RJUST)) {
                     cp = (char *)EmptyStr;  // we'd better not try to modify this buf as it's const
                     nv_onattr(np, NV_NOFREE);
+                } else if (tofree && tofree != Empty && tofree != EmptyStr && !append &&
+                           !nv_isattr(np, NV_NOFREE | NV_LJUST | NV_RJUST | NV_ZFILL) &&
+                           (size_t)dot <= (oldsize = strlen(tofree)) &&
+                           oldsize <= 2 * (size_t)dot + 16) {
+                    // Most values are short and replaced by others of about the same length, so
+                    // reuse the buffer of the old value. The terminator is written after the copy
+                    // since <sp> may point into this buffer.
+                    cp = tofree;
+                    tofree = NULL;
+                    reuse = true;
+                    sh_stats(STAT_STRREUSE);
                 } else {
                     if (tofree && tofree != Empty && tofree != EmptyStr) {
                         cp = realloc(tofree, (unsigned)dot + append + 8);
@@ -1757,6 +1836,7 @@ void nv_putval(Namval_t *np, const void *vp, nvflag_t flags) {
                     }
                     cp[dot + append] = 0;
                     nv_offattr(np, NV_NOFREE);
+                    sh_stats(STAT_STRALLOC);
                 }
             }
 
@@ -1765,7 +1845,7 @@ void nv_putval(Namval_t *np, const void *vp, nvflag_t flags) {
         }
         STORE_VTP(up, cp, cp);
         if (sp) {
-            int c = cp[dot + append];
+            int c = reuse ? 0 : cp[dot + append];
             memmove(cp + append, sp, dot);
             if (cp == EmptyStr) {
                 assert(dot == 0 && append == 0 && c == 0);
@@ -2428,7 +2508,7 @@ char *nv_getval(Namval_t *np) {
                 } else {
                     format = "%.*Lf";
                 }
-                sfprintf(shp->strbuf, format, nv_size(np), ld);
+                return fmtdouble(shp, format, nv_size(np), true, ld, 0);
             } else {
                 if (nv_isattr(np, NV_SHORT)) {
                     d = *FETCH_VTP(up, fp);
@@ -2442,9 +2522,8 @@ char *nv_getval(Namval_t *np) {
                 } else {
                     format = "%.*f";
                 }
-                sfprintf(shp->strbuf, format, nv_size(np), d);
+                return fmtdouble(shp, format, nv_size(np), false, 0, d);
             }
-            return sfstruse(shp->strbuf);
         } else if (nv_isattr(np, NV_UNSIGN)) {
             if (nv_isattr(np, NV_LONG)) {
                 ll = *(Sfulong_t *)FETCH_VTP(up, i64p);
@@ -2476,10 +2555,7 @@ char *nv_getval(Namval_t *np) {
         }
         numeric = nv_size(np);
         if (numeric == 10) {
-            if (nv_isattr(np, NV_UNSIGN)) {
-                sfprintf(shp->strbuf, "%I*u", sizeof(ll), ll);
-                return sfstruse(shp->strbuf);
-            }
+            if (nv_isattr(np, NV_UNSIGN)) return fmtint(ll, 1);
             numeric = 0;
         }
         return fmtbase(ll, numeric, numeric && numeric != 10);
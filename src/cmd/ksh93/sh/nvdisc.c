@@ -947,10 +947,12 @@ Namval_t *nv_search(const char *name, Dt_t *root, nvflag_t mode) {
     if (shp->inpool) mode |= NV_NOSCOPE;
 #endif  // SHOPT_COSHELL
 
-    if (mode & NV_NOSCOPE) dp = dtview(root, 0);
+    // Without scoping only <root> itself is searched. Its method is called directly rather than
+    // taking the view away and putting it back, which would forget the lookups cdt remembers.
+    if (mode & NV_NOSCOPE) dp = dtvnext(root);
     if (*name == '.' && root == shp->var_tree && !dp) root = shp->var_base;
 
-    Namval_t *np = dtmatch(root, name);
+    Namval_t *np = dp ? (*root->meth->searchf)(root, (void *)name, DT_MATCH) : dtmatch(root, name);
     if (!np && (mode & NV_ADD)) {
         if (shp->namespace && !(mode & NV_NOSCOPE) && root == shp->var_tree) {
             root = nv_dict(shp->namespace);
@@ -961,7 +963,6 @@ Namval_t *nv_search(const char *name, Dt_t *root, nvflag_t mode) {
         np = dtinsert(root, newnode(name));
         np->nvshell = shp;
     }
-    if (dp) dtview(root, dp);
     return np;
 }
 
@@ -976,9 +977,9 @@ Namval_t *nv_search_namval(const Namval_t *mp, Dt_t *root, nvflag_t mode) {
     if (shp->inpool) mode |= NV_NOSCOPE;
 #endif  // SHOPT_COSHELL
 
-    if (nv_isflag(mode, NV_NOSCOPE)) dp = dtview(root, 0);
+    if (nv_isflag(mode, NV_NOSCOPE)) dp = dtvnext(root);
 
-    Namval_t *np = dtsearch(root, mp);
+    Namval_t *np = dp ? (*root->meth->searchf)(root, (void *)mp, DT_SEARCH) : dtsearch(root, mp);
     if (!np && nv_isflag(mode, NV_ADD)) {
         name = nv_name(mp);
         if (shp->namespace && !nv_isflag(mode, NV_NOSCOPE) && root == shp->var_tree) {
@@ -990,7 +991,6 @@ Namval_t *nv_search_namval(const Namval_t *mp, Dt_t *root, nvflag_t mode) {
         np = dtinsert(root, newnode(name));
         np->nvshell = shp;
     }
-    if (dp) dtview(root, dp);
     return np;
 }
 
@@ -57,7 +57,7 @@ struct nvdir {
 static int Indent;
 char *nv_getvtree(Namval_t *, Namfun_t *);
 static_fn void put_tree(Namval_t *, const void *, nvflag_t, Namfun_t *);
-static_fn char *walk_tree(Namval_t *, Namval_t *, nvflag_t);
+static_fn char *walk_tree(Namval_t *, Namval_t *, nvflag_t, Sfio_t *);
 
 static_fn int read_tree(Namval_t *np, Sfio_t *in, int n, Namfun_t *dp) {
     if (n >= 0) return -1;
@@ -66,17 +66,11 @@ static_fn int read_tree(Namval_t *np, Sfio_t *in, int n, Namfun_t *dp) {
     Sfio_t *sp, *iop;
     char *cp;
     int c;
-    typedef int (*Shread_t)(Shell_t *, Sfio_t *, Sfio_t *);
+    typedef int (*Shread_t)(Shell_t *, Namval_t *, Sfio_t *);
     Shread_t fun;
 
     fun = *(void **)(dp + 1);
-    if (fun) {
-        iop = sftmp(SF_BUFSIZE * sizeof(char *));
-        sfputr(iop, nv_name(np), '=');
-        (*fun)(shp, in, iop);
-        sfseek(iop, (Sfoff_t)0, SEEK_SET);
-        goto done;
-    }
+    if (fun) return (*fun)(shp, np, in);
     iop = in;
     while ((c = sfgetc(iop)) && iswblank(c)) {
         ;  // empty loop
@@ -86,10 +80,7 @@ static_fn int read_tree(Namval_t *np, Sfio_t *in, int n, Namfun_t *dp) {
     cp = sfstruse(shp->strbuf);
     sp = sfopen(NULL, cp, "s");
     sfstack(iop, sp);
-done:
-    c = sh_eval(shp, iop, SH_READEVAL);
-    if (iop != in) sfclose(in);
-    return c;
+    return sh_eval(shp, iop, SH_READEVAL);
 }
 
 static_fn Namval_t *create_tree(Namval_t *np, const void *name, nvflag_t flags, Namfun_t *dp) {
@@ -114,7 +105,7 @@ static_fn Namfun_t *clone_tree(Namval_t *np, Namval_t *mp, nvflag_t flags, Namfu
     if ((flags & NV_MOVE) && nv_type(np)) return fp;
     dp = nv_clone_disc(fp, flags);
     if ((flags & NV_COMVAR) && !(flags & NV_RAW)) {
-        walk_tree(np, mp, flags);
+        walk_tree(np, mp, flags, NULL);
         if ((flags & NV_MOVE) && !(fp->nofree & 1)) free(fp);
     }
     return dp;
@@ -602,12 +593,19 @@ void nv_outnode(Namval_t *np, Sfio_t *out, int indent, int special) {
             more = nv_nextsub(np);
             goto skip;
         }
+        if (ap) dot = nv_aindex(np);
         if (mp && nv_isvtree(mp)) {
+            // Write compound elements straight to <out> rather than formatting them in a buffer.
             if (indent < 0) nv_onattr(mp, NV_EXPORT);
-            nv_onattr(mp, NV_TABLE);
+            if (nv_outvtree(mp, out)) {
+                ep = Empty;
+            } else {
+                nv_onattr(mp, NV_TABLE);
+                ep = nv_getval(mp);
+            }
+        } else {
+            ep = nv_getval(mp ? mp : np);
         }
-        if (ap) dot = nv_aindex(np);
-        ep = nv_getval(mp ? mp : np);
         if (dot >= 0) {
             nv_putsub(np, NULL, dot, 0);
         } else if (mp && associative) {
@@ -980,9 +978,10 @@ static_fn char **genvalue(char **argv, const char *prefix, int n, struct Walk *w
 }
 
 //
-// Walk the virtual tree and print or delete name-value pairs.
+// Walk the virtual tree and print or delete name-value pairs. The text is written to <dest> if it
+// is not NULL and NULL is returned. Otherwise it is formatted in a buffer which is returned.
 //
-static_fn char *walk_tree(Namval_t *np, Namval_t *xp, nvflag_t flags) {
+static_fn char *walk_tree(Namval_t *np, Namval_t *xp, nvflag_t flags, Sfio_t *dest) {
     Shell_t *shp = sh_ptr(np);
     static Sfio_t *out;
     struct Walk walk;
@@ -1101,6 +1100,8 @@ static_fn char *walk_tree(Namval_t *np, Namval_t *xp, nvflag_t flags) {
     for (; ap; ap = ap->argchn.ap) *--argv = ap->argval;
     if (flags & 1) {
         outfile = 0;
+    } else if (dest) {
+        outfile = dest;
     } else if (!(outfile = out)) {
         outfile = out = sfnew(NULL, NULL, -1, -1, SF_WRITE | SF_STRING);
     } else if (flags & NV_TABLE) {
@@ -1117,7 +1118,7 @@ static_fn char *walk_tree(Namval_t *np, Namval_t *xp, nvflag_t flags) {
     genvalue(argv, name, 0, &walk);
     stkset(shp->stk, savptr, savtop);
     shp->var_tree = save_tree;
-    if (!outfile) return NULL;
+    if (!outfile || outfile == dest) return NULL;
     sfputc(out, 0);
     sfseek(out, off, SEEK_SET);
     return (char *)out->data + off;
@@ -1129,25 +1130,48 @@ Namfun_t *nv_isvtree(Namval_t *np) {
     return NULL;
 }
 
+//
+// Return true if the value of compound variable <np> is produced by walk_tree() rather than by a
+// discipline stacked on top of the tree discipline <fp>.
+//
+static_fn bool walkable(Namval_t *np, Namfun_t *fp) {
+    for (; fp && fp->next; fp = fp->next) {
+        if (fp->next->disc && (fp->next->disc->getnum || fp->next->disc->getval)) return false;
+    }
+    if (nv_isattr(np, NV_BINARY) && !nv_isattr(np, NV_RAW)) return false;
+    if (nv_isattr(np, NV_ARRAY) && !nv_type(np) && nv_arraychild(np, NULL, 0) == np) return false;
+    return true;
+}
+
 //
 // Get discipline for compound initializations.
 //
 char *nv_getvtree(Namval_t *np, Namfun_t *fp) {
     nvflag_t flags = 0;
-    for (; fp && fp->next; fp = fp->next) {
-        if (fp->next->disc && (fp->next->disc->getnum || fp->next->disc->getval)) {
-            return nv_getv(np, fp);
-        }
-    }
-    if (nv_isattr(np, NV_BINARY) && !nv_isattr(np, NV_RAW)) return nv_getv(np, fp);
-    if (nv_isattr(np, NV_ARRAY) && !nv_type(np) && nv_arraychild(np, NULL, 0) == np) {
-        return nv_getv(np, fp);
-    }
+
+    if (!walkable(np, fp)) return nv_getv(np, fp);
     flags = nv_isattr(np, NV_EXPORT | NV_TAGGED);
     if (flags) nv_offattr(np, NV_EXPORT | NV_TAGGED);
     flags |= nv_isattr(np, NV_TABLE);
     if (flags) nv_offattr(np, NV_TABLE);
-    return walk_tree(np, NULL, flags);
+    return walk_tree(np, NULL, flags, NULL);
+}
+
+//
+// Write the value of compound variable <np> to <out> as it is generated instead of formatting it
+// in a buffer, which for large trees needs memory proportional to the size of the output. The
+// NV_EXPORT and NV_JSON attributes select the format as they do for nv_getvtree(). Return false,
+// having written nothing, if the value must be obtained with nv_getval() instead.
+//
+bool nv_outvtree(Namval_t *np, Sfio_t *out) {
+    Namfun_t *fp = nv_hasdisc(np, &treedisc);
+    nvflag_t flags;
+
+    if (!fp || !walkable(np, fp)) return false;
+    flags = nv_isattr(np, NV_EXPORT | NV_TAGGED);
+    if (flags) nv_offattr(np, NV_EXPORT | NV_TAGGED);
+    walk_tree(np, NULL, flags, out);
+    return true;
 }
 
 //
@@ -1170,11 +1194,11 @@ static_fn void put_tree(Namval_t *np, const void *val, nvflag_t flags, Namfun_t
             shp->prev_root = shp->last_root;
             shp->last_table = last_table;
             shp->last_root = last_root;
-            if (!(flags & NV_APPEND)) walk_tree(np, NULL, (flags & NV_NOSCOPE) | 1);
+            if (!(flags & NV_APPEND)) walk_tree(np, NULL, (flags & NV_NOSCOPE) | 1, NULL);
             nv_clone(mp, np, NV_COMVAR);
             return;
         }
-        walk_tree(np, NULL, (flags & NV_NOSCOPE) | 1);
+        walk_tree(np, NULL, (flags & NV_NOSCOPE) | 1, NULL);
     }
     nv_putv(np, val, flags, fp);
     if (val && nv_isattr(np, (NV_INTEGER | NV_BINARY))) return;
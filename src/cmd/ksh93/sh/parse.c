@@ -34,7 +34,9 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 #include "argnod.h"
 #include "ast.h"
@@ -46,6 +48,7 @@
 #include "fault.h"
 #include "fcin.h"
 #include "history.h"
+#include "io.h"
 #include "lexstates.h"
 #include "name.h"
 #include "path.h"
@@ -308,7 +311,8 @@ Shnode_t *sh_parse(Shell_t *shp, Sfio_t *iop, int flag) {
     int sav_prompt = shp->nextprompt;
 
     if (shp->binscript && (sffileno(iop) == shp->infd || (flag & SH_FUNEVAL))) {
-        return sh_trestore(shp, iop);
+        if (shp->binscript < TD_VERSION) return sh_trestore(shp, iop);
+        return sh_tnext(shp, iop);
     }
     fcsave(&sav_input);
     shp->st.staklist = NULL;
@@ -334,12 +338,15 @@ Shnode_t *sh_parse(Shell_t *shp, Sfio_t *iop, int flag) {
             fcclose();
             fcrestore(&sav_input);
             lexp->arg = sav_arg;
-            if (version > 3) {
-                errormsg(SH_DICT, ERROR_exit(1), e_lexversion);
+            if (version > TD_VERSION) {
+                errormsg(SH_DICT, ERROR_exit(1), e_lexversion, version);
                 __builtin_unreachable();
             }
-            if (sffileno(iop) == shp->infd || (flag & SH_FUNEVAL)) shp->binscript = 1;
+            if (sffileno(iop) == shp->infd || (flag & SH_FUNEVAL)) {
+                shp->binscript = version < TD_VERSION ? 1 : TD_VERSION;
+            }
             sfgetc(iop);
+            if (version == TD_VERSION) return sh_tmap(shp, iop, flag);
             t = sh_trestore(shp, iop);
             if (flag & SH_NL) {
                 Shnode_t *tt;
@@ -681,6 +688,200 @@ static_fn Shnode_t *arithfor(Lex_t *lexp, Shnode_t *tf) {
     return tf;
 }
 
+//
+// Lazy parsing of function bodies.
+//
+// When KSH_LAZYPARSE is set, the body of a function that is read from a file is not parsed when
+// the definition is read. The lexer skips the body with sh_lexbody() and only the offsets of the
+// braces are noted, then the text is read back from the file and kept on the stack of the function.
+// sh_funparse() builds the tree when the function is first used.
+//
+
+// The text of a body whose parse was deferred. This follows the functnod of the function stack.
+struct funlazy {
+    char *text;        // the body from the opening to the closing brace
+    int64_t line;      // line number of the opening brace
+    struct ionod *io;  // redirections that follow the closing brace
+    Shnode_t *tree;    // the body once it has been parsed
+    int flags;         // FOPTGET and FSHVALUE found by the parse
+};
+
+//
+// Return true if the body of the function <t> that starts at the current token may be skipped.
+//
+static_fn bool lz_enabled(Lex_t *lexp, Shnode_t *t, Sfio_t *iop, void *in_mktype) {
+    Shell_t *shp = lexp->sh;
+    Namval_t *np;
+    char *cp;
+    struct stat statb;
+
+    if (lexp->token != LBRACE || t->funct.functargs || in_mktype || lexp->assignlevel || lexp->heredoc ||
+        lexp->kiafile || lexp->comsub || lexp->lexd.dolparen || shp->shcomp ||
+        !shp->st.filename || sffileno(iop) < 0 || sh_isoption(shp, SH_NOEXEC) ||
+        sh_isoption(shp, SH_VERBOSE) || sh_isstate(shp, SH_VERBOSE) ||
+        sh_isstate(shp, SH_HISTORY) || strchr(t->funct.functnam, '.')) {
+        return false;
+    }
+    // The offset of the brace must be known and the text must be there to be read again.
+    if (fcseek(0) <= fcfirst() || fcpeek(-1) != '{' || fstat(sffileno(iop), &statb) < 0 ||
+        !S_ISREG(statb.st_mode)) {
+        return false;
+    }
+    np = nv_search("KSH_LAZYPARSE", shp->var_tree, 0);
+    if (!np || !(cp = nv_getval(np)) || !*cp) return false;
+    // The body is parsed without the aliases defined by the user, see sh_funparse().
+    if (!sh_isstate(shp, SH_NOALIAS)) {
+        for (np = dtfirst(shp->alias_tree); np; np = dtnext(shp->alias_tree, np)) {
+            if (!nv_isattr(np, NV_NOFREE) && nv_getval(np)) return false;
+        }
+    }
+    return true;
+}
+
+//
+// Skip the body of a function and save its text in <lz>. Returns false when the body has to be
+// parsed now, in which case nothing has been read.
+//
+static_fn bool lz_skip(Lex_t *lexp, Sfio_t *iop, struct funlazy *lz) {
+    Shell_t *shp = lexp->sh;
+    Sfoff_t first = fctell() - 1;
+    int64_t line = shp->inlineno;
+    ssize_t n;
+
+    if (!sh_lexbody(lexp)) return false;
+    n = fctell() - first;
+    lz->text = stkalloc(stkstd, n + 1);
+    if (pread(sffileno(iop), lz->text, n, first) != n || lz->text[0] != '{' ||
+        lz->text[n - 1] != '}') {
+        errormsg(SH_DICT, ERROR_system(1), e_open, shp->st.filename);
+        __builtin_unreachable();
+    }
+    lz->text[n] = 0;
+    lz->line = line;
+    lz->tree = NULL;
+    lz->flags = 0;
+    // Continue as item() does after the closing brace.
+    lexp->token = RBRACE;
+    lexp->lex.reservok = 1;
+    lexp->lex.skipword = lexp->lex.incase = lexp->lex.intest = 0;
+    lexp->assignok = 0;
+    sh_lex(lexp);
+    lz->io = inout(lexp, NULL, 0);
+    return true;
+}
+
+//
+// Return the body of the function whose stack is <slp> after a body that was skipped by lz_skip()
+// has been parsed the first time this is called for it. The FOPTGET and FSHVALUE flags that apply
+// to the function are stored in <flags> if it is not NULL.
+//
+Shnode_t *sh_funparse(Shell_t *shp, struct slnod *slp, int *flags) {
+    struct functnod *fp = (struct functnod *)(slp + 1);
+    struct funlazy *lz = (struct funlazy *)(fp + 1);
+    Lex_t *lexp = shp->lex_context, savelex;
+    Sfio_t *volatile iop = NULL, *savstak;
+    struct slnod *staklist = shp->st.staklist, *children;
+    Fcin_t sav_input;
+    checkpt_t buff;
+    Shnode_t *t = NULL;
+    int64_t inlineno = shp->inlineno;
+    int jmpval, refs, save_optget = opt_get, saveloop = loop_level, line = error_info.line;
+    struct argnod *savelist = label_list, *savelast = label_last;
+    void *in_mktype = shp->mktype;
+    bool noalias = sh_isstate(shp, SH_NOALIAS);
+
+    if (lz->tree) {
+        if (flags) *flags = lz->flags;
+        return lz->tree;
+    }
+    savelex = *lexp;
+    fcsave(&sav_input);
+    savstak = stkinstall(slp->slptr, 0);
+    shp->st.staklist = NULL;
+    shp->mktype = NULL;
+    // Aliases defined after the body was skipped are not expanded in it, see lz_enabled().
+    sh_onstate(shp, SH_NOALIAS);
+    opt_get = 0;
+    loop_level = 0;
+    label_list = label_last = NULL;
+    // Syntax errors are reported like those found when the definition was read.
+    error_info.line = 0;
+    sh_pushcontext(shp, &buff, 1);
+    jmpval = sigsetjmp(buff.buff, 0);
+    if (jmpval == 0) {
+        iop = sfopen(NULL, lz->text, "s");
+        sh_lexopen(lexp, shp, 0);
+        // The nesting levels of the lexer in use are kept, the parse gets an array of its own.
+        lexp->lexd.lex_match = NULL;
+        lexp->lexd.lex_max = 0;
+        lexp->assignlevel = 0;
+        lexp->noreserv = 0;
+        lexp->heredoc = NULL;
+        lexp->fundepth = 1;
+        lexp->inlineno = shp->inlineno = lz->line;
+        lexp->firstline = shp->st.firstline;
+        if (fcfopen(iop) < 0 || sh_lex(lexp) != LBRACE) sh_syntax(lexp);
+        t = item(lexp, SH_NOIO);
+        if (lexp->token != EOFSYM) sh_syntax(lexp);
+        if (lz->io) {
+            t = makeparent(lexp, (t->tre.tretyp & COMMSK) == TFORK ? TFORK : TSETIO, t);
+            t->tre.treio = lz->io;
+        }
+        fcclose();
+    }
+    sh_popcontext(shp, &buff);
+    fcrestore(&sav_input);
+    if (iop) sfclose(iop);
+    if (lexp->lexd.lex_match != savelex.lexd.lex_match) free(lexp->lexd.lex_match);
+    *lexp = savelex;
+    shp->inlineno = inlineno;
+    error_info.line = line;
+    shp->mktype = in_mktype;
+    if (!noalias) sh_offstate(shp, SH_NOALIAS);
+    lz->flags = opt_get;
+    opt_get = save_optget;
+    loop_level = saveloop;
+    label_list = savelist;
+    label_last = savelast;
+    children = shp->st.staklist;
+    shp->st.staklist = staklist;
+    stkinstall(savstak, 0);
+    if (jmpval) {
+        if (children) sh_funstaks(children, -1);
+        siglongjmp(shp->jmplist->buff, jmpval);
+    }
+    if (children) {
+        // Functions defined in the body share the references of this function, see funct().
+        refs = stklink(slp->slptr);
+        stkclose(slp->slptr);
+        while (--refs > 0) sh_funstaks(children, 1);
+        for (staklist = children; staklist->slnext; staklist = staklist->slnext) {
+            ;  // empty loop
+        }
+        staklist->slnext = slp->slchild;
+        slp->slchild = children;
+    }
+    lz->tree = t;
+    if (flags) *flags = lz->flags;
+    return t;
+}
+
+//
+// Return the body of the function <np>, parsing it first if necessary.
+//
+Shnode_t *sh_funtree(Shell_t *shp, Namval_t *np) {
+    Shnode_t *t = (Shnode_t *)nv_funtree(np);
+    struct slnod *slp = (struct slnod *)np->nvenv;
+    int flags;
+
+    if (t || !slp || !(((struct functnod *)(slp + 1))->functtyp & FLAZY)) return t;
+    t = sh_funparse(shp, slp, &flags);
+    if (flags & FOPTGET) nv_onattr(np, NV_OPTGET);
+    if (flags & FSHVALUE) nv_onattr(np, NV_SHVALUE);
+    nv_funtree(np) = (int *)t;
+    return t;
+}
+
 static_fn Shnode_t *funct(Lex_t *lexp) {
     Shell_t *shp = lexp->sh;
     Shnode_t *t;
@@ -696,6 +897,7 @@ static_fn Shnode_t *funct(Lex_t *lexp) {
     checkpt_t buff;
     int save_optget = opt_get;
     void *in_mktype = shp->mktype;
+    volatile bool lazy;
 
     shp->mktype = NULL;
     opt_get = 0;
@@ -788,13 +990,15 @@ static_fn Shnode_t *funct(Lex_t *lexp) {
         while (lexp->token == NL) lexp->token = sh_lex(lexp);
     }
     if ((flag && lexp->token != LBRACE) || lexp->token == EOFSYM) sh_syntax(lexp);
+    lazy = lz_enabled(lexp, t, iop, in_mktype);
     sh_pushcontext(shp, &buff, 1);
     jmpval = sigsetjmp(buff.buff, 0);
     if (jmpval == 0) {
         // Create a new stak frame to compile the command.
         savstak = stkopen(STK_SMALL);
         savstak = stkinstall(savstak, 0);
-        slp = stkalloc(stkstd, sizeof(struct slnod) + sizeof(struct functnod));
+        slp = stkalloc(stkstd, sizeof(struct slnod) + sizeof(struct functnod) +
+                                   (lazy ? sizeof(struct funlazy) : 0));
         slp->slchild = NULL;
         slp->slnext = shp->st.staklist;
         shp->st.staklist = NULL;
@@ -829,7 +1033,10 @@ static_fn Shnode_t *funct(Lex_t *lexp) {
             memcpy(ap, lexp->arg, flag);
             lexp->arg = ap;
         }
-        t->funct.functtre = item(lexp, SH_NOIO);
+        t->funct.functtre = NULL;
+        if (!lazy || !(lazy = lz_skip(lexp, iop, (struct funlazy *)(fp + 1)))) {
+            t->funct.functtre = item(lexp, SH_NOIO);
+        }
     } else if (shp->shcomp) {
         exit(1);
     } else {
@@ -860,6 +1067,10 @@ static_fn Shnode_t *funct(Lex_t *lexp) {
     // been assigned a non-NULL value in the `if (jmpval == 0) {...}` block above.
     fp->functline = last - first;
     fp->functtre = t;
+    if (lazy) {
+        fp->functtyp |= FLAZY;
+        t->funct.functtyp |= FLAZY;
+    }
     shp->mktype = in_mktype;
     if (lexp->sh->funlog) {
         if (fcfill() > 0) fcseek(-1);
@@ -0,0 +1,267 @@
+//
+// Persistent parse cache for scripts read by `.` and for FPATH function files.
+//
+// When KSH_PARSECACHE names a directory, the parse trees built while reading such a file are
+// added to an image in shcomp format as they are produced by sh_eval(). A later shell that reads
+// the same file finds the entry and hands the image to sh_parse(), which maps it with sh_tmap()
+// instead of lexing and parsing the text again.
+//
+// An entry starts with a key that records the identity of the source file (device, inode, size
+// and modification time), its pathname, the shell version and a checksum of the parse environment
+// (aliases and declared types). An entry is only used if all of them match. Entries are written
+// to a temporary file that is renamed into place once the whole source file has been parsed, so
+// a syntax error or a script that is interrupted never leaves a partial entry behind.
+//
+#include "config_ast.h"  // IWYU pragma: keep
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ast.h"
+#include "cdt.h"
+#include "defs.h"
+#include "io.h"
+#include "name.h"
+#include "sfio.h"
+#include "shnodes.h"
+#include "tv.h"
+
+// Bump this whenever the dump format or the key changes.
+#define PC_FORMAT 3
+
+#define CNTL(x) ((x)&037)
+
+static const char pc_magic[8] = {CNTL('k'), 'p', 'c', 'a', 'c', 'h', 'e', PC_FORMAT};
+static const char pc_header[4] = {CNTL('k'), CNTL('s'), CNTL('h'), 0};
+
+struct pckey {
+    char magic[8];
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t size;
+    int64_t mtime;
+    int64_t mtimensec;
+    uint32_t version;  // checksum of the shell version string
+    uint32_t env;      // checksum of the aliases and types in effect
+    uint32_t pathlen;  // length of the source pathname that follows the key
+    uint32_t unused;
+};
+
+// The image follows the pathname at an offset that it can be mapped from.
+#define PC_IMAGE(len) roundof(sizeof(struct pckey) + (len), TD_ALIGN)
+
+struct pcache {
+    int fd;              // source file descriptor that sh_eval() will read
+    uint32_t env;        // parse environment when the entry was created
+    Sfio_t *out;         // entry being written
+    struct tdump *dump;  // image of the trees parsed so far
+    char *tmp;           // temporary pathname of the entry
+    char name[1];        // pathname of the entry
+};
+
+//
+// Checksum of everything outside the file itself that changes how it is parsed.
+//
+static_fn uint32_t pc_environ(Shell_t *shp) {
+    unsigned int sum = PC_FORMAT;
+    Namval_t *np;
+    char *cp;
+
+    for (np = dtfirst(shp->alias_tree); np; np = dtnext(shp->alias_tree, np)) {
+        if (!(cp = nv_getval(np))) continue;
+        sum = dtstrhash(sum, np->nvname, -1);
+        sum = dtstrhash(sum, cp, -1);
+    }
+    if (shp->typedict) {
+        for (np = dtfirst(shp->typedict); np; np = dtnext(shp->typedict, np)) {
+            sum = dtstrhash(sum, np->nvname, -1);
+        }
+    }
+    return sum;
+}
+
+//
+// Return the cache directory or NULL if the cache should not be used.
+//
+static_fn char *pc_dir(Shell_t *shp) {
+    Namval_t *np;
+    char *dir;
+    struct stat statb;
+
+    if (shp->shcomp || sh_isoption(shp, SH_NOEXEC) || sh_isoption(shp, SH_VERBOSE) ||
+        sh_isstate(shp, SH_VERBOSE) || sh_isstate(shp, SH_HISTORY)) {
+        return NULL;
+    }
+    if (!(np = nv_search("KSH_PARSECACHE", shp->var_tree, 0))) return NULL;
+    if (!(dir = nv_getval(np)) || *dir != '/') return NULL;
+    if (stat(dir, &statb) < 0) {
+        if (mkdir(dir, S_IRWXU) < 0 || stat(dir, &statb) < 0) return NULL;
+    }
+    // Restoring a tree runs the code in it so refuse a directory that someone else can write.
+    if (!S_ISDIR(statb.st_mode) || statb.st_uid != geteuid() ||
+        (statb.st_mode & (S_IWGRP | S_IWOTH))) {
+        return NULL;
+    }
+    return dir;
+}
+
+static_fn void pc_discard(struct pcache *pp) {
+    if (pp->dump) sh_tdumpclose(pp->dump, NULL);
+    if (pp->out) {
+        sfclose(pp->out);
+        unlink(pp->tmp);
+    }
+    free(pp->tmp);
+    free(pp);
+}
+
+//
+// Called with the open source file <fd> and its full pathname <path> just before the file is
+// handed to sh_eval(). Returns a descriptor for a valid cache entry, in which case <fd> is
+// closed, or <fd> itself. In the latter case an entry for the file may be created as it is read.
+//
+int sh_pcopen(Shell_t *shp, int fd, const char *path) {
+    struct pckey key, ent;
+    struct pcache *pp;
+    struct stat statb, entb;
+    char *dir, *cp;
+    char buff[sizeof(pc_header)];
+    int cfd;
+    size_t n, len = strlen(path);
+    unsigned int h1, h2;
+
+    if (shp->pcache) {
+        pc_discard(shp->pcache);
+        shp->pcache = NULL;
+    }
+    if (!(dir = pc_dir(shp)) || fstat(fd, &statb) < 0 || !S_ISREG(statb.st_mode)) return fd;
+    // Files already compiled by shcomp are restored without help.
+    if (pread(fd, buff, 4, 0) == 4 && memcmp(buff, pc_header, 4) == 0) return fd;
+
+    memset(&key, 0, sizeof(key));
+    memcpy(key.magic, pc_magic, sizeof(key.magic));
+    key.dev = statb.st_dev;
+    key.ino = statb.st_ino;
+    key.size = statb.st_size;
+    key.mtime = statb.st_mtime;
+    key.mtimensec = ST_MTIME_NSEC_GET(&statb);
+    key.version = dtstrhash(0, e_version, -1);
+    key.env = pc_environ(shp);
+    key.pathlen = len;
+
+    // Room for the entry name and the suffix of its temporary name.
+    n = strlen(dir) + 20;
+    pp = malloc(sizeof(struct pcache) + n + len + 1);
+    if (!pp) return fd;
+    memset(pp, 0, sizeof(*pp));
+    h1 = dtstrhash(key.env, (char *)path, len);
+    h2 = dtstrhash(~key.env, (char *)path, len);
+    snprintf(pp->name, n, "%s/%08x%08x", dir, h1, h2);
+    cp = pp->name + n;
+
+    cfd = sh_open(pp->name, O_RDONLY | O_CLOEXEC, 0);
+    if (cfd >= 0) {
+        if (fstat(cfd, &entb) >= 0 && entb.st_uid == geteuid() &&
+            read(cfd, &ent, sizeof(ent)) == sizeof(ent) && memcmp(&ent, &key, sizeof(key)) == 0 &&
+            read(cfd, cp, len) == len && memcmp(cp, path, len) == 0 &&
+            lseek(cfd, PC_IMAGE(len), SEEK_SET) == PC_IMAGE(len) &&
+            (cfd = sh_iomovefd(shp, cfd)) >= 0) {
+            (void)fcntl(cfd, F_SETFD, FD_CLOEXEC);
+            free(pp);
+            sh_close(fd);
+            return cfd;
+        }
+        sh_close(cfd);
+    }
+
+    pp->fd = fd;
+    pp->env = key.env;
+    n += 24;
+    if (!(pp->tmp = malloc(n))) {
+        free(pp);
+        return fd;
+    }
+    snprintf(pp->tmp, n, "%s.%d", pp->name, (int)getpid());
+    cfd = open(pp->tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (cfd < 0) {
+        pc_discard(pp);
+        return fd;
+    }
+    if (!(pp->out = sfnew(NULL, NULL, SF_UNBOUND, cfd, SF_WRITE))) {
+        close(cfd);
+        unlink(pp->tmp);
+        pc_discard(pp);
+        return fd;
+    }
+    if (!(pp->dump = sh_tdumpopen(true))) {
+        pc_discard(pp);
+        return fd;
+    }
+    sfwrite(pp->out, &key, sizeof(key));
+    sfwrite(pp->out, path, len);
+    sfnputc(pp->out, 0, PC_IMAGE(len) - sizeof(key) - len);
+    shp->pcache = pp;
+    return fd;
+}
+
+//
+// Called by sh_eval() before it reads from <iop>. Returns the entry that sh_pcopen() started for
+// the stream, if any, which the caller then owns.
+//
+void *sh_pcattach(Shell_t *shp, Sfio_t *iop) {
+    struct pcache *pp = shp->pcache;
+
+    if (!pp) return NULL;
+    shp->pcache = NULL;
+    if (pp->fd != sffileno(iop)) {
+        pc_discard(pp);
+        return NULL;
+    }
+    return pp;
+}
+
+//
+// Add the tree <t> that was just parsed to the entry.
+//
+void sh_pcdump(Shell_t *shp, void *handle, const Shnode_t *t) {
+    struct pcache *pp = handle;
+    Sfoff_t off = 0;
+
+    if (!t || !pp->dump) return;
+    // The image copies here-documents from the here-document file so put its offset back.
+    if (shp->heredocs) off = sftell(shp->heredocs);
+    if (sh_tdumpadd(pp->dump, t) < 0) {
+        sh_tdumpclose(pp->dump, NULL);
+        pp->dump = NULL;
+    }
+    if (shp->heredocs) sfseek(shp->heredocs, off, SEEK_SET);
+}
+
+//
+// Finish with the entry. If <complete> is set then the whole source file was parsed and the entry
+// is installed, otherwise it is thrown away.
+//
+void sh_pcclose(Shell_t *shp, void *handle, bool complete) {
+    struct pcache *pp = handle;
+
+    // A file that defines aliases or types while it is read may parse differently next time.
+    if (complete && pp->dump && pc_environ(shp) == pp->env) {
+        Sfio_t *out = pp->out;
+        struct tdump *dump = pp->dump;
+        pp->out = NULL;
+        pp->dump = NULL;
+        int r = sh_tdumpclose(dump, out);
+        if (sfclose(out) == 0 && r == 0 && rename(pp->tmp, pp->name) == 0) {
+            pc_discard(pp);
+            return;
+        }
+        unlink(pp->tmp);
+    }
+    pc_discard(pp);
+}
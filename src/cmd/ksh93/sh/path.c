@@ -23,16 +23,21 @@
 //
 #include "config_ast.h"  // IWYU pragma: keep
 
+#include <dirent.h>
 #include <dlfcn.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <sched.h>
 #include <setjmp.h>
 #include <signal.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "argnod.h"
@@ -49,10 +54,12 @@
 #include "jobs.h"
 #include "name.h"
 #include "path.h"
+#include "probe.h"
 #include "sfio.h"
 #include "shcmd.h"
 #include "stk.h"
 #include "test.h"
+#include "tv.h"
 #include "variables.h"
 
 #if USE_SPAWN
@@ -166,8 +173,10 @@ static_fn pid_t _spawnveg(Shell_t *shp, const char *path, char *const argv[], ch
         char *arg0 = argv[0], **av0 = (char **)&argv[0];
         int fd;
 
+        uint64_t start = sh_statclock();
         sh_stats(STAT_SPAWN);
         pid = spawnvex(path, argv, envp, shp->vex);
+        if (pid > 0) sh_stattime(STAT_TSPAWN, sh_statclock() - start);
         *av0 = arg0;
         if (pid > 0 && shp->comsub && (fd = sffileno(sfstdout)) != 1 && fd >= 0) {
             spawnvex_add(shp->vex, fd, 1, 0, 0);
@@ -186,6 +195,111 @@ static_fn pid_t _spawnveg(Shell_t *shp, const char *path, char *const argv[], ch
 }
 #endif  // USE_SPAWN
 
+#if USE_VFORK
+
+#define VFORK_STACK (64 * 1024 / 8)  // stack size in units of uint64_t
+
+struct vforkarg {
+    const char *path;
+    char *const *argv;
+    char *const *envp;
+    const sigset_t *mask;  // signal mask of the command
+    sigset_t ignore;       // signals with a trap of ""
+    pid_t pgid;            // process group to join, 0 for a new one, -1 to stay in this one
+    int err;               // errno of the failed exec
+};
+
+// The child runs on a stack of its own in the memory of the shell. The shell is suspended until
+// the child has exited or executed the command, so one stack will do.
+static uint64_t vfork_stack[VFORK_STACK];
+
+//
+// The child of path_vforkexec(). It shares the memory of the shell and only makes system calls
+// until it executes the command. All signals are blocked when it starts so no handler of the shell
+// can run in it.
+//
+static_fn int vfork_child(void *data) {
+    struct vforkarg *ap = data;
+    struct sigaction sa, old;
+    pid_t pid, ttypgrp = -1;
+    int sig;
+
+    if (ap->pgid >= 0) {
+        // Like the forked child in _sh_fork(), join the process group or start one and take the
+        // terminal if this is its leader. Doing it here means the command is in the foreground
+        // before the shell runs again, and SIGTTOU is blocked so this can't stop the child.
+        pid = getpid();
+        if (setpgid(0, ap->pgid) < 0 && ap->pgid) setpgid(0, 0);
+        if (getpgrp() == pid && (ttypgrp = tcgetpgrp(job.fd)) >= 0) {
+            if (tcsetpgrp(job.fd, pid) < 0) ttypgrp = -1;
+        }
+    }
+    memset(&sa, 0, sizeof(sa));
+    sigemptyset(&sa.sa_mask);
+    for (sig = 1; sig < NSIG; sig++) {
+        if (sig == SIGKILL || sig == SIGSTOP || sigaction(sig, NULL, &old) < 0) continue;
+        if (sigismember(&ap->ignore, sig) == 1) {
+            sa.sa_handler = SIG_IGN;
+        } else if (ap->pgid >= 0 && (sig == SIGTTIN || sig == SIGTTOU || sig == SIGTSTP)) {
+            sa.sa_handler = SIG_DFL;
+        } else if (old.sa_handler != SIG_IGN && old.sa_handler != SIG_DFL) {
+            sa.sa_handler = SIG_DFL;
+        } else {
+            continue;
+        }
+        sigaction(sig, &sa, NULL);
+    }
+    sigprocmask(SIG_SETMASK, ap->mask, NULL);
+    execve(ap->path, ap->argv, ap->envp);
+    ap->err = errno;
+    // Give the terminal back since the shell runs the command another way.
+    if (ttypgrp >= 0) tcsetpgrp(job.fd, ttypgrp);
+    _exit(127);
+}
+
+//
+// Start <path> with arguments <argv> and environment <envp> in a child that shares the memory of
+// the shell until it executes the command, so the time this takes does not depend on the size of
+// the shell. If <pgid> is not negative the child joins process group <pgid>, or a new one if it is
+// zero, and takes the terminal like a forked child does with job control. Returns -1 with errno set
+// when the command could not be executed, in which case the child has been reaped.
+//
+pid_t path_vforkexec(Shell_t *shp, const char *path, char *const argv[], char *const envp[],
+                     pid_t pgid) {
+    struct vforkarg arg;
+    sigset_t set, oset;
+    char *trap;
+    pid_t pid;
+    int sig, status;
+
+    arg.path = path;
+    arg.argv = argv;
+    arg.envp = envp;
+    arg.mask = &oset;
+    arg.pgid = pgid;
+    arg.err = 0;
+    sigemptyset(&arg.ignore);
+    for (sig = 1; sig < shp->st.trapmax && sig < NSIG; sig++) {
+        if (sig == SIGCHLD) continue;
+        trap = shp->st.trapcom[sig];
+        if (trap && !*trap) sigaddset(&arg.ignore, sig);
+    }
+    sigfillset(&set);
+    sigprocmask(SIG_BLOCK, &set, &oset);
+    pid = clone(vfork_child, vfork_stack + VFORK_STACK, CLONE_VM | CLONE_VFORK | SIGCHLD, &arg);
+    if (pid > 0 && arg.err) {
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+            ;  // empty loop
+        }
+        errno = arg.err;
+        pid = -1;
+    }
+    sigprocmask(SIG_SETMASK, &oset, NULL);
+    if (pid > 0) sh_stats(STAT_SPAWN);
+    return pid;
+}
+#endif  // USE_VFORK
+
 //
 // Used with command -x to run the command in multiple passes. Spawn is non-zero when invoked via
 // spawn. The exitval is set to the maximum for each execution.
@@ -297,6 +411,16 @@ skip:
     return cp;
 }
 
+//
+// Free a Pathcomp_t structure that is no longer referenced.
+//
+static_fn void path_free(Pathcomp_t *pp) {
+    if (pp->lib) free(pp->lib);
+    if (pp->bbuf) free(pp->bbuf);
+    if (pp->index) path_freeindex(pp->index);
+    free(pp);
+}
+
 //
 // Delete current Pathcomp_t structure.
 //
@@ -308,9 +432,7 @@ void path_delete(Pathcomp_t *first) {
     while (pp) {
         ppnext = pp->next;
         if (--pp->refcount <= 0) {
-            if (pp->lib) free(pp->lib);
-            if (pp->bbuf) free(pp->bbuf);
-            free(pp);
+            path_free(pp);
             if (old) old->next = ppnext;
         } else {
             old = pp;
@@ -319,6 +441,89 @@ void path_delete(Pathcomp_t *first) {
     }
 }
 
+static_fn int path_cmpname(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+void path_freeindex(struct pathindex *ip) {
+    free(ip->names);
+    free(ip->buf);
+    free(ip);
+}
+
+//
+// Read the names in directory <dir> whose status is <sp>.
+//
+static_fn struct pathindex *path_readdir(const char *dir, struct stat *sp) {
+    struct pathindex *ip;
+    struct dirent *dp;
+    DIR *dirf;
+    char *buf = NULL, *cp;
+    size_t size = 0, used = 0, len, n;
+
+    if (!(dirf = opendir(dir))) return NULL;
+    ip = calloc(1, sizeof(struct pathindex));
+    if (!ip) errormsg(SH_DICT, ERROR_system(1), e_nospace);
+    while ((dp = readdir(dirf))) {
+        len = strlen(dp->d_name) + 1;
+        if (used + len > size) {
+            size = roundof(used + len, 1024) * 2;
+            buf = realloc(buf, size);
+            if (!buf) errormsg(SH_DICT, ERROR_system(1), e_nospace);
+        }
+        memcpy(buf + used, dp->d_name, len);
+        used += len;
+        ip->nnames++;
+    }
+    closedir(dirf);
+    ip->names = malloc((ip->nnames + 1) * sizeof(char *));
+    if (!ip->names) errormsg(SH_DICT, ERROR_system(1), e_nospace);
+    for (cp = buf, n = 0; n < ip->nnames; cp += strlen(cp) + 1) ip->names[n++] = cp;
+    qsort(ip->names, ip->nnames, sizeof(char *), path_cmpname);
+    ip->buf = buf;
+    ip->dev = sp->st_dev;
+    ip->ino = sp->st_ino;
+    ip->mtime = sp->st_mtime;
+    ip->mtimensec = ST_MTIME_NSEC_GET(sp);
+    return ip;
+}
+
+//
+// Return the index of the names in the directory of <pp>, reading the directory again if it has
+// changed since the index was built. Only directories named by an absolute pathname are kept.
+// NULL is returned if there is no index that can be trusted unless <force> is set, in which case
+// an index is returned that is freed by the caller if it is not pp->index.
+//
+struct pathindex *path_index(Pathcomp_t *pp, bool force) {
+    struct pathindex *ip = pp->index;
+    struct stat statb;
+
+    if (sh_stat(pp->name, &statb) < 0 || !S_ISDIR(statb.st_mode)) {
+        if (ip) path_freeindex(ip);
+        pp->index = NULL;
+        return NULL;
+    }
+    if (ip && ip->dev == statb.st_dev && ip->ino == statb.st_ino && ip->mtime == statb.st_mtime &&
+        ip->mtimensec == ST_MTIME_NSEC_GET(&statb)) {
+        return ip;
+    }
+    if (ip) path_freeindex(ip);
+    pp->index = NULL;
+    // A directory can change again within the resolution of its modification time without the
+    // time changing, so one that has just changed is read each time until it settles.
+    if (*pp->name == '/' && statb.st_mtime < time(NULL) - 1) {
+        return pp->index = path_readdir(pp->name, &statb);
+    }
+    return force ? path_readdir(pp->name, &statb) : NULL;
+}
+
+//
+// Returns true if <name> is in the index <ip>.
+//
+static_fn bool path_indexfind(struct pathindex *ip, const char *name) {
+    return bsearch(&name, ip->names, ip->nnames, sizeof(char *), path_cmpname) != NULL;
+}
+
 //
 // Returns library variable from .paths. The value might be returned on the stack overwriting path.
 //
@@ -590,6 +795,7 @@ static_fn void funload(Shell_t *shp, int fno, const char *name) {
     shp->st.filename = pname;
     shp->funload = 1;
     error_info.line = 0;
+    fno = sh_pcopen(shp, fno, pname);
     sh_eval(shp, sfnew(NULL, buff, IOBSIZE, fno, SF_READ), SH_FUNEVAL);
     sh_close(fno);
     shp->readscript = NULL;
@@ -694,16 +900,14 @@ static_fn bool pwdinfpath(void) {
     return false;
 }
 
-//
-// Do a path search and find the full pathname of file name.
-//
-Pathcomp_t *path_absolute(Shell_t *shp, const char *name, Pathcomp_t *pp) {
+static_fn Pathcomp_t *path_walk(Shell_t *shp, const char *name, Pathcomp_t *pp) {
     int isfun;
     int fd = -1;
     int noexec = 0;
     Pathcomp_t *oldpp;
     Namval_t *np;
     char *cp;
+    struct pathindex *ip;
 
     shp->path_err = ENOENT;
     if (!pp && !(pp = path_get(shp, ""))) return 0;
@@ -776,7 +980,7 @@ Pathcomp_t *path_absolute(Shell_t *shp, const char *name, Pathcomp_t *pp) {
                     oldpp->blib = oldpp->bbuf = NULL;
                 }
                 n = stktell(shp->stk);
-                sfputr(shp->stk, "b_", 0);
+                sfputr(shp->stk, "b_", -1);
                 sfputr(shp->stk, name, 0);
                 m = stktell(shp->stk);
                 shp->bltin_dir = oldpp->name;
@@ -796,8 +1000,15 @@ Pathcomp_t *path_absolute(Shell_t *shp, const char *name, Pathcomp_t *pp) {
                     shp->bltin_dir = NULL;
                     return oldpp;
                 }
-                dll = dllplugin(SH_ID, stkptr(shp->stk, m), NULL, SH_PLUGIN_VERSION, NULL,
-                                RTLD_LAZY, NULL, 0);
+                // The index can tell that the library doesn't have the builtin without loading it.
+                sh_pluginindex(shp);
+                if (dllindexsym(SH_ID, stkptr(shp->stk, m), NULL, SH_PLUGIN_VERSION,
+                                stkptr(shp->stk, n)) == 0) {
+                    dll = NULL;
+                } else {
+                    dll = dllplugin(SH_ID, stkptr(shp->stk, m), NULL, SH_PLUGIN_VERSION, NULL,
+                                    RTLD_LAZY, NULL, 0);
+                }
                 if (dll) sh_addlib(shp, dll, stkptr(shp->stk, m), oldpp);
                 if (dll && (addr = (Shbltin_f)dlllook(dll, stkptr(shp->stk, n))) &&
                     (!(np = sh_addbuiltin(shp, stkptr(shp->stk, PATH_OFFSET), NULL, NULL)) ||
@@ -816,7 +1027,18 @@ Pathcomp_t *path_absolute(Shell_t *shp, const char *name, Pathcomp_t *pp) {
         }
         shp->bltin_dir = NULL;
         sh_stats(STAT_PATHS);
-        fd = can_execute(shp, stkptr(shp->stk, PATH_OFFSET), isfun);
+#if !__CYGWIN__
+        // An interactive shell looks for the name in the index of the directory instead. This still
+        // costs a stat() of the directory for each lookup, which can't be saved for later lookups:
+        // a name that is not found is not remembered, so a command added to the directory, by
+        // this shell or by any other process, must be found the next time it is looked up.
+        if (sh_isoption(shp, SH_INTERACTIVE) && !strchr(name, '/') &&
+            (ip = path_index(oldpp, false)) && !path_indexfind(ip, name)) {
+            errno = ENOENT;
+            fd = -1;
+        } else
+#endif
+            fd = can_execute(shp, stkptr(shp->stk, PATH_OFFSET), isfun);
         if (isfun && fd >= 0 && (cp = strrchr(name, '.'))) {
             *cp = 0;
             if (nv_open(name, sh_subfuntree(shp, 1), NV_NOARRAY | NV_IDENT | NV_NOSCOPE)) {
@@ -862,6 +1084,17 @@ Pathcomp_t *path_absolute(Shell_t *shp, const char *name, Pathcomp_t *pp) {
     return oldpp;
 }
 
+//
+// Do a path search and find the full pathname of file name.
+//
+Pathcomp_t *path_absolute(Shell_t *shp, const char *name, Pathcomp_t *pp) {
+    uint64_t start = sh_statclock();
+
+    pp = path_walk(shp, name, pp);
+    sh_stattime(STAT_TPATH, sh_statclock() - start);
+    return pp;
+}
+
 //
 // Returns 0 if path can execute. Sets exec_err if file is found but can't be executable.
 //
@@ -1133,6 +1366,7 @@ pid_t path_spawn(Shell_t *shp, const char *opath, char **argv, char **envp, Path
     path = path_relative(shp, opath);
     if (spawn /* && !sh_isoption(shp,SH_PFSH) */) {
         pid = _spawnveg(shp, opath, &argv[0], envp, spawn >> 1);
+        SH_PROBE2(spawn, opath, pid);
     } else {
         pid = path_pfexecve(shp, opath, &argv[0], envp, spawn);
     }
@@ -1537,7 +1771,7 @@ void path_newdir(Shell_t *shp, Pathcomp_t *first) {
         // Delete .paths component.
         if ((next = pp->next) && (next->flags & PATH_BFPATH)) {
             pp->next = next->next;
-            if (--next->refcount <= 0) free(next);
+            if (--next->refcount <= 0) path_free(next);
         }
         if (sh_stat(pp->name, &statb) < 0 || !S_ISDIR(statb.st_mode)) {
             pp->dev = 0;
@@ -1596,10 +1830,7 @@ Pathcomp_t *path_unsetfpath(Shell_t *shp) {
                     first = pp->next;
                 }
                 pp = pp->next;
-                if (--ppsave->refcount <= 0) {
-                    if (ppsave->lib) free(ppsave->lib);
-                    free(ppsave);
-                }
+                if (--ppsave->refcount <= 0) path_free(ppsave);
                 continue;
             }
         }
@@ -1638,7 +1869,7 @@ static_fn char *talias_get(Namval_t *np, Namfun_t *nvp) {
 static_fn void talias_put(Namval_t *np, const void *val, nvflag_t flags, Namfun_t *fp) {
     if (!val && FETCH_VT(np->nvalue, const_cp)) {
         Pathcomp_t *pp = (Pathcomp_t *)FETCH_VT(np->nvalue, const_cp);
-        if (--pp->refcount <= 0) free(pp);
+        if (--pp->refcount <= 0) path_free(pp);
     }
     nv_putv(np, val, flags, fp);
 }
@@ -1658,9 +1889,7 @@ void path_alias(Namval_t *np, Pathcomp_t *pp) {
         nv_offattr(np, NV_NOPRINT);
         nv_stack(np, &talias_init);
         old = FETCH_VT(np->nvalue, pathcomp);
-        if (old && (--old->refcount <= 0)) {
-            free(old);
-        }
+        if (old && (--old->refcount <= 0)) path_free(old);
         STORE_VT(np->nvalue, pathcomp, pp);
         pp->refcount++;
         nv_setattr(np, NV_TAGGED | NV_NOFREE);
@@ -0,0 +1,268 @@
+//
+// Sampling profiler.
+//
+// When KSH_PROFILE names a file in the environment of a shell, the shell sets a profiling timer
+// that sends it SIGPROF for every millisecond of CPU time that it uses. The signal handler only
+// notes the signal. sh_exec() calls sh_proftick() before it starts the next command, while the
+// scope chain and error_info.line still describe the command that was running, and the CPU time
+// used since the last sample is added to the stack of active functions and to the line of that
+// command. The timer may fire less often than asked for, so samples are counted in milliseconds
+// of CPU time rather than in signals.
+//
+// The shell uses no CPU while it is blocked in job_wait(), so the time it waits for the commands
+// it runs is not sampled. job_wait() measures that time instead, which is converted to samples
+// and recorded apart from the CPU samples, under a [wait] frame and in the wait column of the line
+// table.
+//
+// When the shell exits the stacks are written to the file in the folded format that flamegraph.pl
+// and similar tools read: one line for each stack with the frames from the outermost one on,
+// separated by semicolons, and the number of samples. A table of the samples for each line of
+// the script, busiest first, is written to the same pathname with .lines appended.
+//
+#include "config_ast.h"  // IWYU pragma: keep
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ast.h"
+#include "cdt.h"
+#include "defs.h"
+#include "error.h"
+#include "fault.h"
+#include "name.h"
+#include "sfio.h"
+
+#define PROF_HZ 1000       // samples per second of CPU time
+#define PROF_MAXDEPTH 256  // frames of a stack that are recorded
+
+struct profent {
+    Dtlink_t link;
+    char *name;  // folded stack or line
+    long cpu;    // samples of shell CPU time
+    long wait;   // samples of time spent waiting for children
+};
+
+volatile sig_atomic_t sh_profticks;
+bool sh_profon;
+
+static struct {
+    char *file;     // where the folded stacks are written
+    Dt_t *stacks;   // samples by folded stack
+    Dt_t *lines;    // samples by line
+    Sfio_t *key;    // buffer for keys
+    char *script;   // pathname of the script, kept for samples taken after it is freed
+    double used;    // CPU time when the last sample was recorded
+    double cpu;     // samples of CPU time that are not yet recorded
+    double waited;  // samples of waiting that are not yet recorded
+} prof;
+
+static_fn void prof_free(Dt_t *dict, void *obj, Dtdisc_t *disc) {
+    UNUSED(dict);
+    UNUSED(disc);
+    free(obj);
+}
+
+static Dtdisc_t prof_disc = {.key = offsetof(struct profent, name),
+                             .size = -1,
+                             .link = offsetof(struct profent, link),
+                             .freef = prof_free};
+
+static_fn double prof_cputime(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + 1.e-9 * ts.tv_nsec;
+}
+
+static_fn void prof_handler(int sig) {
+    UNUSED(sig);
+    sh_profticks = 1;
+}
+
+static_fn void prof_count(Dt_t *dict, const char *name, long cpu, long wait) {
+    struct profent *pp = dtmatch(dict, name);
+    size_t n;
+
+    if (!pp) {
+        n = strlen(name) + 1;
+        if (!(pp = malloc(sizeof(struct profent) + n))) return;
+        pp->name = memcpy(pp + 1, name, n);
+        pp->cpu = pp->wait = 0;
+        dtinsert(dict, pp);
+    }
+    pp->cpu += cpu;
+    pp->wait += wait;
+}
+
+//
+// The pathname of the script that the outermost scope <sp> runs, which is the same pathname that
+// the frames of its functions use. The shell frees it before it exits, so a copy is kept.
+//
+static_fn const char *prof_script(Shell_t *shp, const struct sh_scoped *sp) {
+    if (sp->filename && (!prof.script || strcmp(prof.script, sp->filename))) {
+        free(prof.script);
+        prof.script = strdup(sp->filename);
+    }
+    return prof.script ? prof.script : shp->shname;
+}
+
+//
+// The frame for scope <sp>. A function call starts a scope with a new function name, or with the
+// same name and file for a recursive call. A file read with `.` starts a scope with a new file
+// name and the function name of its caller.
+//
+static_fn const char *prof_frame(Shell_t *shp, const struct sh_scoped *sp) {
+    const struct sh_scoped *pp = sp->prevst;
+
+    if (!pp) return prof_script(shp, sp);
+    if (sp->funname == pp->funname && sp->filename != pp->filename && sp->filename) {
+        return sp->filename;
+    }
+    return sp->funname ? sp->funname : "";
+}
+
+//
+// Add <cpu> samples of shell CPU time or <wait> samples of waiting to the current stack and line.
+//
+static_fn void prof_record(Shell_t *shp, long cpu, long wait) {
+    const struct sh_scoped *frames[PROF_MAXDEPTH];
+    const struct sh_scoped *sp;
+    const char *cp;
+    int n = 0;
+
+    for (sp = &shp->st; sp && n < PROF_MAXDEPTH; sp = sp->prevst) frames[n++] = sp;
+    while (n-- > 0) {
+        // A semicolon separates frames and the count follows the last blank.
+        for (cp = prof_frame(shp, frames[n]); *cp; cp++) {
+            sfputc(prof.key, *cp == ';' ? ':' : *cp);
+        }
+        if (n) sfputc(prof.key, ';');
+    }
+    if (wait) sfputr(prof.key, ";[wait]", -1);
+    prof_count(prof.stacks, sfstruse(prof.key), cpu, wait);
+    sfprintf(prof.key, "%s:%d", shp->st.filename ? shp->st.filename : prof_script(shp, &shp->st),
+             error_info.line + shp->st.firstline);
+    if (shp->st.funname) sfprintf(prof.key, " %s", shp->st.funname);
+    prof_count(prof.lines, sfstruse(prof.key), cpu, wait);
+}
+
+//
+// Start the profiler if KSH_PROFILE is set.
+//
+void sh_profstart(Shell_t *shp) {
+    Namval_t *np = nv_search("KSH_PROFILE", shp->var_tree, 0);
+    struct itimerval tv;
+    struct sigaction sa;
+    char *cp;
+
+    if (!np || !(cp = nv_getval(np)) || !*cp || sh_profon) return;
+    prof.file = strdup(cp);
+    prof.stacks = dtopen(&prof_disc, Dtset);
+    prof.lines = dtopen(&prof_disc, Dtset);
+    prof.key = sfstropen();
+    if (!prof.file || !prof.stacks || !prof.lines || !prof.key) return;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = prof_handler;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGPROF, &sa, NULL) < 0) return;
+    // Keep `trap` and sh_sigdone() from replacing the handler.
+    shp->sigflag[SIGPROF] |= SH_SIGOFF;
+    tv.it_interval.tv_sec = 0;
+    tv.it_interval.tv_usec = 1000000 / PROF_HZ;
+    tv.it_value = tv.it_interval;
+    if (setitimer(ITIMER_PROF, &tv, NULL) < 0) return;
+    prof.used = prof_cputime();
+    sh_profon = true;
+}
+
+//
+// Record the CPU time used since the last sample. Called by sh_exec() when sh_profticks is set.
+//
+void sh_proftick(Shell_t *shp) {
+    double now;
+    long n;
+
+    sh_profticks = 0;
+    if (!sh_profon) return;
+    now = prof_cputime();
+    prof.cpu += (now - prof.used) * PROF_HZ;
+    prof.used = now;
+    n = (long)prof.cpu;
+    if (n <= 0) return;
+    prof.cpu -= n;
+    prof_record(shp, n, 0);
+}
+
+//
+// Record <elapsed> nanoseconds as time spent waiting for children.
+//
+void sh_profwait(Shell_t *shp, uint64_t elapsed) {
+    long n;
+
+    if (!sh_profon) return;
+    prof.waited += elapsed * (PROF_HZ / 1.e9);
+    n = (long)prof.waited;
+    if (n <= 0) return;
+    prof.waited -= n;
+    prof_record(shp, 0, n);
+}
+
+static_fn int prof_cmp(const void *a, const void *b) {
+    const struct profent *pa = *(struct profent *const *)a;
+    const struct profent *pb = *(struct profent *const *)b;
+    long d = (pb->cpu + pb->wait) - (pa->cpu + pa->wait);
+
+    if (d) return d < 0 ? -1 : 1;
+    return strcmp(pa->name, pb->name);
+}
+
+static_fn void prof_lines(Sfio_t *out) {
+    struct profent **list, *pp;
+    int i, n = dtsize(prof.lines);
+
+    if (!(list = malloc((n + 1) * sizeof(*list)))) return;
+    for (i = 0, pp = dtfirst(prof.lines); pp && i < n; pp = dtnext(prof.lines, pp)) {
+        list[i++] = pp;
+    }
+    qsort(list, i, sizeof(*list), prof_cmp);
+    sfprintf(out, "%8s %8s  %s\n", "cpu", "wait", "line");
+    for (n = 0; n < i; n++) {
+        sfprintf(out, "%8ld %8ld  %s\n", list[n]->cpu, list[n]->wait, list[n]->name);
+    }
+    free(list);
+}
+
+//
+// Stop the profiler and write the profile. This is done when the shell exits or replaces itself
+// with `exec`, since the timer would otherwise stay set in the new program.
+//
+void sh_profdone(Shell_t *shp) {
+    struct itimerval tv;
+    struct profent *pp;
+    Sfio_t *out;
+
+    if (!sh_profon) return;
+    memset(&tv, 0, sizeof(tv));
+    setitimer(ITIMER_PROF, &tv, NULL);
+    sh_proftick(shp);
+    sh_profon = false;
+    if ((out = sfopen(NULL, prof.file, "w"))) {
+        for (pp = dtfirst(prof.stacks); pp; pp = dtnext(prof.stacks, pp)) {
+            sfprintf(out, "%s %ld\n", pp->name, pp->cpu + pp->wait);
+        }
+        sfclose(out);
+    }
+    sfprintf(prof.key, "%s.lines", prof.file);
+    if ((out = sfopen(NULL, sfstruse(prof.key), "w"))) {
+        prof_lines(out);
+        sfclose(out);
+    }
+}
@@ -0,0 +1,248 @@
+//
+// Variable access for plugins.
+//
+// Builtins loaded from libraries get the table at the end of this file through the `api` member
+// of their context. The functions are thin wrappers around the nv_* routines that take numbers
+// and subscripts as numbers instead of text, so a builtin that works through a large array does
+// not format and parse a string for each element. See shcmd.h for the interface.
+//
+#include "config_ast.h"  // IWYU pragma: keep
+
+#include <float.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "cdt.h"
+#include "defs.h"
+#include "name.h"
+#include "sfio.h"
+#include "shcmd.h"
+
+#define NV_APINUM (NV_INTEGER | NV_DOUBLE | NV_LONG | NV_SHORT | NV_UNSIGN | NV_EXPNOTE)
+
+static_fn Namval_t *api_open(Shell_t *shp, const char *name, int flags) {
+    Namval_t *np;
+
+    np = nv_open(name, shp->var_tree,
+                 NV_VARNAME | NV_NOFAIL | ((flags & SH_API_CREATE) ? 0 : NV_NOADD));
+    if (!np || !(flags & (SH_API_ASSOC | SH_API_INDEXED)) || nv_isarray(np) || !nv_isnull(np)) {
+        return np;
+    }
+    if (shp->subshell) sh_assignok(np, 1);
+    if (flags & SH_API_ASSOC) {
+        nv_setarray(np, nv_associative);
+    } else {
+        nv_onattr(np, NV_ARRAY);
+    }
+    return np;
+}
+
+// The node of a member of the compound variable <np>, which may be the current element of an
+// array of compound variables.
+static_fn Namval_t *api_member(Namval_t *np, const char *name, int flags) {
+    Shell_t *shp = sh_ptr(np);
+    Namval_t *mp;
+
+    if (nv_isarray(np) && (mp = nv_opensub(np))) np = mp;
+    if (!nv_isvtree(np)) {
+        if (!(flags & SH_API_CREATE) || !nv_isnull(np)) return NULL;
+        nv_setvtree(np);
+    }
+    sfprintf(shp->strbuf, "%s.%s", nv_name(np), name);
+    return api_open(shp, sfstruse(shp->strbuf), flags);
+}
+
+static_fn int api_kind(Namval_t *np) {
+    Namarr_t *ap = nv_arrayptr(np);
+    int kind;
+
+    if (ap) {
+        kind = is_associative(ap) ? SH_API_MAP : SH_API_ARRAY;
+    } else if (nv_isvtree(np)) {
+        kind = SH_API_COMPOUND;
+    } else if (nv_isnull(np)) {
+        return SH_API_UNSET;
+    } else {
+        kind = SH_API_SCALAR;
+    }
+    if (nv_isattr(np, NV_INTEGER)) kind |= SH_API_NUMERIC;
+    return kind;
+}
+
+static_fn long api_count(Namval_t *np) {
+    Namarr_t *ap = nv_arrayptr(np);
+
+    if (ap) return nv_arraynsub(ap);
+    return nv_isnull(np) ? 0 : 1;
+}
+
+//
+// Make the element after the current one of a walk current. Each step starts again from the
+// subscript of the previous element rather than keep a ${name[@]} scan going, so a walk that is
+// abandoned leaves no scan state behind in the array.
+//
+static_fn bool api_next(Shapi_iter_t *it) {
+    Namval_t *np = it->array;
+    Namarr_t *ap = nv_arrayptr(np);
+    Namval_t *mp = NULL;
+    bool found = false;
+
+    if (ap && is_associative(ap)) {
+        if (!it->sub) {
+            mp = dtfirst(ap->table);
+        } else if ((mp = nv_search(it->sub, ap->table, 0))) {
+            mp = dtnext(ap->table, mp);
+        }
+        while (mp && nv_isnull(mp)) mp = dtnext(ap->table, mp);
+        found = mp && nv_putsub(np, (char *)mp, 0, ARRAY_SETSUB);
+    } else if (ap && nv_arraynsub(ap) && (!it->sub || it->index < nv_aimax(np))) {
+        found = nv_putsub(np, NULL, it->sub ? it->index + 1 : 0, ARRAY_SCAN) != NULL;
+        if ((ap = nv_arrayptr(np))) ap->flags &= ~ARRAY_SCAN;
+    }
+    if (!found) {
+        it->node = NULL;
+        it->sub = NULL;
+        it->index = -1;
+        return false;
+    }
+    it->sub = nv_getsub(np);
+    it->index = nv_aindex(np);
+    mp = nv_opensub(np);
+    it->node = mp && (nv_isvtree(mp) || nv_isarray(mp)) ? mp : np;
+    return true;
+}
+
+static_fn bool api_select(Namval_t *np, const char *sub, long index, int flags) {
+    Namarr_t *ap = nv_arrayptr(np);
+    Namval_t *mp;
+    nvflag_t mode = (flags & SH_API_CREATE) ? ARRAY_ADD | ARRAY_FILL : 0;
+
+    if (ap && is_associative(ap)) {
+        if (!sub || !nv_putsub(np, (char *)sub, 0, mode)) return false;
+        // A lookup adds a placeholder for a missing subscript like ${name[sub]} does.
+        return (flags & SH_API_CREATE) || ((mp = nv_opensub(np)) && !nv_isnull(mp));
+    }
+    if (sub || index < 0 || (unsigned long)index >= ARRAY_MAX) return false;
+    if (!ap && !(flags & SH_API_CREATE)) return false;
+    if (ap && !(flags & SH_API_CREATE) && index > nv_aimax(np)) return false;
+    return nv_putsub(np, NULL, index, mode) != NULL;
+}
+
+static_fn const char *api_borrow(Namval_t *np, size_t *len) {
+    const char *cp;
+
+    if (nv_isattr(np, NV_INTEGER) || !(cp = nv_getval(np))) return NULL;
+    if (len) *len = strlen(cp);
+    return cp;
+}
+
+static_fn bool api_getint(Namval_t *np, int64_t *vp) {
+    const char *cp;
+    char *ep;
+
+    if (nv_isattr(np, NV_INTEGER)) {
+        if (nv_isnull(np)) return false;
+        *vp = (int64_t)nv_getnum(np);
+        return true;
+    }
+    if (!(cp = nv_getval(np)) || !*cp) return false;
+    *vp = strtoll(cp, &ep, 10);
+    return *ep == 0;
+}
+
+static_fn bool api_getnum(Namval_t *np, double *vp) {
+    const char *cp;
+    char *ep;
+
+    if (nv_isattr(np, NV_INTEGER)) {
+        if (nv_isnull(np)) return false;
+        *vp = (double)nv_getnum(np);
+        return true;
+    }
+    if (!(cp = nv_getval(np)) || !*cp) return false;
+    *vp = strtod(cp, &ep);
+    return *ep == 0;
+}
+
+static_fn void api_putstr(Namval_t *np, const char *val) { nv_putval(np, val, 0); }
+
+static_fn void api_putint(Namval_t *np, int64_t val) {
+    Sflong_t l = val;
+
+    nv_putval(np, &l, NV_INT64);
+}
+
+static_fn void api_putnum(Namval_t *np, double val) {
+    Sfdouble_t d = val;
+
+    nv_putval(np, &d, NV_LDOUBLE);
+}
+
+// An associative array can't be appended to. A variable without a value gets the numeric type
+// of what is appended to it, like `typeset -a -li` or `typeset -a -lE`.
+static_fn bool api_canappend(Namval_t *np, nvflag_t type) {
+    Namarr_t *ap = nv_arrayptr(np);
+
+    if (ap && is_associative(ap)) return false;
+    if (type && !ap && nv_isnull(np) && nv_isattr(np, NV_APINUM) != type) {
+        if (sh_ptr(np)->subshell) sh_assignok(np, 1);
+        nv_newattr(np, type, type == NV_INT64 ? 10 : LDBL_DIG - 2);
+    }
+    return true;
+}
+
+static_fn long api_append(Namval_t *np, const char *const *vals, size_t n) {
+    if (!api_canappend(np, 0) || n > INT_MAX) return -1;
+    return nv_appendvec(np, (int)n, vals, 0, 0);
+}
+
+static_fn long api_appendint(Namval_t *np, const int64_t *vals, size_t n) {
+    Sflong_t *lp;
+    size_t i;
+    long r;
+
+    if (!api_canappend(np, NV_INT64) || n > INT_MAX) return -1;
+    if (sizeof(Sflong_t) == sizeof(int64_t)) {
+        return nv_appendvec(np, (int)n, vals, sizeof(*vals), NV_INT64);
+    }
+    if (!(lp = malloc(n * sizeof(Sflong_t) + 1))) return -1;
+    for (i = 0; i < n; i++) lp[i] = vals[i];
+    r = nv_appendvec(np, (int)n, lp, sizeof(*lp), NV_INT64);
+    free(lp);
+    return r;
+}
+
+static_fn long api_appendnum(Namval_t *np, const double *vals, size_t n) {
+    Sfdouble_t *dp;
+    size_t i;
+    long r;
+
+    if (!api_canappend(np, NV_LDOUBLE | NV_EXPNOTE) || n > INT_MAX) return -1;
+    if (!(dp = malloc(n * sizeof(Sfdouble_t) + 1))) return -1;
+    for (i = 0; i < n; i++) dp[i] = vals[i];
+    r = nv_appendvec(np, (int)n, dp, sizeof(*dp), NV_LDOUBLE);
+    free(dp);
+    return r;
+}
+
+const Shapi_t sh_api = {.version = SH_API_VERSION,
+                        .open = api_open,
+                        .member = api_member,
+                        .kind = api_kind,
+                        .count = api_count,
+                        .next = api_next,
+                        .select = api_select,
+                        .borrow = api_borrow,
+                        .getint = api_getint,
+                        .getnum = api_getnum,
+                        .putstr = api_putstr,
+                        .putint = api_putint,
+                        .putnum = api_putnum,
+                        .append = api_append,
+                        .appendint = api_appendint,
+                        .appendnum = api_appendnum};
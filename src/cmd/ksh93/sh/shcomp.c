@@ -27,6 +27,7 @@
 
 #include <string.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include "argnod.h"
 #include "defs.h"
@@ -44,6 +45,9 @@ static const char usage[] =
     "\ainfile\a, and creates a binary format file, \aoutfile\a, that "
     "\bksh\b can read and execute with the same effect as the original "
     "script.]"
+    "[+?\aoutfile\a holds an image of the parsed script that \bksh\b uses in "
+    "place, so it can only be run by a \bksh\b built for the same machine "
+    "architecture.]"
     "[+?Since aliases are processed as the script is read, alias definitions "
     "whose value requires variable expansion will not work correctly.]"
     "[+?If \b-D\b is specified, all double quoted strings that are preceded by "
@@ -67,12 +71,9 @@ static const char usage[] =
     "}"
     "[+SEE ALSO?\bksh\b(1)]";
 
-#define CNTL(x) ((x)&037)
-#define VERSION 3
-static const char header[6] = {CNTL('k'), CNTL('s'), CNTL('h'), 0, VERSION, 0};
-
 int main(int argc, char *argv[]) {
     Sfio_t *in, *out;
+    struct tdump *dump = NULL;
     Shell_t *shp;
     Namval_t *np;
     Shnode_t *t;
@@ -123,6 +124,8 @@ int main(int argc, char *argv[]) {
     cp = *argv;
     if (cp) {
         struct stat statb;
+        // Shells running the old file have it mapped so give the new one a new inode.
+        if (stat(cp, &statb) >= 0 && S_ISREG(statb.st_mode)) unlink(cp);
         if (!(out = sfopen(NULL, cp, "w"))) {
             errormsg(SH_DICT, ERROR_system(1), "%s: cannot create", cp);
             __builtin_unreachable();
@@ -140,7 +143,10 @@ int main(int argc, char *argv[]) {
     sh_trap(shp, "enum _Bool=(false true) ;", 0);
     if (nflag) sh_onoption(shp, SH_NOEXEC);
     if (vflag) sh_onoption(shp, SH_VERBOSE);
-    if (!dflag) sfwrite(out, header, sizeof(header));
+    if (!dflag && !(dump = sh_tdumpopen(false))) {
+        errormsg(SH_DICT, ERROR_exit(1), "dump failed");
+        __builtin_unreachable();
+    }
     shp->inlineno = 1;
     sh_onoption(shp, SH_BRACEEXPAND);
     while (1) {
@@ -151,7 +157,7 @@ int main(int argc, char *argv[]) {
                 strcmp(nv_name((Namval_t *)t->com.comnamp), "alias") == 0) {
                 sh_exec(shp, t, 0);
             }
-            if (!dflag && sh_tdump(out, t) < 0) {
+            if (dump && sh_tdumpadd(dump, t) < 0) {
                 errormsg(SH_DICT, ERROR_exit(1), "dump failed");
                 __builtin_unreachable();
             }
@@ -176,6 +182,10 @@ int main(int argc, char *argv[]) {
             }
         }
     }
+    if (dump && sh_tdumpclose(dump, out) < 0) {
+        errormsg(SH_DICT, ERROR_exit(1), "dump failed");
+        __builtin_unreachable();
+    }
     // Copy any remaining input.
     sfmove(in, out, SF_UNBOUND, -1);
     if (in != sfstdin) sfclose(in);
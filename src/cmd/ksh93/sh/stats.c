@@ -0,0 +1,136 @@
+//
+// Latency histograms for the performance statistics.
+//
+// The counters of sh_stats() are in shgd->stats and are shown by .sh.stats. The operations that
+// are expensive enough to be worth timing also add the time they took to one of the histograms
+// here. A histogram counts the operations in buckets of powers of two microseconds: bucket 0
+// counts those that took less than a microsecond and bucket i those that took at least 2^(i-1)
+// and less than 2^i microseconds. `unset .sh.stats` clears the counters and the histograms.
+//
+// When KSH_STATS names a file when the shell exits, a line of JSON with the counters and the
+// histograms is appended to it, so that the file collects a line for each shell that uses it.
+//
+#include "config_ast.h"  // IWYU pragma: keep
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ast.h"
+#include "ast_regex.h"
+#include "defs.h"
+#include "name.h"
+#include "probe.h"
+#include "sfio.h"
+
+#define STAT_NBUCKETS 32
+
+struct stattime {
+    uint64_t count;
+    uint64_t total;  // nanoseconds
+    uint64_t max;    // nanoseconds
+    uint64_t buckets[STAT_NBUCKETS];
+};
+
+static struct stattime stattimes[STAT_NTIMES];
+
+// The names of the histograms in the order of the STAT_T* values.
+static const char *statnames[STAT_NTIMES] = {"fork",     "spawn",      "wait",    "comsub",
+                                             "subshell", "pathsearch", "regcomp", "heredoc"};
+
+uint64_t sh_statclock(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+//
+// Add an operation of kind <which> that took <elapsed> nanoseconds.
+//
+void sh_stattime(int which, uint64_t elapsed) {
+    struct stattime *tp = &stattimes[which];
+    uint64_t usec = elapsed / 1000;
+    int i = 0;
+
+    while (usec && i < STAT_NBUCKETS - 1) {
+        usec >>= 1;
+        i++;
+    }
+    tp->buckets[i]++;
+    tp->count++;
+    tp->total += elapsed;
+    if (elapsed > tp->max) tp->max = elapsed;
+}
+
+static_fn void stat_regcomp(const char *pattern, uint64_t elapsed) {
+    UNUSED(pattern);
+    SH_PROBE2(regcomp, pattern, elapsed);
+    sh_stats(STAT_REGCOMPS);
+    sh_stattime(STAT_TREGCOMP, elapsed);
+}
+
+void sh_statinit(Shell_t *shp) {
+    UNUSED(shp);
+    regcache_compiled = stat_regcomp;
+}
+
+void sh_statreset(Shell_t *shp) {
+    int i;
+
+    UNUSED(shp);
+    for (i = 0; *shtab_stats[i].sh_name; i++) shgd->stats[i] = 0;
+    memset(stattimes, 0, sizeof(stattimes));
+}
+
+//
+// Append the statistics to the file named by KSH_STATS. Only the shell that was started writes
+// them, not the subshells that it forks, and only once, either when it exits or when it is
+// replaced by `exec`.
+//
+void sh_statdump(Shell_t *shp) {
+    static bool dumped;
+    Namval_t *np = nv_search("KSH_STATS", shp->var_tree, 0);
+    const char *file, *name;
+    struct stattime *tp;
+    Sfio_t *out;
+    int fd, i, j, n;
+
+    if (dumped || !np || !(file = nv_getval(np)) || !*file || getpid() != shgd->pid) return;
+    dumped = true;
+    if (!(out = sfstropen())) return;
+    name = shp->st.filename ? shp->st.filename : shp->shname;
+    sfprintf(out, "{\"pid\":%d,\"name\":%s,\"counters\":{", (int)shgd->pid,
+             sh_fmtj(name ? name : ""));
+    for (i = 0; *shtab_stats[i].sh_name; i++) {
+        sfprintf(out, "%s\"%s\":%d", i ? "," : "", shtab_stats[i].sh_name, shgd->stats[i]);
+    }
+    sfputr(out, "},\"latency_us\":{", -1);
+    for (i = 0; i < STAT_NTIMES; i++) {
+        tp = &stattimes[i];
+        sfprintf(out, "%s\"%s\":{\"count\":%llu,\"total\":%llu,\"max\":%llu,\"buckets\":[",
+                 i ? "," : "", statnames[i], (unsigned long long)tp->count,
+                 (unsigned long long)(tp->total / 1000), (unsigned long long)(tp->max / 1000));
+        // Trailing empty buckets are left out.
+        for (n = STAT_NBUCKETS; n > 0 && !tp->buckets[n - 1]; n--) {
+            ;  // empty loop
+        }
+        for (j = 0; j < n; j++) {
+            sfprintf(out, "%s%llu", j ? "," : "", (unsigned long long)tp->buckets[j]);
+        }
+        sfputr(out, "]}", -1);
+    }
+    sfputr(out, "}}", '\n');
+    // A single write keeps the lines of shells that share the file apart.
+    fd = open(file, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0666);
+    if (fd >= 0) {
+        if (write(fd, sfstrbase(out), sfstrtell(out)) < 0) {
+            ;  // there is nobody to tell at exit
+        }
+        close(fd);
+    }
+    sfclose(out);
+}
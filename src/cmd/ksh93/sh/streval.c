@@ -155,7 +155,7 @@ static_fn Sfdouble_t U2F(Sfulong_t u) {
 static_fn void array_args(Shell_t *shp, char *tp, int n) {
     while (n--) {
         if (tp[n] == 5) {
-            Namval_t *np = nv_namptr(shp->mathnodes, n);
+            Namval_t *np = nv_namptr(sh_mathnodes(shp), n);
             nv_offattr(np, NV_LDOUBLE);
         }
     }
@@ -31,6 +31,7 @@
 #include <setjmp.h>
 #include <signal.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
@@ -46,6 +47,7 @@
 #include "jobs.h"
 #include "name.h"
 #include "path.h"
+#include "probe.h"
 #include "sfio.h"
 #include "shnodes.h"
 #include "variables.h"
@@ -459,6 +461,9 @@ Sfio_t *sh_subshell(Shell_t *shp, Shnode_t *t, volatile int flags, int comsub) {
 #if USE_SPAWN
     Spawnvex_t *vp;
 #endif
+    // The time spent saving and restoring the environment is the time outside of [body, done).
+    uint64_t start = sh_statclock(), done;
+    volatile uint64_t body = 0;
 
     memset((char *)sp, 0, sizeof(*sp));
     sfsync(shp->outpool);
@@ -476,6 +481,7 @@ Sfio_t *sh_subshell(Shell_t *shp, Shnode_t *t, volatile int flags, int comsub) {
     sh_pushcontext(shp, &buff, SH_JMPSUB);
     shp->subshell++;
     STORE_VT(SH_SUBSHELLNOD->nvalue, i16, shp->subshell);
+    SH_PROBE2(subshell__start, comsub, shp->subshell);
     sp->prev = subshell_data;
     sp->shp = shp;
     sp->sig = 0;
@@ -585,6 +591,7 @@ Sfio_t *sh_subshell(Shell_t *shp, Shnode_t *t, volatile int flags, int comsub) {
         }
         if (shp->savesig < 0) {
             shp->savesig = 0;
+            body = sh_statclock();
             sh_exec(shp, t, flags);
         }
     }
@@ -596,6 +603,7 @@ Sfio_t *sh_subshell(Shell_t *shp, Shnode_t *t, volatile int flags, int comsub) {
         sh_trap(shp, trap, 0);
         free(trap);
     }
+    done = sh_statclock();
     sh_popcontext(shp, &buff);
     if (shp->subshell == 0) {  // must be child process
         shp->st.trapcom[0] = 0;
@@ -783,5 +791,8 @@ Sfio_t *sh_subshell(Shell_t *shp, Shnode_t *t, volatile int flags, int comsub) {
     if (shp->ignsig) kill(getpid(), shp->ignsig);
     if (jmpval == SH_JMPSUB && shp->lastsig) kill(getpid(), shp->lastsig);
     if (jmpval && shp->toomany) siglongjmp(shp->jmplist->buff, jmpval);
+    if (body) sh_stattime(STAT_TSUBSHELL, (body - start) + (sh_statclock() - done));
+    if (comsub) sh_stattime(STAT_TCOMSUB, sh_statclock() - start);
+    SH_PROBE2(subshell__done, comsub, shp->exitval);
     return iop;
 }
@@ -21,199 +21,344 @@
 // David Korn
 // AT&T Labs
 //
+//
 // Shell parse tree dump.
 //
+// The trees are written as a compact stream of nodes followed by a table of the strings they
+// refer to and by the here-documents. The header, a struct tdimage, gives the offsets of the
+// table and of the here-documents and the number of top level trees. The nodes are written one
+// field at a time in the portable format of sfputu() and sfputl(), with the characters of each
+// word in line, and a pointer to a string holds one more than the offset of the string in the
+// table. Each distinct string is stored once. The shell reading the image builds the nodes in its
+// own memory, since it caches state in them while they are executed, and uses the string table
+// where it is, see trestore.c.
+//
 #include "config_ast.h"  // IWYU pragma: keep
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 
 #include "argnod.h"
+#include "ast.h"
+#include "cdt.h"
 #include "defs.h"
 #include "sfio.h"
 #include "shnodes.h"
 
-static_fn int dump_p_comlist(const struct dolnod *);
-static_fn int dump_p_arg(const struct argnod *);
-static_fn int dump_p_comarg(const struct comnod *);
-static_fn int dump_p_redirect(const struct ionod *);
-static_fn int dump_p_switch(const struct regnod *);
-static_fn int dump_p_tree(const Shnode_t *);
-static_fn int dump_p_string(const char *);
+#define CNTL(x) ((x)&037)
+
+static const char td_magic[TD_ALIGN] = {CNTL('k'), CNTL('s'), CNTL('h'), 0, TD_VERSION, 0, 0, 0};
+
+struct tdstring {
+    Dtlink_t link;
+    char *name;
+    size_t offset;  // offset in the string table
+};
 
-static Sfio_t *outfile;
+struct tdump {
+    Sfio_t *nodes;    // the nodes
+    Sfio_t *strings;  // string table
+    Sfio_t *docs;     // here-documents
+    Dt_t *strdict;    // strings that are already in the table
+    uint64_t ntrees;  // number of top level trees
+    bool source;
+    bool failed;
+};
 
-int sh_tdump(Sfio_t *out, const Shnode_t *t) {
-    outfile = out;
-    return dump_p_tree(t);
+static_fn void td_strfree(Dt_t *dict, void *obj, Dtdisc_t *disc) {
+    UNUSED(dict);
+    UNUSED(disc);
+    free(obj);
 }
 
+static Dtdisc_t td_strdisc = {.key = offsetof(struct tdstring, name),
+                              .size = -1,
+                              .link = offsetof(struct tdstring, link),
+                              .freef = td_strfree};
+
+static_fn void td_tree(struct tdump *, const Shnode_t *);
+
 //
-// Print script corresponding to shell tree <t>.
+// Start an image. If <source> is set then function definitions also record where their text is in
+// the file they were read from so that `typeset -f` can display it. The shell that reads such an
+// image must be the one that wrote it.
 //
-static_fn int dump_p_tree(const Shnode_t *t) {
-    if (!t) return sfputl(outfile, -1);
-    if (sfputl(outfile, t->tre.tretyp) < 0) return -1;
-    switch (t->tre.tretyp & COMMSK) {
-        case TTIME:
-        case TPAR: {
-            return dump_p_tree(t->par.partre);
-        }
-        case TCOM: {
-            return dump_p_comarg((struct comnod *)t);
-        }
-        case TSETIO:
-        case TFORK: {
-            if (sfputu(outfile, t->fork.forkline) < 0) return -1;
-            if (dump_p_tree(t->fork.forktre) < 0) return -1;
-            return dump_p_redirect(t->fork.forkio);
-        }
-        case TIF: {
-            if (dump_p_tree(t->if_.iftre) < 0) return -1;
-            if (dump_p_tree(t->if_.thtre) < 0) return -1;
-            return dump_p_tree(t->if_.eltre);
-        }
-        case TWH: {
-            if (t->wh.whinc) {
-                if (dump_p_tree((Shnode_t *)(t->wh.whinc)) < 0) return -1;
-            } else {
-                if (sfputl(outfile, -1) < 0) return -1;
-            }
-            if (dump_p_tree(t->wh.whtre) < 0) return -1;
-            return dump_p_tree(t->wh.dotre);
-        }
-        case TLST:
-        case TAND:
-        case TORF:
-        case TFIL: {
-            if (dump_p_tree(t->lst.lstlef) < 0) return -1;
-            return dump_p_tree(t->lst.lstrit);
-        }
-        case TARITH: {
-            if (sfputu(outfile, t->ar.arline) < 0) return -1;
-            return dump_p_arg(t->ar.arexpr);
-        }
-        case TFOR: {
-            if (sfputu(outfile, t->for_.forline) < 0) return -1;
-            if (dump_p_tree(t->for_.fortre) < 0) return -1;
-            if (dump_p_string(t->for_.fornam) < 0) return -1;
-            return dump_p_tree((Shnode_t *)t->for_.forlst);
-        }
-        case TSW: {
-            if (sfputu(outfile, t->sw.swline) < 0) return -1;
-            if (dump_p_arg(t->sw.swarg) < 0) return -1;
-            return dump_p_switch(t->sw.swlst);
-        }
-        case TFUN: {
-            if (sfputu(outfile, t->funct.functline) < 0) return -1;
-            if (dump_p_string(t->funct.functnam) < 0) return -1;
-            if (dump_p_tree(t->funct.functtre) < 0) return -1;
-            return dump_p_tree((Shnode_t *)t->funct.functargs);
+struct tdump *sh_tdumpopen(bool source) {
+    struct tdump *dp = calloc(1, sizeof(struct tdump));
+
+    if (!dp) return NULL;
+    dp->nodes = sfstropen();
+    dp->strings = sfstropen();
+    dp->docs = sfstropen();
+    dp->strdict = dtopen(&td_strdisc, Dtset);
+    dp->source = source;
+    if (!dp->nodes || !dp->strings || !dp->docs || !dp->strdict) {
+        sh_tdumpclose(dp, NULL);
+        return NULL;
+    }
+    return dp;
+}
+
+//
+// Add the top level tree <t> to the image.
+//
+int sh_tdumpadd(struct tdump *dp, const Shnode_t *t) {
+    if (!t) return 0;
+    td_tree(dp, t);
+    if (dp->failed) return -1;
+    dp->ntrees++;
+    return 0;
+}
+
+//
+// Write the image to <out> and free <dp>. Nothing is written if <out> is NULL.
+//
+int sh_tdumpclose(struct tdump *dp, Sfio_t *out) {
+    struct tdimage head;
+    int r = dp->failed ? -1 : 0;
+
+    if (out && r == 0) {
+        memset(&head, 0, sizeof(head));
+        head.order = TD_ORDER;
+        head.ntrees = dp->ntrees;
+        head.strings = sizeof(head) + sfstrtell(dp->nodes);
+        head.docs = head.strings + sfstrtell(dp->strings);
+        head.size = head.docs + sfstrtell(dp->docs);
+        if (sfwrite(out, td_magic, sizeof(td_magic)) != sizeof(td_magic) ||
+            sfwrite(out, &head, sizeof(head)) != sizeof(head) ||
+            sfwrite(out, sfstrbase(dp->nodes), head.strings - sizeof(head)) < 0 ||
+            sfwrite(out, sfstrbase(dp->strings), head.docs - head.strings) < 0 ||
+            sfwrite(out, sfstrbase(dp->docs), head.size - head.docs) < 0) {
+            r = -1;
         }
-        case TTST: {
-            if (sfputu(outfile, t->tst.tstline) < 0) return -1;
-            if ((t->tre.tretyp & TPAREN) == TPAREN) return dump_p_tree(t->lst.lstlef);
-            if (dump_p_arg(&(t->lst.lstlef->arg)) < 0) return -1;
-            if ((t->tre.tretyp & TBINARY)) return dump_p_arg(&(t->lst.lstrit->arg));
-            return 0;
+    }
+    if (dp->strdict) dtclose(dp->strdict);
+    if (dp->nodes) sfstrclose(dp->nodes);
+    if (dp->strings) sfstrclose(dp->strings);
+    if (dp->docs) sfstrclose(dp->docs);
+    free(dp);
+    return r;
+}
+
+//
+// Write a reference to <string>, which is added to the string table unless it is already there.
+//
+static_fn void td_string(struct tdump *dp, const char *string) {
+    struct tdstring *sp;
+    size_t n;
+
+    if (!string) {
+        sfputu(dp->nodes, 0);
+        return;
+    }
+    if (!(sp = dtmatch(dp->strdict, string))) {
+        n = strlen(string) + 1;
+        sp = malloc(sizeof(struct tdstring) + n);
+        if (!sp) {
+            errormsg(SH_DICT, ERROR_system(1), e_nospace);
+            __builtin_unreachable();
         }
-        default: { return -1; }
+        sp->name = memcpy(sp + 1, string, n);
+        sp->offset = sfstrtell(dp->strings);
+        if (sfwrite(dp->strings, string, n) != n) dp->failed = true;
+        dtinsert(dp->strdict, sp);
     }
+    sfputu(dp->nodes, sp->offset + 1);
 }
 
-static_fn int dump_p_arg(const struct argnod *arg) {
-    ssize_t n;
-    struct fornod *fp;
+static_fn void td_arg(struct tdump *dp, const struct argnod *arg) {
+    const struct fornod *fp;
+    size_t n;
 
-    while (arg) {
-        if ((n = strlen(arg->argval)) ||
-            (arg->argflag & ~(ARG_APPEND | ARG_MESSAGE | ARG_QUOTED | ARG_ARRAY))) {
-            fp = NULL;
-        } else {
+    for (; arg; arg = arg->argnxt.ap) {
+        fp = NULL;
+        n = strlen(arg->argval);
+        if (!n && !(arg->argflag & ~(ARG_APPEND | ARG_MESSAGE | ARG_QUOTED | ARG_ARRAY))) {
+            // The name of a compound assignment follows the empty value.
             fp = (struct fornod *)arg->argchn.ap;
             n = strlen(fp->fornam) + 1;
         }
-        sfputu(outfile, n + 1);
+        sfputu(dp->nodes, n + 1);
         if (fp) {
-            sfputc(outfile, 0);
-            sfwrite(outfile, fp->fornam, n - 1);
+            sfputc(dp->nodes, 0);
+            sfwrite(dp->nodes, fp->fornam, n - 1);
         } else {
-            sfwrite(outfile, arg->argval, n);
+            sfwrite(dp->nodes, arg->argval, n);
         }
-        sfputc(outfile, arg->argflag);
+        sfputc(dp->nodes, arg->argflag);
         if (fp) {
-            sfputu(outfile, fp->fortyp);
-            dump_p_tree(fp->fortre);
-        } else if (n == 0 && (arg->argflag & ARG_EXP) && arg->argchn.ap) {
-            dump_p_tree((Shnode_t *)arg->argchn.ap);
+            sfputu(dp->nodes, fp->fortyp);
+            td_tree(dp, fp->fortre);
+        } else if (!n && (arg->argflag & ARG_EXP)) {
+            td_tree(dp, (Shnode_t *)arg->argchn.ap);
         }
-        arg = arg->argnxt.ap;
     }
-    return sfputu(outfile, 0);
+    sfputu(dp->nodes, 0);
 }
 
-static_fn int dump_p_redirect(const struct ionod *iop) {
-    while (iop) {
-        if (iop->iovname) {
-            sfputl(outfile, iop->iofile | IOVNM);
+static_fn void td_redirect(struct tdump *dp, const struct ionod *iop) {
+    for (; iop; iop = iop->ionxt) {
+        sfputl(dp->nodes, iop->iofile);
+        // The name of a process substitution is the tree that produces it.
+        if ((iop->iofile & (IOPROCSUB | IOLSEEK)) == IOPROCSUB) {
+            td_tree(dp, (Shnode_t *)iop->ioname);
         } else {
-            sfputl(outfile, iop->iofile);
+            td_string(dp, iop->ioname);
         }
-        dump_p_string(iop->ioname);
+        td_string(dp, iop->iovname);
+        td_string(dp, iop->iodelim);
         if (iop->iodelim) {
-            dump_p_string(iop->iodelim);
-            sfputl(outfile, iop->iosize);
-            sfseek(sh.heredocs, iop->iooffset, SEEK_SET);
-            sfmove(sh.heredocs, outfile, iop->iosize, -1);
-        } else {
-            sfputu(outfile, 0);
+            sfputl(dp->nodes, iop->iosize);
+            sfputl(dp->nodes, sfstrtell(dp->docs));
+            if (iop->iosize > 0) {
+                sfseek(sh.heredocs, iop->iooffset, SEEK_SET);
+                if (sfmove(sh.heredocs, dp->docs, iop->iosize, -1) != iop->iosize) dp->failed = true;
+            }
         }
-        if (iop->iovname) dump_p_string(iop->iovname);
-        iop = iop->ionxt;
     }
-    return sfputl(outfile, -1);
+    sfputl(dp->nodes, -1);
 }
 
-static_fn int dump_p_comarg(const struct comnod *com) {
-    dump_p_redirect(com->comio);
-    dump_p_arg(com->comset);
-    if (!com->comarg) {
-        sfputl(outfile, -1);
-    } else if (com->comtyp & COMSCAN) {
-        dump_p_arg(com->comarg);
-    } else {
-        dump_p_comlist((struct dolnod *)com->comarg);
-    }
-    return sfputu(outfile, com->comline);
-}
-
-static_fn int dump_p_comlist(const struct dolnod *dol) {
+static_fn void td_comlist(struct tdump *dp, const struct dolnod *dol) {
     char *const *argv;
-    int n;
-
-    argv = dol->dolval + ARG_SPARE;
-    while (*argv) argv++;
-    n = argv - (dol->dolval + 1);
-    sfputl(outfile, n);
 
-    argv = dol->dolval + ARG_SPARE;
-    while (*argv) dump_p_string(*argv++);
-
-    return sfputu(outfile, 0);
+    if (!dol) {
+        sfputu(dp->nodes, 0);
+        return;
+    }
+    for (argv = dol->dolval + ARG_SPARE; *argv; argv++) {
+        ;  // empty loop
+    }
+    sfputu(dp->nodes, argv - (dol->dolval + ARG_SPARE));
+    for (argv = dol->dolval + ARG_SPARE; *argv; argv++) td_string(dp, *argv);
 }
 
-static_fn int dump_p_switch(const struct regnod *reg) {
-    while (reg) {
-        sfputl(outfile, reg->regflag);
-        dump_p_arg(reg->regptr);
-        dump_p_tree(reg->regcom);
-        reg = reg->regnxt;
+static_fn void td_switch(struct tdump *dp, const struct regnod *reg) {
+    for (; reg; reg = reg->regnxt) {
+        sfputl(dp->nodes, reg->regflag);
+        td_arg(dp, reg->regptr);
+        td_tree(dp, reg->regcom);
     }
-    return sfputl(outfile, -1);
+    sfputl(dp->nodes, -1);
 }
 
-static_fn int dump_p_string(const char *string) {
-    size_t n = strlen(string);
-    if (sfputu(outfile, n + 1) < 0) return -1;
-    return sfwrite(outfile, string, n);
+//
+// Add tree <t> to the image.
+//
+static_fn void td_tree(struct tdump *dp, const Shnode_t *t) {
+    Shnode_t *body = NULL;
+    int type;
+
+    if (!t) {
+        sfputl(dp->nodes, -1);
+        return;
+    }
+    type = t->tre.tretyp;
+    if ((type & COMMSK) == TFUN) {
+        body = t->funct.functtre;
+        if (type & FLAZY) {
+            int flags;
+            body = sh_funparse(sh_getinterp(), t->funct.functstak, &flags);
+            type = (type & ~FLAZY) | flags;
+        }
+    }
+    sfputl(dp->nodes, type);
+    switch (type & COMMSK) {
+        case TTIME:
+        case TPAR: {
+            td_tree(dp, t->par.partre);
+            break;
+        }
+        case TCOM: {
+            td_redirect(dp, t->com.comio);
+            td_arg(dp, t->com.comset);
+            if (type & COMSCAN) {
+                td_arg(dp, t->com.comarg);
+            } else {
+                td_comlist(dp, (struct dolnod *)t->com.comarg);
+            }
+            sfputu(dp->nodes, t->com.comline);
+            break;
+        }
+        case TSETIO:
+        case TFORK: {
+            sfputu(dp->nodes, t->fork.forkline);
+            td_tree(dp, t->fork.forktre);
+            td_redirect(dp, t->fork.forkio);
+            break;
+        }
+        case TIF: {
+            td_tree(dp, t->if_.iftre);
+            td_tree(dp, t->if_.thtre);
+            td_tree(dp, t->if_.eltre);
+            break;
+        }
+        case TWH: {
+            td_tree(dp, (Shnode_t *)t->wh.whinc);
+            td_tree(dp, t->wh.whtre);
+            td_tree(dp, t->wh.dotre);
+            break;
+        }
+        case TLST:
+        case TAND:
+        case TORF:
+        case TFIL: {
+            td_tree(dp, t->lst.lstlef);
+            td_tree(dp, t->lst.lstrit);
+            break;
+        }
+        case TARITH: {
+            sfputu(dp->nodes, t->ar.arline);
+            td_arg(dp, t->ar.arexpr);
+            break;
+        }
+        case TFOR: {
+            sfputu(dp->nodes, t->for_.forline);
+            td_string(dp, t->for_.fornam);
+            td_tree(dp, t->for_.fortre);
+            td_tree(dp, (Shnode_t *)t->for_.forlst);
+            break;
+        }
+        case TSW: {
+            sfputu(dp->nodes, t->sw.swline);
+            td_arg(dp, t->sw.swarg);
+            td_redirect(dp, t->sw.swio);
+            td_switch(dp, t->sw.swlst);
+            break;
+        }
+        case TFUN: {
+            sfputu(dp->nodes, t->funct.functline);
+            td_string(dp, t->funct.functnam);
+            // Where the text of the function is in the file it was read from, and the line of the
+            // file where the function starts.
+            if (dp->source && !(type & FPIN) && t->funct.functstak && t->funct.functloc >= 0) {
+                sfputl(dp->nodes, t->funct.functloc);
+                sfputu(dp->nodes, ((struct functnod *)(t->funct.functstak + 1))->functline);
+            } else {
+                sfputl(dp->nodes, -1);
+                sfputu(dp->nodes, 0);
+            }
+            td_tree(dp, body);
+            td_tree(dp, (Shnode_t *)t->funct.functargs);
+            break;
+        }
+        case TTST: {
+            sfputu(dp->nodes, t->tst.tstline);
+            if ((type & TPAREN) == TPAREN) {
+                td_tree(dp, t->lst.lstlef);
+                break;
+            }
+            td_arg(dp, &t->lst.lstlef->arg);
+            if (type & TBINARY) td_arg(dp, &t->lst.lstrit->arg);
+            break;
+        }
+        default: {
+            dp->failed = true;
+            break;
+        }
+    }
 }
@@ -26,11 +26,16 @@
 #include "config_ast.h"  // IWYU pragma: keep
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 
 #include "argnod.h"
 #include "defs.h"
+#include "lexstates.h"
 #include "name.h"
 #include "sfio.h"
 #include "shnodes.h"
@@ -43,6 +48,7 @@ static_fn struct regnod *r_switch(Shell_t *);
 static_fn Shnode_t *r_tree(Shell_t *);
 static_fn char *r_string(Stk_t *);
 static_fn void r_comarg(Shell_t *, struct comnod *);
+static_fn void *t_comname(Shell_t *, const char *);
 
 static Sfio_t *infile;
 
@@ -164,6 +170,8 @@ static_fn Shnode_t *r_tree(Shell_t *shp) {
             t->funct.functargs = (struct comnod *)r_tree(shp);
             slp->slptr = stkinstall(savstk, 0);
             slp->slchild = shp->st.staklist;
+            // As in the parser, the stack list owns the function stack until the tree is freed.
+            shp->st.staklist = slp;
             break;
         }
         case TTST: {
@@ -288,17 +296,25 @@ static_fn void r_comarg(Shell_t *shp, struct comnod *com) {
     }
     com->comline = sfgetu(infile);
     com->comnamq = NULL;
-    if (cmdname) {
-        char *cp;
-        com->comnamp = nv_search(cmdname, shp->fun_tree, 0);
-        if (com->comnamp && (cp = strrchr(cmdname + 1, '.'))) {
-            *cp = 0;
-            com->comnamp = nv_open(cmdname, shp->var_tree, NV_VARNAME | NV_NOADD | NV_NOARRAY);
-            *cp = '.';
-        }
-    } else {
-        com->comnamp = NULL;
+    com->comnamp = cmdname ? t_comname(shp, cmdname) : NULL;
+}
+
+//
+// Return the node that the parser would have cached for command <cmdname>.
+//
+static_fn void *t_comname(Shell_t *shp, const char *cmdname) {
+    Namval_t *np = nv_search(cmdname, shp->fun_tree, 0);
+    const char *cp;
+    int offset;
+
+    if (np && (cp = strrchr(cmdname + 1, '.'))) {
+        offset = stktell(shp->stk);
+        sfwrite(shp->stk, cmdname, cp - cmdname);
+        sfputc(shp->stk, 0);
+        np = nv_open(stkptr(shp->stk, offset), shp->var_tree, NV_VARNAME | NV_NOADD | NV_NOARRAY);
+        stkseek(shp->stk, offset);
     }
+    return np;
 }
 
 static_fn struct dolnod *r_comlist(Shell_t *shp) {
@@ -353,3 +369,523 @@ static_fn char *r_string(Stk_t *stkp) {
     ptr[l] = 0;
     return ptr;
 }
+
+//
+// Binary scripts of version 4 hold an image of their trees, see tdump.c. The nodes are built from
+// the image in memory of their own, since the shell caches state in them while they are executed.
+// Where possible the image is mapped rather than read, so that its string table stays in the page
+// cache and is shared by all the shells that run the script, and the strings in the nodes are used
+// where they are in it. Only a page that the shell writes to, as nv_open() does while it looks up
+// the name in an alias assignment, becomes private. Every value read from the image is checked
+// before it is used and a corrupt image is rejected with an error.
+//
+// The image stays in use while any function that it defines exists. Every stack list entry in
+// the image refers to a stack that only counts those references and that releases the image when
+// it is closed for the last time. The image is not released right away since a child that is
+// about to exec a command frees its stacks first while the arguments still point into the image,
+// so released images are kept until the next one is used.
+//
+// When a script is run the top level trees are built one at a time just before they are executed,
+// as they would be parsed, so that the names of the commands in them are looked up after the
+// commands before them have defined any functions and types.
+//
+struct tmap {
+    Sfdisc_t disc;
+    struct tmap *next;  // next released image
+    struct slnod top;   // stack list entry for the image while it is in use
+    char *addr;         // mapping of the script or copy of its image
+    size_t size;        // size of the mapping or zero for a copy
+    Sfio_t *nodes;      // the nodes that are still to be built
+    Stk_t *mem;         // memory for the nodes
+    char *strings;      // start of the string table
+    size_t nstrings;    // size of the string table
+    size_t ndocs;       // size of the here-documents
+    Sfio_t *stk;        // reference counts of the image
+    Sfoff_t docs;       // offset of the here-documents in shp->heredocs
+    char *filename;     // file that the image was read from
+    Sfio_t *in;         // script whose trees are used one at a time
+    uint64_t ntrees;    // number of top level trees
+    uint64_t ntree;     // next tree to use
+};
+
+static Sfio_t *mapnodes;      // the nodes that are still to be built
+static Stk_t *mapmem;         // memory for the nodes
+static char *mapstrings;      // start of the string table
+static size_t mapnstrings;    // size of the string table
+static Sfoff_t mapdocs;       // offset of the here-documents in shp->heredocs
+static size_t mapndocs;       // size of the here-documents
+static Sfio_t *mapstk;        // reference counts of the image
+static char *mapfilename;     // file that the image was read from
+static struct tmap *mapfree;  // images that are no longer in use
+static struct tmap *mapnext;  // image of the script that is being run
+
+static_fn Shnode_t *m_tree(Shell_t *);
+
+static_fn int m_except(Sfio_t *sp, int type, void *data, Sfdisc_t *disc) {
+    struct tmap *mp = (struct tmap *)disc;
+    UNUSED(sp);
+    UNUSED(data);
+
+    if (type == SF_FINAL) {
+        mp->next = mapfree;
+        mapfree = mp;
+    }
+    return 0;
+}
+
+static_fn void m_release(void) {
+    struct tmap *mp;
+
+    while ((mp = mapfree)) {
+        mapfree = mp->next;
+        if (mp->nodes) sfclose(mp->nodes);
+        if (mp->mem) stkclose(mp->mem);
+        if (mp->size) {
+            munmap(mp->addr, mp->size);
+        } else {
+            free(mp->addr);
+        }
+        free(mp);
+    }
+}
+
+static_fn void m_use(struct tmap *mp) {
+    mapnodes = mp->nodes;
+    mapmem = mp->mem;
+    mapstrings = mp->strings;
+    mapnstrings = mp->nstrings;
+    mapdocs = mp->docs;
+    mapndocs = mp->ndocs;
+    mapstk = mp->stk;
+    mapfilename = mp->filename;
+}
+
+static_fn void m_corrupt(void) {
+    errormsg(SH_DICT, ERROR_exit(1), e_lexversion, TD_VERSION);
+    __builtin_unreachable();
+}
+
+//
+// Give up on image <mp> before it is used, because it is corrupt or for lack of <nospace>.
+//
+static_fn void m_reject(struct tmap *mp, bool nospace) {
+    mp->next = mapfree;
+    mapfree = mp;
+    if (nospace) errormsg(SH_DICT, ERROR_system(1), e_nospace);
+    m_corrupt();
+}
+
+static_fn Sfulong_t m_getu(void) {
+    Sfulong_t u = sfgetu(mapnodes);
+
+    if (sferror(mapnodes)) m_corrupt();
+    return u;
+}
+
+static_fn Sflong_t m_getl(void) {
+    Sflong_t l = sfgetl(mapnodes);
+
+    if (sferror(mapnodes)) m_corrupt();
+    return l;
+}
+
+//
+// Return the number of bytes of the nodes that are left.
+//
+static_fn Sfulong_t m_left(void) { return sfsize(mapnodes) - sftell(mapnodes); }
+
+//
+// Return <size> bytes of zeroed memory for a node.
+//
+static_fn void *m_alloc(size_t size) { return memset(stkalloc(mapmem, size), 0, size); }
+
+static_fn char *m_string(void) {
+    Sfulong_t off = m_getu();
+
+    if (!off) return NULL;
+    if (off > mapnstrings) m_corrupt();
+    return mapstrings + off - 1;
+}
+
+//
+// Use the image that follows the version 4 header when sh_parse() has read the first six bytes of
+// the header from <in>. Unless <flag> asks for all of them, only the first top level tree is
+// returned and sh_tnext() returns the others.
+//
+Shnode_t *sh_tmap(Shell_t *shp, Sfio_t *in, int flag) {
+    struct tdimage head;
+    struct tmap *mp;
+    struct stat statb;
+    struct lstnod *lp;
+    Shnode_t *t = NULL, *tp;
+    Sfoff_t off;
+    char *image = NULL;
+    char pad[TD_ALIGN - 6];
+    size_t size = 0, n;
+    int fd = sffileno(in);
+
+    m_release();
+    if (sfread(in, pad, sizeof(pad)) != sizeof(pad) || (off = sftell(in)) < 0 ||
+        sfread(in, &head, sizeof(head)) != sizeof(head) || head.order != TD_ORDER ||
+        head.size > SIZE_MAX / 2 || head.docs > head.size || head.strings > head.docs ||
+        head.strings < sizeof(head) || head.ntrees > head.strings - sizeof(head)) {
+        errormsg(SH_DICT, ERROR_exit(1), e_lexversion, TD_VERSION);
+        __builtin_unreachable();
+    }
+    if (!(mp = calloc(1, sizeof(struct tmap)))) {
+        errormsg(SH_DICT, ERROR_system(1), e_nospace);
+        __builtin_unreachable();
+    }
+    if (fd >= 0 && fstat(fd, &statb) >= 0 && S_ISREG(statb.st_mode) &&
+        off + head.size <= statb.st_size) {
+        size = off + head.size;
+        mp->addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (mp->addr == MAP_FAILED) {
+            mp->addr = NULL;
+        } else if (memcmp(mp->addr + off, &head, sizeof(head)) != 0 ||
+                   sfseek(in, off + head.size, SEEK_SET) != off + (Sfoff_t)head.size) {
+            munmap(mp->addr, size);
+            mp->addr = NULL;
+        } else {
+            mp->size = size;
+            image = mp->addr + off;
+        }
+    }
+    if (!image) {
+        if (!(image = mp->addr = malloc(head.size))) m_reject(mp, true);
+        memcpy(image, &head, sizeof(head));
+        n = head.size - sizeof(head);
+        if (sfread(in, image + sizeof(head), n) != n) m_reject(mp, false);
+    }
+    mp->strings = image + head.strings;
+    mp->nstrings = head.docs - head.strings;
+    mp->ndocs = head.size - head.docs;
+    if (mp->nstrings && mp->strings[mp->nstrings - 1]) m_reject(mp, false);
+    mp->nodes = sfnew(NULL, image + sizeof(head), head.strings - sizeof(head), -1,
+                      SF_STRING | SF_READ);
+    if (!mp->nodes || !(mp->mem = stkopen(STK_SMALL)) || !(mp->stk = stkopen(STK_SMALL))) {
+        m_reject(mp, true);
+    }
+    mp->disc.exceptf = m_except;
+    mp->filename = shp->st.filename ? stkcopy(mp->stk, shp->st.filename) : NULL;
+    mp->ntrees = head.ntrees;
+    sfdisc(mp->stk, &mp->disc);
+    if (mp->ndocs) {
+        if (shp->heredocs) {
+            mp->docs = sfseek(shp->heredocs, (Sfoff_t)0, SEEK_END);
+        } else {
+            shp->heredocs = sftmp(512);
+        }
+        sfwrite(shp->heredocs, mp->strings + mp->nstrings, mp->ndocs);
+    }
+    mp->top.slptr = mp->stk;
+    mp->top.slnext = shp->st.staklist;
+    shp->st.staklist = &mp->top;
+    m_use(mp);
+
+    if (!(flag & (SH_NL | SH_FUNEVAL))) {
+        // The script holds its own reference until its last tree has been run.
+        if (mapnext) {
+            stkclose(mapnext->stk);
+            mapnext = NULL;
+        }
+        mp->in = in;
+        stklink(mp->stk);
+        mapnext = mp;
+        return sh_tnext(shp, in);
+    }
+    for (n = 0; n < mp->ntrees; n++) {
+        if (!(tp = m_tree(shp))) m_corrupt();
+        if (t) {
+            lp = stkalloc(mp->mem, sizeof(struct lstnod));
+            lp->lsttyp = TLST;
+            lp->lstlef = t;
+            lp->lstrit = tp;
+            tp = (Shnode_t *)lp;
+        }
+        t = tp;
+    }
+    return t;
+}
+
+//
+// Forget the image of the script being run. A shell forked to run another script by name may get
+// a stream at the same address for it, which must not be mistaken for the image.
+//
+void sh_tforget(void) { mapnext = NULL; }
+
+//
+// Return true if the script <in> has top level trees left.
+//
+bool sh_tmore(Sfio_t *in) { return mapnext && mapnext->in == in && mapnext->ntree < mapnext->ntrees; }
+
+//
+// Return the next top level tree of the script <in>, if any.
+//
+Shnode_t *sh_tnext(Shell_t *shp, Sfio_t *in) {
+    struct tmap *mp = mapnext;
+    Shnode_t *t;
+
+    if (mp && mp->in == in) {
+        if (mp->ntree < mp->ntrees) {
+            m_use(mp);
+            mp->ntree++;
+            if (!(t = m_tree(shp))) m_corrupt();
+            return t;
+        }
+        mapnext = NULL;
+        stkclose(mp->stk);
+    }
+    // The image held every command so anything after it is data.
+    if (sfseek(in, (Sfoff_t)0, SEEK_END) < 0) sfmove(in, NULL, SF_UNBOUND, -1);
+    return NULL;
+}
+
+static_fn struct argnod *m_arg(Shell_t *shp) {
+    struct argnod *ap, *arg = NULL, *last = NULL;
+    struct fornod *fp;
+    Sfulong_t l;
+    int c;
+
+    while ((l = m_getu()) > 0) {
+        if (l > m_left()) m_corrupt();
+        // One more byte for the name of a compound assignment after an empty value.
+        ap = m_alloc(ARGVAL + l + 1);
+        if (sfread(mapnodes, ap->argval, l - 1) != l - 1 || (c = sfgetc(mapnodes)) < 0) {
+            m_corrupt();
+        }
+        ap->argflag = c;
+        if (*ap->argval == 0 && (ap->argflag & ARG_EXP)) {
+            ap->argchn.ap = (struct argnod *)m_tree(shp);
+        } else if (*ap->argval == 0 &&
+                   (ap->argflag & ~(ARG_APPEND | ARG_MESSAGE | ARG_QUOTED | ARG_ARRAY)) == 0) {
+            fp = m_alloc(sizeof(struct fornod));
+            fp->fortyp = m_getu();
+            fp->fortre = m_tree(shp);
+            fp->fornam = ap->argval + 1;
+            ap->argchn.ap = (struct argnod *)fp;
+        }
+        if (last) {
+            last->argnxt.ap = ap;
+        } else {
+            arg = ap;
+        }
+        last = ap;
+    }
+    return arg;
+}
+
+static_fn struct ionod *m_redirect(Shell_t *shp) {
+    struct ionod *iop, *io = NULL, *last = NULL;
+    Sflong_t l;
+
+    while ((l = m_getl()) >= 0) {
+        iop = m_alloc(sizeof(struct ionod));
+        iop->iofile = l;
+        if ((iop->iofile & (IOPROCSUB | IOLSEEK)) == IOPROCSUB) {
+            iop->ioname = (char *)m_tree(shp);
+        } else {
+            iop->ioname = m_string();
+        }
+        iop->iovname = m_string();
+        iop->iodelim = m_string();
+        if (iop->iodelim) {
+            iop->iosize = m_getl();
+            iop->iooffset = m_getl();
+            if (iop->iooffset < 0 || iop->iosize < 0 || (uintmax_t)iop->iooffset > mapndocs ||
+                (uintmax_t)iop->iosize > mapndocs - iop->iooffset) {
+                m_corrupt();
+            }
+            iop->iooffset += mapdocs;
+        }
+        if (last) {
+            last->ionxt = iop;
+        } else {
+            io = iop;
+        }
+        last = iop;
+    }
+    return io;
+}
+
+static_fn struct dolnod *m_comlist(void) {
+    struct dolnod *dol;
+    Sfulong_t l = m_getu();
+    int n;
+
+    if (l == 0) return NULL;
+    if (l > m_left()) m_corrupt();
+    dol = m_alloc(sizeof(struct dolnod) + sizeof(char *) * (l + ARG_SPARE));
+    dol->dolnum = l + ARG_SPARE - 1;
+    dol->dolbot = ARG_SPARE;
+    for (n = ARG_SPARE; n <= dol->dolnum; n++) {
+        if (!(dol->dolval[n] = m_string())) m_corrupt();
+    }
+    return dol;
+}
+
+static_fn void m_comarg(Shell_t *shp, struct comnod *com) {
+    struct dolnod *dol;
+    char *cmdname = NULL;
+
+    com->comio = m_redirect(shp);
+    com->comset = m_arg(shp);
+    if (com->comtyp & COMSCAN) {
+        com->comarg = m_arg(shp);
+        if (com->comarg && com->comarg->argflag == ARG_RAW) cmdname = com->comarg->argval;
+    } else if ((dol = m_comlist())) {
+        com->comarg = (struct argnod *)dol;
+        cmdname = dol->dolval[ARG_SPARE];
+    }
+    com->comline = m_getu();
+    com->comnamp = cmdname ? t_comname(shp, cmdname) : NULL;
+}
+
+static_fn struct regnod *m_switch(Shell_t *shp) {
+    struct regnod *rp, *reg = NULL, *last = NULL;
+    Sflong_t l;
+
+    while ((l = m_getl()) >= 0) {
+        rp = m_alloc(sizeof(struct regnod));
+        rp->regflag = l;
+        rp->regptr = m_arg(shp);
+        rp->regcom = m_tree(shp);
+        if (last) {
+            last->regnxt = rp;
+        } else {
+            reg = rp;
+        }
+        last = rp;
+    }
+    return reg;
+}
+
+//
+// Build the next tree of the image.
+//
+static_fn Shnode_t *m_tree(Shell_t *shp) {
+    Sflong_t l = m_getl();
+    struct slnod *slp = NULL;
+    struct functnod *fp;
+    Shnode_t *t;
+    int type;
+
+    if (l < 0) return NULL;
+    type = l;
+    switch (type & COMMSK) {
+        case TTIME:
+        case TPAR: {
+            t = m_alloc(sizeof(struct parnod));
+            t->par.partre = m_tree(shp);
+            break;
+        }
+        case TCOM: {
+            t = m_alloc(sizeof(struct comnod));
+            t->tre.tretyp = type;
+            m_comarg(shp, (struct comnod *)t);
+            break;
+        }
+        case TSETIO:
+        case TFORK: {
+            t = m_alloc(sizeof(struct forknod));
+            t->fork.forkline = m_getu();
+            t->fork.forktre = m_tree(shp);
+            t->fork.forkio = m_redirect(shp);
+            break;
+        }
+        case TIF: {
+            t = m_alloc(sizeof(struct ifnod));
+            t->if_.iftre = m_tree(shp);
+            t->if_.thtre = m_tree(shp);
+            t->if_.eltre = m_tree(shp);
+            break;
+        }
+        case TWH: {
+            t = m_alloc(sizeof(struct whnod));
+            t->wh.whinc = (struct arithnod *)m_tree(shp);
+            t->wh.whtre = m_tree(shp);
+            t->wh.dotre = m_tree(shp);
+            break;
+        }
+        case TLST:
+        case TAND:
+        case TORF:
+        case TFIL: {
+            t = m_alloc(sizeof(struct lstnod));
+            t->lst.lstlef = m_tree(shp);
+            t->lst.lstrit = m_tree(shp);
+            break;
+        }
+        case TARITH: {
+            t = m_alloc(sizeof(struct arithnod));
+            t->ar.arline = m_getu();
+            t->ar.arexpr = m_arg(shp);
+            if (t->ar.arexpr && (t->ar.arexpr->argflag & ARG_RAW)) {
+                // The compiled expression must last as long as the nodes.
+                Sfio_t *savstk = stkinstall(mapmem, 0);
+                t->ar.arcomp = sh_arithcomp(shp, t->ar.arexpr->argval);
+                stkinstall(savstk, 0);
+            }
+            break;
+        }
+        case TFOR: {
+            t = m_alloc(sizeof(struct fornod));
+            t->for_.forline = m_getu();
+            t->for_.fornam = m_string();
+            t->for_.fortre = m_tree(shp);
+            t->for_.forlst = (struct comnod *)m_tree(shp);
+            break;
+        }
+        case TSW: {
+            t = m_alloc(sizeof(struct swnod));
+            t->sw.swline = m_getu();
+            t->sw.swarg = m_arg(shp);
+            t->sw.swio = m_redirect(shp);
+            t->sw.swlst = m_switch(shp);
+            break;
+        }
+        case TFUN: {
+            t = m_alloc(sizeof(struct functnod));
+            t->funct.functline = m_getu();
+            t->funct.functnam = m_string();
+            t->funct.functloc = m_getl();
+            l = m_getu();
+            if (type != TNSPACE) {
+                // The stack list entry and the node naming the file of the function.
+                slp = m_alloc(sizeof(struct slnod) + sizeof(struct functnod));
+                fp = (struct functnod *)(slp + 1);
+                fp->functtyp = TFUN | FAMP;
+                fp->functnam = mapfilename;
+                fp->functline = l;
+                slp->slptr = mapstk;
+                stklink(mapstk);
+                slp->slnext = shp->st.staklist;
+                shp->st.staklist = NULL;
+                t->funct.functstak = slp;
+            }
+            t->funct.functtre = m_tree(shp);
+            t->funct.functargs = (struct comnod *)m_tree(shp);
+            if (slp) {
+                slp->slchild = shp->st.staklist;
+                shp->st.staklist = slp;
+            }
+            break;
+        }
+        case TTST: {
+            t = m_alloc(sizeof(struct tstnod));
+            t->tst.tstline = m_getu();
+            if ((type & TPAREN) == TPAREN) {
+                t->lst.lstlef = m_tree(shp);
+            } else {
+                t->lst.lstlef = (Shnode_t *)m_arg(shp);
+                if (type & TBINARY) t->lst.lstrit = (Shnode_t *)m_arg(shp);
+            }
+            break;
+        }
+        default: {
+            m_corrupt();
+        }
+    }
+    t->tre.tretyp = type;
+    return t;
+}
@@ -61,6 +61,7 @@
 #include "name.h"
 #include "option.h"
 #include "path.h"
+#include "probe.h"
 #include "sfio.h"
 #include "shcmd.h"
 #include "shnodes.h"
@@ -84,6 +85,8 @@
 extern int nice(int);
 #if USE_SPAWN
 static_fn pid_t sh_ntfork(Shell_t *, const Shnode_t *, char *[], int *, int);
+#else   // USE_SPAWN
+static_fn pid_t sh_fastfork(Shell_t *, const Shnode_t *, char *[], int, int *);
 #endif  // USE_SPAWN
 
 static_fn void sh_funct(Shell_t *, Namval_t *, int, char *[], struct argnod *, int);
@@ -130,23 +133,46 @@ static_fn void fifo_check(void *handle) {
 }
 #endif  // !has_dev_fd
 
+//
+// What the `time` keyword and KSH_XTRACEFORMAT report about a command. The counters cover the shell
+// and the children it has reaped, like the CPU times.
+//
+struct tmsample {
+    struct timeval real;
+    struct timeval usr;
+    struct timeval sys;
+    long maxrss;   // largest resident set size of a child in kilobytes
+    long minflt;   // page faults served without I/O
+    long majflt;   // page faults that needed I/O
+    long inblock;  // blocks read by the file systems
+    long oublock;  // blocks written by the file systems
+    long nvcsw;    // voluntary context switches
+    long nivcsw;   // involuntary context switches
+};
+
 #if _lib_getrusage
 
 // Use getrusage() rather than times() since the former typically has higher resolution.
 #include <sys/resource.h>
 
-static_fn void get_cpu_times(struct timeval *tv_usr, struct timeval *tv_sys) {
+static_fn void get_cpu_times(struct tmsample *tp) {
     struct rusage usage_self, usage_child;
 
     getrusage(RUSAGE_SELF, &usage_self);
     getrusage(RUSAGE_CHILDREN, &usage_child);
-    timeradd(&usage_self.ru_utime, &usage_child.ru_utime, tv_usr);
-    timeradd(&usage_self.ru_stime, &usage_child.ru_stime, tv_sys);
+    timeradd(&usage_self.ru_utime, &usage_child.ru_utime, &tp->usr);
+    timeradd(&usage_self.ru_stime, &usage_child.ru_stime, &tp->sys);
+    tp->minflt = usage_self.ru_minflt + usage_child.ru_minflt;
+    tp->majflt = usage_self.ru_majflt + usage_child.ru_majflt;
+    tp->inblock = usage_self.ru_inblock + usage_child.ru_inblock;
+    tp->oublock = usage_self.ru_oublock + usage_child.ru_oublock;
+    tp->nvcsw = usage_self.ru_nvcsw + usage_child.ru_nvcsw;
+    tp->nivcsw = usage_self.ru_nivcsw + usage_child.ru_nivcsw;
 }
 
 #else  // _lib_getrusage
 
-static_fn void get_cpu_times(struct timeval *tv_usr, struct timeval *tv_sys) {
+static_fn void get_cpu_times(struct tmsample *tp) {
     struct timeval tv1, tv2;
     double dtime;
     long clk_tck = sysconf(_SC_CLK_TCK);
@@ -159,7 +185,7 @@ static_fn void get_cpu_times(struct timeval *tv_usr, struct timeval *tv_sys) {
     dtime = (double)cpu_times.tms_cutime / clk_tck;
     tv2.tv_sec = dtime / 60;
     tv2.tv_usec = 1000000 * (dtime - tv2.tv_sec);
-    timeradd(&tv1, &tv2, tv_usr);
+    timeradd(&tv1, &tv2, &tp->usr);
 
     dtime = (double)cpu_times.tms_stime / clk_tck;
     tv1.tv_sec = dtime / 60;
@@ -167,11 +193,43 @@ static_fn void get_cpu_times(struct timeval *tv_usr, struct timeval *tv_sys) {
     dtime = (double)cpu_times.tms_cstime / clk_tck;
     tv2.tv_sec = dtime / 60;
     tv2.tv_usec = 1000000 * (dtime - tv2.tv_sec);
-    timeradd(&tv1, &tv2, tv_sys);
+    timeradd(&tv1, &tv2, &tp->sys);
+    tp->minflt = tp->majflt = tp->inblock = tp->oublock = tp->nvcsw = tp->nivcsw = 0;
 }
 
 #endif  // _lib_getrusage
 
+//
+// Start measuring a command. The largest resident set of the children reaped until tm_stop() is
+// kept apart from that of the children reaped before.
+//
+static_fn void tm_start(struct tmsample *tp) {
+    gettimeofday(&tp->real, NULL);
+    get_cpu_times(tp);
+    tp->maxrss = job.maxrss;
+    job.maxrss = 0;
+}
+
+// Turn the sample taken by tm_start() into what the command used since.
+static_fn void tm_stop(struct tmsample *tp) {
+    struct tmsample after;
+
+    get_cpu_times(&after);
+    gettimeofday(&after.real, NULL);
+    timersub(&after.real, &tp->real, &tp->real);
+    timersub(&after.usr, &tp->usr, &tp->usr);
+    timersub(&after.sys, &tp->sys, &tp->sys);
+    tp->minflt = after.minflt - tp->minflt;
+    tp->majflt = after.majflt - tp->majflt;
+    tp->inblock = after.inblock - tp->inblock;
+    tp->oublock = after.oublock - tp->oublock;
+    tp->nvcsw = after.nvcsw - tp->nvcsw;
+    tp->nivcsw = after.nivcsw - tp->nivcsw;
+    after.maxrss = job.maxrss;
+    if (tp->maxrss > job.maxrss) job.maxrss = tp->maxrss;
+    tp->maxrss = after.maxrss;
+}
+
 static_fn struct timeval clock_t_delta(int clk_tck, clock_t after, clock_t before) {
     struct timeval tv_after, tv_before, tv;
 
@@ -294,7 +352,7 @@ done:
 //
 // Print time <t> in h:m:s format with precision <p>.
 //
-static_fn void l_time(Sfio_t *outfile, struct timeval *tv, int precision) {
+static_fn void l_time(Sfio_t *outfile, const struct timeval *tv, int precision) {
     int hr = tv->tv_sec / (60 * 60);
     int min = (tv->tv_sec / 60) % 60;
     int sec = tv->tv_sec % 60;
@@ -311,15 +369,12 @@ static_fn void l_time(Sfio_t *outfile, struct timeval *tv, int precision) {
     }
 }
 
-#define TM_REAL_IDX 0
-#define TM_USR_IDX 1
-#define TM_SYS_IDX 2
-
-static_fn void p_time(Shell_t *shp, Sfio_t *out, const char *format, struct timeval tm[3]) {
+static_fn void p_time(Shell_t *shp, Sfio_t *out, const char *format, const struct tmsample *tp) {
     int c, n, offset = stktell(shp->stk);
     const char *first;
     struct timeval tv_cpu_sum;
-    struct timeval *tvp;
+    const struct timeval *tvp;
+    const long *lp;
     Stk_t *stkp = shp->stk;
 
     for (first = format; *format; format++) {
@@ -347,9 +402,9 @@ static_fn void p_time(Shell_t *shp, Sfio_t *out, const char *format, struct time
         }
 
         if (c == 'P') {
-            struct timeval tv_real = tm[TM_REAL_IDX];
+            struct timeval tv_real = tp->real;
             struct timeval tv_cpu;
-            timeradd(&tm[TM_USR_IDX], &tm[TM_SYS_IDX], &tv_cpu);
+            timeradd(&tp->usr, &tp->sys, &tv_cpu);
 
             double d = timeval_to_double(tv_real);
             if (d) d = 100.0 * timeval_to_double(tv_cpu) / d;
@@ -358,19 +413,42 @@ static_fn void p_time(Shell_t *shp, Sfio_t *out, const char *format, struct time
             continue;
         }
 
+        // The resource counters are whole numbers.
+        lp = NULL;
+        if (c == 'M') {
+            lp = &tp->maxrss;
+        } else if (c == 'F') {
+            lp = &tp->majflt;
+        } else if (c == 'f') {
+            lp = &tp->minflt;
+        } else if (c == 'I') {
+            lp = &tp->inblock;
+        } else if (c == 'O') {
+            lp = &tp->oublock;
+        } else if (c == 'w') {
+            lp = &tp->nvcsw;
+        } else if (c == 'c') {
+            lp = &tp->nivcsw;
+        }
+        if (lp) {
+            sfprintf(stkp, "%ld", *lp);
+            first = format + 1;
+            continue;
+        }
+
         if (c == 'l') {
             l_modifier = true;
             c = *++format;
         }
 
         if (c == 'R') {
-            tvp = &tm[TM_REAL_IDX];
+            tvp = &tp->real;
         } else if (c == 'U') {
-            tvp = &tm[TM_USR_IDX];
+            tvp = &tp->usr;
         } else if (c == 'S') {
-            tvp = &tm[TM_SYS_IDX];
+            tvp = &tp->sys;
         } else if (c == 'C') {
-            timeradd(&tm[TM_USR_IDX], &tm[TM_SYS_IDX], &tv_cpu_sum);
+            timeradd(&tp->usr, &tp->sys, &tv_cpu_sum);
             tvp = &tv_cpu_sum;
         } else {
             errormsg(SH_DICT, ERROR_exit(0), e_badtformat, c);
@@ -395,6 +473,26 @@ static_fn void p_time(Shell_t *shp, Sfio_t *out, const char *format, struct time
     stkseek(stkp, offset);
 }
 
+// The format of the line that follows each traced simple command, or NULL if there is none.
+static_fn const char *xtrace_format(Shell_t *shp) {
+    Namval_t *np = nv_search("KSH_XTRACEFORMAT", shp->var_tree, 0);
+    const char *cp;
+
+    if (!np || !(cp = nv_getval(np)) || !*cp) return NULL;
+    return cp;
+}
+
+// Write what a traced simple command used, measured since tm_start(tp).
+static_fn void xtrace_usage(Shell_t *shp, struct tmsample *tp) {
+    const char *format;
+
+    tm_stop(tp);
+    if (!(format = xtrace_format(shp))) return;
+    sfset(sfstderr, SF_SHARE | SF_PUBLIC, 0);
+    p_time(shp, sfstderr, format, tp);
+    sfset(sfstderr, SF_SHARE | SF_PUBLIC, 1);
+}
+
 //
 // Clear argument pointers that point into the stack.
 //
@@ -929,6 +1027,7 @@ done:
 
 int sh_exec(Shell_t *shp, const Shnode_t *t, int flags) {
     sh_sigcheck(shp);
+    if (sh_profticks) sh_proftick(shp);
 
     if (!t) return shp->exitval;
     if (shp->st.execbrk) return shp->exitval;
@@ -963,6 +1062,8 @@ int sh_exec(Shell_t *shp, const Shnode_t *t, int flags) {
     volatile int was_errexit = sh_isstate(shp, SH_ERREXIT);
     volatile int was_monitor = sh_isstate(shp, SH_MONITOR);
     volatile int echeck = 0;
+    volatile bool xtimed = false;
+    struct tmsample xtm;
 
     if (flags & sh_state(SH_INTERACTIVE)) {
         if (pipejob == 2) job_unlock();
@@ -981,7 +1082,12 @@ int sh_exec(Shell_t *shp, const Shnode_t *t, int flags) {
     shp->exitval = 0;
     shp->lastsig = 0;
     shp->lastpath = NULL;
-    if (shp->exittrap || shp->errtrap) execflg = 0;
+    // The profile is written when the shell exits and the usage of a traced command when it is
+    // done, so the shell must not exec its last command.
+    if (shp->exittrap || shp->errtrap || sh_profon ||
+        (sh_isoption(shp, SH_XTRACE) && xtrace_format(shp))) {
+        execflg = 0;
+    }
     switch (type & COMMSK) {
         case TCOM: {
             struct argnod *argp;
@@ -1045,6 +1151,7 @@ int sh_exec(Shell_t *shp, const Shnode_t *t, int flags) {
                 }
             }
             if (com0) {
+                SH_PROBE2(command__start, com0, t->com.comline);
                 if (!np && !strchr(com0, '/')) {
                     Dt_t *root = command ? shp->bltin_tree : shp->fun_tree;
                     np = nv_bfsearch(com0, root, &nq, &cp);
@@ -1158,6 +1265,10 @@ int sh_exec(Shell_t *shp, const Shnode_t *t, int flags) {
                     break;
                 } else if ((np != SYSSET) && sh_isoption(shp, SH_XTRACE)) {
                     sh_trace(shp, com - command, tflags);
+                    if (xtrace_format(shp)) {
+                        xtimed = true;
+                        tm_start(&xtm);
+                    }
                 }
                 trap = shp->st.trap[SH_DEBUGTRAP];
                 if (trap) {
@@ -1587,7 +1698,8 @@ int sh_exec(Shell_t *shp, const Shnode_t *t, int flags) {
                     break;
                 }
 #else   // USE_SPAWN
-                parent = sh_fork(shp, type, &jobid);
+                parent = com0 ? sh_fastfork(shp, t, com, type, &jobid) : -1;
+                if (parent < 0) parent = sh_fork(shp, type, &jobid);
 #endif  // USE_SPAWN
             }
 #if SHOPT_COSHELL
@@ -2209,8 +2321,7 @@ int sh_exec(Shell_t *shp, const Shnode_t *t, int flags) {
         }
         case TTIME: {  // time the command
             const char *format = e_timeformat;
-            struct timeval ta, tb, tm[3];
-            struct timeval before_usr, before_sys, after_usr, after_sys;
+            struct tmsample tm;
 
 #if SHOPT_COSHELL
             if (shp->inpool) {
@@ -2223,8 +2334,7 @@ int sh_exec(Shell_t *shp, const Shnode_t *t, int flags) {
                 shp->exitval = !shp->exitval;
                 break;
             }
-            gettimeofday(&tb, NULL);
-            get_cpu_times(&before_usr, &before_sys);
+            tm_start(&tm);
             if (t->par.partre) {
                 if (shp->subshell && shp->comsub == 1) sh_subfork();
                 long timer_on = sh_isstate(shp, SH_TIMING);
@@ -2234,11 +2344,7 @@ int sh_exec(Shell_t *shp, const Shnode_t *t, int flags) {
                 if (!timer_on) sh_offstate(shp, SH_TIMING);
                 job.waitall = 0;
             }
-            get_cpu_times(&after_usr, &after_sys);
-            gettimeofday(&ta, NULL);
-            timersub(&ta, &tb, &tm[TM_REAL_IDX]);  // calculate elapsed real-time
-            timersub(&after_usr, &before_usr, &tm[TM_USR_IDX]);
-            timersub(&after_sys, &before_sys, &tm[TM_SYS_IDX]);
+            tm_stop(&tm);
 
             if (t->par.partre) {
                 Namval_t *np = nv_open("TIMEFORMAT", shp->var_tree, NV_NOADD);
@@ -2250,7 +2356,7 @@ int sh_exec(Shell_t *shp, const Shnode_t *t, int flags) {
             } else {
                 format = strchr(format + 1, '\n') + 1;
             }
-            if (format && *format) p_time(shp, sfstderr, sh_translate(format), tm);
+            if (format && *format) p_time(shp, sfstderr, sh_translate(format), &tm);
             break;
         }
         case TFUN: {
@@ -2372,7 +2478,9 @@ int sh_exec(Shell_t *shp, const Shnode_t *t, int flags) {
                 FETCH_VT(np->nvalue, rp)->argc = ac ? ((struct dolnod *)ac->comarg)->dolnum : 0;
                 FETCH_VT(np->nvalue, rp)->fdict = shp->fun_tree;
                 fp = (struct functnod *)(slp + 1);
-                if (fp->functtyp == (TFUN | FAMP)) FETCH_VT(np->nvalue, rp)->fname = fp->functnam;
+                if ((fp->functtyp & ~FLAZY) == (TFUN | FAMP)) {
+                    FETCH_VT(np->nvalue, rp)->fname = fp->functnam;
+                }
                 nv_setsize(np, fp->functline);
                 nv_offattr(np, NV_FPOSIX);
                 if (shp->funload) {
@@ -2478,6 +2586,8 @@ int sh_exec(Shell_t *shp, const Shnode_t *t, int flags) {
         default: { break; }
     }
 
+    if (com0) SH_PROBE3(command__done, com0, t->com.comline, shp->exitval);
+    if (xtimed) xtrace_usage(shp, &xtm);
     if (procsub && *procsub) {
         pid_t pid;
         int exitval = shp->exitval;
@@ -2621,6 +2731,7 @@ pid_t _sh_fork(Shell_t *shp, pid_t parent, int flags, int *jobid) {
     forkcnt = 1000L;
     if (parent) {
         int myjob, waitall = job.waitall;
+        SH_PROBE2(fork, parent, flags);
         shp->gd->nforks++;
         if (job.toclear) job_clear(shp);
         job.waitall = waitall;
@@ -2662,6 +2773,8 @@ pid_t _sh_fork(Shell_t *shp, pid_t parent, int flags, int *jobid) {
     if (shp->trapnote & SH_SIGTERM) sh_exit(shp, SH_EXITSIG | SIGTERM);
     shp->gd->nforks = 0;
     timerdel(NULL);
+    // The child doesn't inherit the profiling timer and its samples are not written.
+    sh_profon = false;
 #ifdef JOBS
     if (!job.jobcontrol && !(flags & FAMP)) sh_offstate(shp, SH_MONITOR);
     if (sh_isstate(shp, SH_MONITOR)) {
@@ -2704,6 +2817,7 @@ pid_t _sh_fork(Shell_t *shp, pid_t parent, int flags, int *jobid) {
 pid_t sh_fork(Shell_t *shp, int flags, int *jobid) {
     pid_t parent;
     sigset_t set, oset;
+    uint64_t start;
 
     if (!shp->pathlist) path_get(shp, "");
     sfsync(NULL);
@@ -2711,9 +2825,11 @@ pid_t sh_fork(Shell_t *shp, int flags, int *jobid) {
     job_fork(-1);
     sigfillset(&set);
     sigprocmask(SIG_BLOCK, &set, &oset);
+    start = sh_statclock();
     while (_sh_fork(shp, parent = fork(), flags, jobid) < 0) {
         ;  // empty loop
     }
+    if (parent) sh_stattime(STAT_TFORK, sh_statclock() - start);
     sh_stats(STAT_FORKS);
 #if USE_SPAWN
     if (parent == 0 && shp->vex) {
@@ -2726,6 +2842,71 @@ pid_t sh_fork(Shell_t *shp, int flags, int *jobid) {
     return parent;
 }
 
+#if !USE_SPAWN
+//
+// Start the simple foreground command <argv> without forking the shell. The fork server, see
+// forksrv.c, starts it when there is one and job control is off, and otherwise it is started with
+// path_vforkexec() where that is available. Returns -1 when the command has to be run by forking
+// the shell, which is also how commands that could not be executed are reported.
+//
+static_fn pid_t sh_fastfork(Shell_t *shp, const Shnode_t *t, char *argv[], int type, int *jobid) {
+    char **arge, *path = argv[0];
+    Namval_t *np;
+    Pathcomp_t *pp;
+    pid_t pid;
+    bool server = sh_forksrv_active(shp) && !sh_isstate(shp, SH_MONITOR);
+    uint64_t start;
+
+    if (t->com.comio || t->com.comset || (type & (FAMP | FPIN | FPOU | FCOOP | FSHOWME))) return -1;
+    if (shp->subshell || shp->xargmin) return -1;
+#if !USE_VFORK
+    if (!server) return -1;
+#endif
+    if (strchr(path, '/')) {
+        if (sh_isoption(shp, SH_RESTRICTED)) return -1;
+    } else {
+        np = nv_search(path, shp->track_tree, 0);
+        if (np && !nv_isattr(np, NV_NOALIAS) && FETCH_VT(np->nvalue, const_cp)) {
+            path = nv_getval(np);
+        } else if (path_absolute(shp, path, NULL)) {
+            path = stkptr(shp->stk, PATH_OFFSET);
+            stkfreeze(shp->stk, 0);
+        } else {
+            return -1;
+        }
+    }
+    // Commands in directories with a library component need the environment that path_exec()
+    // makes for them.
+    for (pp = path_get(shp, argv[0]); pp; pp = pp->next) {
+        if (pp->lib) return -1;
+    }
+    arge = sh_envgen(shp);
+    sfprintf(shp->stk, "_=*%d*%s", getpid(), path);
+    *--arge = stkfreeze(shp->stk, 1);
+    sfsync(NULL);
+    shp->trapnote &= ~SH_SIGTERM;
+    job_fork(-1);
+    start = sh_statclock();
+    if (server) {
+        pid = sh_forksrv_spawn(shp, path, argv, arge);
+#if USE_VFORK
+    } else {
+        // The process group the forked child would join, see _sh_fork().
+        pid = sh_isstate(shp, SH_MONITOR) && job.jobcontrol ? job.curpgid : -1;
+        pid = path_vforkexec(shp, path, argv, arge, pid);
+#endif
+    }
+    if (pid > 0) {
+        sh_stattime(STAT_TSPAWN, sh_statclock() - start);
+        _sh_fork(shp, pid, type, jobid);
+        job_fork(pid);
+    } else {
+        job_fork(0);
+    }
+    return pid;
+}
+#endif  // !USE_SPAWN
+
 struct Tdata {
     Shell_t *sh;
     Namval_t *tp;
@@ -2771,7 +2952,7 @@ Sfdouble_t sh_mathfun(Shell_t *shp, void *fp, int nargs, Sfdouble_t *arg) {
     nv_setattr(SH_VALNOD, NV_LDOUBLE | NV_NOFREE);
     STORE_VT(SH_VALNOD->nvalue, sfdoublep, NULL);
     for (i = 0; i < nargs; i++) {
-        *nr++ = mp = nv_namptr(shp->mathnodes, i);
+        *nr++ = mp = nv_namptr(sh_mathnodes(shp), i);
         STORE_VT(mp->nvalue, sfdoublep, arg++);
     }
     *nr = 0;
@@ -2808,7 +2989,6 @@ static_fn void sh_funct(Shell_t *shp, Namval_t *np, int argn, char *argv[], stru
         shp->posix_fun = np;
         save = argv[-1];
         argv[-1] = 0;
-        shp->st.funname = nv_name(np);
         shp->last_root = nv_dict(DOTSHNOD);
         nv_putval(SH_FUNNAMENOD, nv_name(np), NV_NOFREE);
         opt_info.index = opt_info.offset = 0;
@@ -3230,7 +3410,7 @@ int sh_funscope(Shell_t *shp, int argn, char *argv[], int (*fun)(void *), void *
                     nv_onattr(np, NV_REF | NV_NOFREE);
                 }
             }
-            sh_exec(shp, (Shnode_t *)(nv_funtree((fp->node))), execflg | SH_ERREXIT);
+            sh_exec(shp, sh_funtree(shp, fp->node), execflg | SH_ERREXIT);
             r = shp->exitval;
         }
     }
@@ -3295,6 +3475,7 @@ int sh_eval(Shell_t *shp, Sfio_t *iop, int mode) {
     int binscript = shp->binscript;
     char comsub = shp->comsub;
     Sfio_t *iosaved = io_save;
+    void *volatile pcache = sh_pcattach(shp, iop);
 
     io_save = iop;  // preserve correct value across longjmp
     shp->binscript = 0;
@@ -3314,7 +3495,12 @@ int sh_eval(Shell_t *shp, Sfio_t *iop, int mode) {
             if (traceon) sh_offoption(shp, SH_XTRACE);
         }
         t = sh_parse(shp, iop, (mode & (SH_READEVAL | SH_FUNEVAL)) ? mode & SH_FUNEVAL : SH_NL);
+        if (pcache) sh_pcdump(shp, pcache, t);
         if (!(mode & SH_FUNEVAL) || !sfreserve(iop, 0, 0)) {
+            if (pcache) {
+                sh_pcclose(shp, pcache, true);
+                pcache = NULL;
+            }
             if (!(mode & SH_READEVAL)) sfclose(iop);
             io_save = 0;
             mode &= ~SH_FUNEVAL;
@@ -3330,6 +3516,7 @@ int sh_eval(Shell_t *shp, Sfio_t *iop, int mode) {
         if (!io_save) break;
     }
     sh_popcontext(shp, buffp);
+    if (pcache) sh_pcclose(shp, pcache, false);
     shp->binscript = binscript;
     shp->comsub = comsub;
     if (traceon) sh_onoption(shp, SH_XTRACE);
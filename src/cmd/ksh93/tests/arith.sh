@@ -1073,3 +1073,18 @@ function f
 [[ $(( (2**32) << 67 )) == 0 ]] || log_error 'left shift count 67 is non-zero'
 
 [[ 0x123 -eq 0x122+0x1 ]] || log_error "[[...]] does not support math operations on hexadecimal numbers"
+
+# ==========
+# Decimal numbers read the same whether or not they take the fast conversion.
+typeset -lF x y
+for v in 0.1 -0.3 .5 5. 1.0e22 1.0e23 2.5e-22 123456789012345678.9 9007199254740993.0 1.5f 0.0e999
+do
+    x=$v
+    y=${v%%[ef]*}00000000000000000000${v#${v%%[ef]*}}
+    [[ $(printf %La "$x") == "$(printf %La "$y")" ]] ||
+        log_error "$v converts differently with extra digits" "$(printf %La "$y")" "$(printf %La "$x")"
+done
+x=-0.0
+[[ $(printf %La "$x") == -0x0* ]] || log_error "-0.0 loses its sign" "-0x0p+0" "$(printf %La "$x")"
+[[ $(( 1.5e2 + .25 )) == 150.25 ]] || log_error "1.5e2 + .25 is wrong" 150.25 "$(( 1.5e2 + .25 ))"
+[[ $(( 010 + 1.5 )) == 9.5 ]] || log_error "octal integer next to a decimal is wrong" 9.5 "$(( 010 + 1.5 ))"
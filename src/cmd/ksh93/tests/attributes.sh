@@ -581,3 +581,19 @@ set -a
 foo=${bar:=baz}
 env | grep -q bar || log_error 'Variable bar should be exported'
 set +a
+
+# ==========
+# The text of floating point variables follows their value and attributes when the same values are
+# expanded again.
+typeset -F2 f2=1.5
+typeset -F4 f4=1.5
+typeset -E e=1.5
+typeset -lF2 lf=1.5
+float z=0
+expect='1.50 1.5000 1.5 1.50 0 | -0.00 1.5000 2.25 1.50 -0 | 1.50 1.5000 1.5 1.50 0'
+actual="$f2 $f4 $e $lf $z"
+f2=-0.0 e=2.25 z=-0
+actual+=" | $f2 $f4 $e $lf $z"
+f2=1.5 e=1.5 z=0
+actual+=" | $f2 $f4 $e $lf $z"
+[[ $actual == "$expect" ]] || log_error "floating point values expand to the wrong text" "$expect" "$actual"
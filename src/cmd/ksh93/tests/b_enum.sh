@@ -168,3 +168,9 @@ enum foo
 actual=$(enum -p foo)
 expect=$'enum foo=(\n\tbar\n\tbaz\n)'
 [[ "$actual" = "$expect" ]] || log_error "enum does not convert indexed array to enum" "$expect" "$actual"
+
+# ==========
+# The predefined _Bool type is the same as one made by the enum builtin.
+actual=$($SHELL -c 'typeset -p _Bool; enum -p _Bool; bool b=true; typeset -p b' 2>&1)
+expect=$'typeset -a _Bool=(false true)\nenum _Bool=(\n\tfalse\n\ttrue\n)\n_Bool b=true'
+[[ "$actual" = "$expect" ]] || log_error "predefined _Bool differs" "$expect" "$actual"
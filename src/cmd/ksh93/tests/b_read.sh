@@ -25,6 +25,37 @@ read -C foo<<!
     log_error "read -C does recognize compound variables"
 unset foo
 
+# -m json reads a JSON document into a compound variable without evaluating it.
+read -m json foo <<'!'
+{"name": "x y", "n": 42, "f": 2.5, "ok": true, "nums": [1, 2, 3], "mixed": [1, "a"],
+ "objs": [{"a": 1}, {"a": "\u00e9\ud83d\ude00"}], "grid": [[1, 2], [3]], "empty": {},
+ "odd key": 1, "$(touch $TEST_DIR/json_pwned)": "`touch $TEST_DIR/json_pwned`"}
+!
+[[ ${foo.name} == 'x y' ]] || log_error "read -m json string member wrong" "x y" "${foo.name}"
+[[ $(typeset -p foo.n) == 'typeset -l -i foo.n=42' ]] ||
+    log_error "read -m json integer member wrong" "typeset -l -i foo.n=42" "$(typeset -p foo.n)"
+(( foo.f == 2.5 )) || log_error "read -m json float member wrong" "2.5" "${foo.f}"
+[[ $(typeset -p foo.ok) == '_Bool foo.ok=true' ]] ||
+    log_error "read -m json bool member wrong" "_Bool foo.ok=true" "$(typeset -p foo.ok)"
+[[ ${foo.nums[*]} == '1 2 3' ]] || log_error "read -m json array wrong" "1 2 3" "${foo.nums[*]}"
+[[ ${foo.mixed[*]} == '1 a' ]] || log_error "read -m json mixed array wrong" "1 a" "${foo.mixed[*]}"
+[[ ${foo.objs[1].a} == 'é😀' ]] ||
+    log_error "read -m json unicode escapes wrong" 'é😀' "${foo.objs[1].a}"
+[[ ${foo.grid[1][0]} == 3 ]] || log_error "read -m json nested arrays wrong" 3 "${foo.grid[1][0]}"
+[[ $(typeset -p foo) == *".['odd key']=1"* ]] ||
+    log_error "read -m json non-identifier key wrong" "*.['odd key']=1*" "$(typeset -p foo)"
+[[ -e $TEST_DIR/json_pwned ]] && log_error "read -m json evaluated its input"
+unset foo
+
+actual=$(printf '{"a":1}\n{"a":2}\n{"a":3}\n' | while read -m json foo; do print -n ${foo.a}; done)
+[[ $actual == 123 ]] || log_error "read -m json of a stream of documents wrong" 123 "$actual"
+
+read -m json foo <<< '{"a": [1,}' 2> $TEST_DIR/json.err &&
+    log_error "read -m json should fail on a syntax error"
+actual=$(< $TEST_DIR/json.err)
+[[ $actual == *'json: line 1: value expected'* ]] ||
+    log_error "read -m json syntax error message wrong" "*json: line 1: value expected*" "$actual"
+
 #-d delim Read until delimiter delim instead of to the end of line.
 read -d x <<!
 hello worldxfoobar
@@ -0,0 +1,104 @@
+# Tests for scripts compiled by shcomp
+
+shcomp=${SHCOMP:-${SHELL%/*}/shcomp}
+
+cat > "$TEST_DIR/script.sh" <<'EOF'
+function greet
+{
+	typeset -C c=(name=$1; typeset -a list=(a b))
+	print -r -- "hello ${c.name} ${c.list[1]}"
+	cat <<- EOT
+		here $1
+	EOT
+}
+function count
+{
+	typeset i
+	for (( i = 0; i < $1; i++ )); do print -n $i; done
+	print
+}
+greet world
+enum color_t=(red green blue)
+color_t color=green
+print -r -- "$color $(count 3)"
+echo pipe | tr a-z A-Z
+cat <(print procsub)
+cat < <(print redirect)
+for i in 1 2; do
+	case $i in
+	1) (( n = i * 6 )) ;;
+	*) [[ $i == 2 ]] && print "n=$n" ;;
+	esac
+done
+print -r -- "$(greet sub | head -1)"
+exit 3
+EOF
+
+$shcomp "$TEST_DIR/script.sh" "$TEST_DIR/script.shc" || log_error "shcomp failed"
+expect=$($SHELL "$TEST_DIR/script.sh")
+
+# ==========
+actual=$($SHELL "$TEST_DIR/script.shc")
+status=$?
+[[ $actual == "$expect" ]] || log_error "compiled script gives different output" "$expect" "$actual"
+(( status == 3 )) || log_error "compiled script gives wrong exit status" 3 "$status"
+
+# ==========
+actual=$($SHELL -c '. "$TEST_DIR/script.shc"')
+[[ $actual == "$expect" ]] || log_error "sourced compiled script gives different output" "$expect" "$actual"
+
+# ==========
+# Input that follows the compiled script is left for the commands that it runs.
+print 'cat' | $shcomp > "$TEST_DIR/cat.shc"
+actual=$({ cat "$TEST_DIR/cat.shc"; print trailing; } | $SHELL)
+[[ $actual == trailing ]] || log_error "input after a compiled script is lost" trailing "$actual"
+
+# ==========
+# Functions defined by a compiled script outlive the script.
+print 'function lib { print -r -- "lib $1"; }' | $shcomp > "$TEST_DIR/lib.shc"
+actual=$($SHELL -c 'for i in 1 2 3; do . "$TEST_DIR/lib.shc"; done; lib one')
+expect='lib one'
+[[ $actual == "$expect" ]] || log_error "function from a compiled script is wrong" "$expect" "$actual"
+
+# ==========
+# Scripts compiled by earlier versions of shcomp still run.
+printf '\013\023\010\000\003\000\020\100\000\006\160\162\151\156\164\001\003\055\162\001\003\055\055\001\016\042\166\063\040\044\050\050\061\053\062\051\051\042\044\000\001' > "$TEST_DIR/v3.shc"
+actual=$($SHELL "$TEST_DIR/v3.shc")
+[[ $actual == 'v3 3' ]] || log_error "version 3 compiled script fails" 'v3 3' "$actual"
+
+# ==========
+# An image written with a different byte order is refused.
+{ head -c 8 "$TEST_DIR/cat.shc"; print -n 'XXXX'; tail -c +13 "$TEST_DIR/cat.shc"; } > "$TEST_DIR/bad.shc"
+actual=$($SHELL "$TEST_DIR/bad.shc" 2>&1 < /dev/null)
+[[ $actual == *'4: invalid binary script version'* ]] || log_error "compiled script with a foreign byte order is used" '*4: invalid binary script version*' "$actual"
+
+# ==========
+# A compiled script that is cut short or whose nodes are overwritten is refused.
+head -c 100 "$TEST_DIR/script.shc" > "$TEST_DIR/short.shc"
+actual=$($SHELL "$TEST_DIR/short.shc" 2>&1 < /dev/null)
+[[ $actual == *'4: invalid binary script version'* ]] || log_error "truncated compiled script is used" '*4: invalid binary script version*' "$actual"
+
+# The nodes lie between the header and the string table.
+integer strings=$(od -An -t u8 -j 32 -N 8 "$TEST_DIR/script.shc")
+integer nodes=8+40
+{
+    head -c $nodes "$TEST_DIR/script.shc"
+    tr '\0' '\377' < /dev/zero | head -c $((strings + 8 - nodes))
+    tail -c +$((strings + 9)) "$TEST_DIR/script.shc"
+} > "$TEST_DIR/corrupt.shc"
+actual=$($SHELL "$TEST_DIR/corrupt.shc" 2>&1 < /dev/null)
+[[ $actual == *'4: invalid binary script version'* ]] || log_error "corrupt compiled script is used" '*4: invalid binary script version*' "$actual"
+
+# ==========
+# A compiled script can run another script by name. The forked shell that runs it used to mistake
+# it for the compiled script when it got a stream at the same address, and ran that again.
+cat > "$TEST_DIR/byname.sh" <<'EOF'
+print $'print -r -- "other $1"\n[[ $1 ]] && $0' > "$TEST_DIR/other"
+chmod +x "$TEST_DIR/other"
+"$TEST_DIR/other" one
+print done
+EOF
+$shcomp "$TEST_DIR/byname.sh" "$TEST_DIR/byname.shc" || log_error "shcomp failed"
+actual=$($SHELL "$TEST_DIR/byname.shc" 2>&1 < /dev/null)
+expect=$'other one\nother \ndone'
+[[ $actual == "$expect" ]] || log_error "compiled script fails to run a script by name" "$expect" "$actual"
@@ -611,6 +611,18 @@ touch "$TEST_DIR/corrupted_history"
 echo "sa;lfjsa;fj;sajfjs;fjdf" > "$TEST_DIR/corrupted_history"
 env HISTFILE="$TEST_DIR/corrupted_history" $SHELL -i -c "[[ $(history | wc -l) -eq 0 ]] && exit 0 || exit 1"
 
+# ==========
+# Commands older than the last few hundred in a large history file can be listed
+for ((i = 1; i <= 3000; i++))
+do  print "echo command $i"
+done | HISTFILE="$TEST_DIR/large_history" $SHELL -c 'while read -s line; do :; done'
+expect=$'2001\techo command 2001\n2002\techo command 2002'
+actual=$(HISTFILE="$TEST_DIR/large_history" HISTSIZE=1000 $SHELL -c 'hist -l 2001 2002' 2>&1)
+[[ $actual == "$expect" ]] || log_error "old commands in a large history file are wrong" "$expect" "$actual"
+expect=$'2999\techo command 2999\n3000\techo command 3000'
+actual=$(HISTFILE="$TEST_DIR/large_history" HISTSIZE=1000 $SHELL -c 'hist -l -1' 2>&1)
+[[ $actual == "$expect" ]] || log_error "last commands in a large history file are wrong" "$expect" "$actual"
+
 # ==========
 # umask - get or set the file creation mask
 set -- \
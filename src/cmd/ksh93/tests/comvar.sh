@@ -689,6 +689,18 @@ c.c=()
 exp=$'(\n\ttypeset -C -a c\n)'
 [[ $(print -v c) == "$exp" ]] || log_error 'setting compound array c.c=() does not preserve -C attribute'
 
+# print -v, printf %B and typeset -p write compound variables as they are walked. The result must
+# match the value of the variable, which is formatted in a buffer.
+unset c
+compound c=(typeset -a a=( (x=1; typeset -A m=([k]=(z=1))) (x=2; compound y=(v=3)) ); s=str)
+print -v c > $TEST_DIR/comvar.out
+[[ $(< $TEST_DIR/comvar.out) == "$c" ]] || log_error 'print -v of nested compound arrays wrong' "$c" "$(< $TEST_DIR/comvar.out)"
+printf '%B\n' c > $TEST_DIR/comvar.out
+[[ $(< $TEST_DIR/comvar.out) == "$c" ]] || log_error 'printf %B of nested compound arrays wrong' "$c" "$(< $TEST_DIR/comvar.out)"
+exp='typeset -C c=(typeset -a a=( [0]=(typeset -A m=( [k]=(z=1;););x=1;);[1]=(x=2;y=(v=3;);););s=str)'
+typeset -p c > $TEST_DIR/comvar.out
+[[ $(< $TEST_DIR/comvar.out) == "$exp" ]] || log_error 'typeset -p of nested compound arrays wrong' "$exp" "$(< $TEST_DIR/comvar.out)"
+
 # These tests were disabled as we don't build with json support by default
 # https://github.com/att/ast/issues/820
 # compound xx=(this=that integer x=5)
@@ -0,0 +1,93 @@
+# Tests for the fork server enabled by KSH_FORKSERVER
+
+unset KSH_FORKSERVER
+
+cat > "$TEST_DIR/cmds.sh" <<'EOF2'
+/bin/echo hello world
+"$SHELL" -c 'exit 3'
+print status=$?
+"$SHELL" -c 'print -r -- "$1 $2"' arg 'two words'
+cd "$TEST_DIR"
+"$SHELL" -c 'pwd'
+umask 027
+"$SHELL" -c 'umask'
+export FOO=bar
+"$SHELL" -c 'print -r -- FOO=$FOO'
+nosuchcommand_in_path
+print status=$?
+"$TEST_DIR/noshebang" one
+print status=$?
+print $(/bin/echo substituted)
+EOF2
+print 'print -r -- "noshebang $1"; exit 5' > "$TEST_DIR/noshebang"
+chmod +x "$TEST_DIR/noshebang"
+
+# ==========
+# Commands started by the fork server behave like forked ones.
+expect=$(cd "$TEST_DIR" && $SHELL cmds.sh 2>&1)
+actual=$(cd "$TEST_DIR" && KSH_FORKSERVER=1 $SHELL cmds.sh 2>&1)
+[[ $actual == "$expect" ]] || log_error "fork server changes the output" "$expect" "$actual"
+
+# ==========
+# The fork server is only started when it is asked for. It is a child of the shell.
+if [[ -r /proc/$$/task/$$/children ]]
+then
+    actual=$(KSH_FORKSERVER=1 $SHELL -c 'c=$(< /proc/$$/task/$$/children); print ${#c}')
+    (( actual > 0 )) || log_error "fork server not started" "> 0" "$actual"
+    actual=$($SHELL -c 'c=$(< /proc/$$/task/$$/children); print ${#c}')
+    (( actual == 0 )) || log_error "fork server started without KSH_FORKSERVER" 0 "$actual"
+fi
+
+# ==========
+# Descriptors that are open in the shell are open in the command.
+actual=$(KSH_FORKSERVER=1 $SHELL -c '
+    { "$SHELL" -c "print out; print -u2 err"; } > "$TEST_DIR/out" 2>&1
+    cat "$TEST_DIR/out"')
+expect=$'out\nerr'
+[[ $actual == "$expect" ]] || log_error "descriptors not passed" "$expect" "$actual"
+
+# ==========
+# Signals ignored by the shell are ignored by the command.
+actual=$(KSH_FORKSERVER=1 $SHELL -c '
+    trap "" USR1
+    "$SHELL" -c "kill -USR1 \$\$; print alive"')
+[[ $actual == alive ]] || log_error "ignored signal not inherited" alive "$actual"
+
+actual=$(KSH_FORKSERVER=1 $SHELL -c '
+    trap "print caught" USR1
+    "$SHELL" -c "kill -USR1 \$\$; print alive"; print status=$(kill -l $?)' 2> /dev/null)
+[[ $actual == status=USR1 ]] || log_error "trapped signal not reset" status=USR1 "$actual"
+
+# ==========
+# Waiting for all children doesn't wait for the fork server.
+actual=$(KSH_FORKSERVER=1 timeout 10 $SHELL -c '/bin/true; sleep 0 & wait; print done')
+[[ $actual == done ]] || log_error "wait hangs with the fork server" done "$actual"
+
+# ==========
+# Changing a resource limit stops the fork server.
+actual=$(KSH_FORKSERVER=1 $SHELL -c 'ulimit -n 100; "$SHELL" -c "ulimit -n"')
+[[ $actual == 100 ]] || log_error "resource limit not passed" 100 "$actual"
+
+# ==========
+# A change of the privileged option stops the fork server.
+if [[ -r /proc/$$/task/$$/children ]]
+then
+    actual=$(KSH_FORKSERVER=1 $SHELL -c 'set -p; c=$(< /proc/$$/task/$$/children); print ${#c}')
+    (( actual == 0 )) || log_error "set -p does not stop the fork server" 0 "$actual"
+fi
+actual=$(KSH_FORKSERVER=1 $SHELL -c 'set -p; set +p; /bin/echo ok')
+[[ $actual == ok ]] || log_error "commands fail after the fork server is stopped" ok "$actual"
+
+# A setuid shell that keeps its privileges doesn't start the fork server, which would otherwise
+# run commands as root after `set +p`.
+if [[ $(id -u) == 0 && -r /proc/$$/task/$$/children ]] && whence -q setpriv
+then
+    mkdir -m 755 "$TEST_DIR/suid"
+    cp "$SHELL" "$TEST_DIR/suid/ksh"
+    chmod 4755 "$TEST_DIR/suid/ksh"
+    actual=$(KSH_FORKSERVER=1 setpriv --reuid=65534 --regid=65534 --clear-groups \
+        "$TEST_DIR/suid/ksh" -p -c 'c=$(< /proc/$$/task/$$/children); set +p
+        print ${#c} $(/bin/sh -c "id -u")' 2>&1)
+    [[ $actual == "0 65534" ]] ||
+        log_error "setuid shell runs commands through the fork server" "0 65534" "$actual"
+fi
@@ -0,0 +1,121 @@
+# Tests for the deferred parsing of function bodies enabled by KSH_LAZYPARSE
+
+cat > "$TEST_DIR/lib.sh" <<'EOF'
+function nested
+{
+	function inner { print -r -- "inner $1"; }
+	inner "$1"
+}
+function withdoc
+{
+	cat <<- EOT
+		doc $1 }
+	EOT
+	print -r -- "$LINENO ${.sh.fun}"
+}
+function opts
+{
+	typeset OPTIND=1 c
+	while getopts ab: c; do print -r -- "$c ${OPTARG-}"; done
+}
+function later { print first; }
+function braces
+{
+	x=( a=1 b=2 ); [[ ${x.b} == 2 ]] && { print "${x.a}" ; }
+	case $1 in (a) print "case a" ;; *) print "case ${1-}" ;; esac
+	print -r -- "${1:-'}'}" $'}' "}" @(x)
+}
+f() { print posix $LINENO; }
+EOF
+
+script='. "$TEST_DIR/lib.sh"; nested x; withdoc y; opts -a -b z; typeset -f withdoc
+function later { print second; }; later; braces a; braces; f'
+expect=$($SHELL -c "$script" 2>&1)
+
+# ==========
+# Deferring the bodies does not change what the functions do.
+actual=$(KSH_LAZYPARSE=1 $SHELL -c "$script" 2>&1)
+[[ $actual == "$expect" ]] || log_error "deferred parsing changes the output" "$expect" "$actual"
+
+# ==========
+# A body that is never called is not parsed.
+cat > "$TEST_DIR/bad.sh" <<'EOF'
+function bad
+{
+	if then fi
+}
+print before
+EOF
+actual=$(KSH_LAZYPARSE=1 $SHELL "$TEST_DIR/bad.sh" 2>&1)
+[[ $actual == before ]] || log_error "unused body is parsed" before "$actual"
+
+# ==========
+# The syntax error is reported when the function is first called.
+actual=$(KSH_LAZYPARSE=1 $SHELL -c '. "$TEST_DIR/bad.sh"; bad; print status $?' 2>&1)
+[[ $actual == *"bad: syntax error at line 3: \`then' unexpected"* ]] ||
+    log_error "syntax error not reported at the call" "*bad: syntax error at line 3*" "$actual"
+[[ $actual == *'status 3' ]] || log_error "wrong exit status for the call" "status 3" "$actual"
+
+# ==========
+# Aliases defined when the body is read are expanded.
+cat > "$TEST_DIR/alias.sh" <<'EOF'
+alias hi="print hello"
+function g
+{
+	hi there
+}
+unalias hi
+g
+EOF
+actual=$(KSH_LAZYPARSE=1 $SHELL "$TEST_DIR/alias.sh" 2>&1)
+[[ $actual == 'hello there' ]] || log_error "alias not expanded in the body" 'hello there' "$actual"
+
+# ==========
+# Aliases defined after the body is read are not expanded.
+cat > "$TEST_DIR/alias.sh" <<'EOF'
+function g
+{
+	hi there
+}
+alias hi="print hello"
+g
+EOF
+actual=$(KSH_LAZYPARSE=1 $SHELL "$TEST_DIR/alias.sh" 2>&1)
+[[ $actual == *'hi: not found'* ]] || log_error "alias defined later expanded" '*hi: not found*' "$actual"
+
+# ==========
+# Braces are only taken as the end of the body where a reserved word can be.
+cat > "$TEST_DIR/brace.sh" <<'EOF'
+function b1
+{
+	if true; then { print then; }; else { print else; }; fi
+	for i in 1; do { print do; }; done
+	! { false; } && print not
+	print } {
+	case $1 in ({) print open;; (}) print close;; esac
+	function b2 { print nested; }
+	b3() { print posix; }
+	b2; b3
+}
+function b4 { cat <<EOT; } >&2
+doc }
+EOT
+b1 '{'; b1 '}'; b4 2>&1
+EOF
+expect=$($SHELL "$TEST_DIR/brace.sh" 2>&1)
+actual=$(KSH_LAZYPARSE=1 $SHELL "$TEST_DIR/brace.sh" 2>&1)
+[[ $actual == "$expect" ]] || log_error "deferred body ends at the wrong brace" "$expect" "$actual"
+
+# ==========
+# Errors found when the body is run have the same line numbers.
+cat > "$TEST_DIR/line.sh" <<'EOF'
+function g
+{
+	print $LINENO
+	: ${undefined?}
+}
+g
+EOF
+expect=$($SHELL "$TEST_DIR/line.sh" 2>&1)
+actual=$(KSH_LAZYPARSE=1 $SHELL "$TEST_DIR/line.sh" 2>&1)
+[[ $actual == "$expect" ]] || log_error "line numbers differ" "$expect" "$actual"
@@ -316,3 +316,35 @@ typeset -r utf8_euro_char2=$'\342\202\254'
 (( (${#utf8_euro_char1} == 1) && (${#utf8_euro_char2} == 1) )) \
         || export LC_ALL='en_US.UTF-8'
 [[ "$(printf '\u[20ac]')" == $'\342\202\254' ]]  || log_error 'locales not handled correctly in command substitution'
+
+# ==========
+# Formatted floating point values follow a change of the decimal point. Build a locale whose
+# decimal point is a comma if there is none.
+comma=$(PATH=/bin:/usr/bin locale -a 2>/dev/null | grep -E -m1 '^(de_DE|fr_FR|nl_NL)\.(utf8|UTF-8)$')
+if [[ ! $comma ]] && [[ $(whence localedef) ]]
+then
+    {
+        print '<code_set_name> ANSI_X3.4-1968'
+        print CHARMAP
+        for (( c = 0; c < 128; c++ ))
+        do
+            printf '<U%04X> \\x%02x\n' $c $c
+        done
+        print 'END CHARMAP'
+    } > $TEST_DIR/comma.charmap
+    print $'LC_NUMERIC\ndecimal_point "<U002C>"\nthousands_sep ""\ngrouping -1\nEND LC_NUMERIC' \
+        > $TEST_DIR/comma.def
+    mkdir $TEST_DIR/locale
+    # The other categories are missing, so localedef warns and fails but still writes the locale.
+    localedef -c -f $TEST_DIR/comma.charmap -i $TEST_DIR/comma.def $TEST_DIR/locale/comma \
+        > /dev/null 2>&1
+    [[ -f $TEST_DIR/locale/comma/LC_NUMERIC ]] && comma=comma
+fi
+if [[ $comma ]]
+then
+    expect=$'1.50\n1,50\n1.50'
+    actual=$(LOCPATH=$TEST_DIR/locale $SHELL -c \
+        "typeset -F2 x=1.5; print \$x; LC_NUMERIC=$comma; print \$x; LC_NUMERIC=C; print \$x")
+    [[ $actual == "$expect" ]] ||
+        log_error "floating point values keep the decimal point of the old locale" "$expect" "$actual"
+fi
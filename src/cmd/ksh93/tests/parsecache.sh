@@ -0,0 +1,64 @@
+# Tests for the parse cache enabled by KSH_PARSECACHE
+
+cache=$TEST_DIR/cache
+mkdir -p "$TEST_DIR/fpath"
+
+cat > "$TEST_DIR/lib.sh" <<'EOF'
+function greet
+{
+	print -r -- "hello $1"
+	cat <<- EOT
+		here $1
+	EOT
+}
+(( total = 3 + 4 ))
+case $total in 7) print seven ;; esac
+EOF
+
+cat > "$TEST_DIR/fpath/autofn" <<'EOF'
+function autofn { print -r -- "autoloaded $*"; }
+EOF
+
+script='. "$TEST_DIR/lib.sh"; greet world; autofn a b; typeset -f greet'
+expect=$(FPATH=$TEST_DIR/fpath $SHELL -c "$script")
+
+# ==========
+# The first run creates the entries and the second one uses them.
+actual=$(KSH_PARSECACHE=$cache FPATH=$TEST_DIR/fpath $SHELL -c "$script")
+[[ $actual == "$expect" ]] || log_error "creating the cache changes the output" "$expect" "$actual"
+actual=$(ls "$cache" | wc -l)
+(( actual == 2 )) || log_error "wrong number of cache entries" 2 "$actual"
+
+actual=$(KSH_PARSECACHE=$cache FPATH=$TEST_DIR/fpath $SHELL -c "$script")
+[[ $actual == "$expect" ]] || log_error "restoring from the cache changes the output" "$expect" "$actual"
+
+# ==========
+# Changing the file invalidates its entry.
+print 'print changed' >> "$TEST_DIR/lib.sh"
+actual=$(KSH_PARSECACHE=$cache $SHELL -c '. "$TEST_DIR/lib.sh"' | tail -1)
+[[ $actual == changed ]] || log_error "stale cache entry used" changed "$actual"
+
+# ==========
+# Aliases in effect when the file is read are part of the key.
+print 'greet' > "$TEST_DIR/alias.sh"
+actual=$(KSH_PARSECACHE=$cache $SHELL -c 'alias greet="print one"
+. "$TEST_DIR/alias.sh"')
+[[ $actual == one ]] || log_error "alias not expanded" one "$actual"
+actual=$(KSH_PARSECACHE=$cache $SHELL -c 'alias greet="print two"
+. "$TEST_DIR/alias.sh"')
+[[ $actual == two ]] || log_error "cache ignores aliases" two "$actual"
+
+# ==========
+# A file with a syntax error leaves no entry behind.
+rm -rf "$cache"
+print 'if true; then' > "$TEST_DIR/bad.sh"
+KSH_PARSECACHE=$cache $SHELL -c '. "$TEST_DIR/bad.sh"' 2> /dev/null
+actual=$(ls "$cache" | wc -l)
+(( actual == 0 )) || log_error "syntax error left a cache entry" 0 "$actual"
+
+# ==========
+# A cache directory that others can write to is not used.
+chmod go+w "$cache"
+KSH_PARSECACHE=$cache $SHELL -c '. "$TEST_DIR/alias.sh"' 2> /dev/null
+actual=$(ls "$cache" | wc -l)
+(( actual == 0 )) || log_error "insecure cache directory used" 0 "$actual"
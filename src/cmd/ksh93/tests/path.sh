@@ -430,3 +430,29 @@ cat < /dev/null || log_error "Directories should not be treated as executables"
 
 # Restore PATH
 PATH="$OPATH"
+
+# ==========
+# An interactive shell uses an index of the names in each PATH directory to tell that a command is
+# not there. A command added to a directory is found once the directory has changed.
+mkdir -p "$TEST_DIR/idx/one" "$TEST_DIR/idx/two"
+print 'print two' > "$TEST_DIR/idx/two/idxcmd"
+chmod +x "$TEST_DIR/idx/two/idxcmd"
+touch -t 200001010000 "$TEST_DIR/idx/one" "$TEST_DIR/idx/two"
+expect=$'missing\ntwo/idxcmd\none/idxnew\none/idxold\none/idxcmd'
+actual=$(cd "$TEST_DIR/idx" && PATH=$TEST_DIR/idx/one:$TEST_DIR/idx/two:$PATH ENV=/dev/null \
+    HISTFILE=$TEST_DIR/idx/history $SHELL -i -c '
+    whence -p idxnew || print missing
+    whence -p idxcmd
+    print "print new" > one/idxnew && chmod +x one/idxnew
+    whence -p idxnew
+    print "print old" > one/idxold && chmod +x one/idxold
+    touch -t 200101010000 one
+    whence -p idxold
+    print "print one" > one/idxcmd && chmod +x one/idxcmd
+    touch -t 200201010000 one
+    hash -r
+    whence -p idxcmd
+' 2>&1)
+actual=${actual//$TEST_DIR\/idx\/}
+[[ $actual == "$expect" ]] || log_error "a command added to an indexed PATH directory is not found" \
+    "$expect" "$actual"
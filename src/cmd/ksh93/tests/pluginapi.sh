@@ -0,0 +1,106 @@
+# Tests for the variable access functions builtins get through the api member of their context
+
+builtin -f "$LIBSAMPLE_PATH" sample_sum sample_squares sample_dump sample_set ||
+    log_error "Failed to load the sample API builtins"
+
+# The sample builtins leave what they find in REPLY.
+function sum {
+    unset REPLY
+    sample_sum "$1" && print -r -- "$REPLY"
+}
+function dump {
+    unset REPLY
+    sample_dump "$1" || return
+    typeset IFS=$'\n'
+    print -r -- "${REPLY[*]}"
+}
+
+# ==========
+# Walking indexed arrays.
+a=(1 2 3 x 4.5)
+expect="5 10.5"
+actual=$(sum a)
+[[ $actual == "$expect" ]] || log_error "sum of a string array" "$expect" "$actual"
+
+typeset -li b=(10 20 30)
+b[7]=5
+expect=$'kind=2 count=4\n0 (0) =10\n1 (1) =20\n2 (2) =30\n7 (7) =5'
+actual=$(dump b)
+[[ $actual == "$expect" ]] || log_error "walk of a sparse integer array" "$expect" "$actual"
+
+typeset -a comp=( (x=1 y=2) (x=3 y=4) )
+expect=$'kind=2 count=2\n0 (0) x=1 y=2\n1 (1) x=3 y=4'
+actual=$(dump comp)
+[[ $actual == "$expect" ]] || log_error "walk of an array of compound variables" "$expect" "$actual"
+
+s=scalar
+expect="kind=1 count=1"
+actual=$(dump s)
+[[ $actual == "$expect" ]] || log_error "walk of a scalar" "$expect" "$actual"
+
+sample_dump nosuch && log_error "an unset variable is found"
+
+# ==========
+# Walking associative arrays.
+typeset -A m=([one]=1 [two]=zwei [three]=3)
+expect=$'kind=3 count=3\none (-1) =1\nthree (-1) =3\ntwo (-1) =zwei'
+actual=$(dump m)
+[[ $actual == "$expect" ]] || log_error "walk of an associative array" "$expect" "$actual"
+expect="3 4"
+actual=$(sum m)
+[[ $actual == "$expect" ]] || log_error "sum of an associative array" "$expect" "$actual"
+
+# A walk leaves no scan behind.
+sample_sum m > /dev/null
+expect="one three two"
+actual="${!m[*]}"
+[[ $actual == "$expect" ]] || log_error "a walk changes the subscripts" "$expect" "$actual"
+
+# ==========
+# Bulk append.
+sample_squares c 5
+expect="typeset -a -l -i c=(0 1 4 9 16)"
+actual=$(typeset -p c)
+[[ $actual == "$expect" ]] || log_error "append to a new variable" "$expect" "$actual"
+sample_squares c 2
+expect="typeset -a -l -i c=(0 1 4 9 16 0 1)"
+actual=$(typeset -p c)
+[[ $actual == "$expect" ]] || log_error "append to an integer array" "$expect" "$actual"
+
+x=(a b)
+sample_squares x 2
+expect="typeset -a x=(a b 0 1)"
+actual=$(typeset -p x)
+[[ $actual == "$expect" ]] || log_error "append to a string array" "$expect" "$actual"
+
+sample_squares big 100000
+expect="100000 333328333350000"
+actual=$(sum big)
+[[ $actual == "$expect" ]] || log_error "sum of a large array" "$expect" "$actual"
+
+sample_squares m 2 && log_error "append to an associative array succeeds"
+
+# ==========
+# Assignments to elements.
+sample_set m four vier
+expect="typeset -A m=([four]=vier [one]=1 [three]=3 [two]=zwei)"
+actual=$(typeset -p m)
+[[ $actual == "$expect" ]] || log_error "assignment to an associative array" "$expect" "$actual"
+sample_set n 3 42
+expect="typeset -a n=([3]=42)"
+actual=$(typeset -p n)
+[[ $actual == "$expect" ]] || log_error "assignment to an indexed array" "$expect" "$actual"
+
+# ==========
+# Changes made in a subshell are not seen by the parent.
+c=(1 2)
+( sample_squares c 3 )
+expect="typeset -a c=(1 2)"
+actual=$(typeset -p c)
+[[ $actual == "$expect" ]] || log_error "append in a subshell" "$expect" "$actual"
+( sample_squares newv 2 )
+expect=""
+actual=$(typeset -p newv)
+[[ $actual == "$expect" ]] || log_error "a variable made in a subshell" "$expect" "$actual"
+( sample_set m five fuenf )
+[[ -v m[five] ]] && log_error "assignment to an associative array in a subshell"
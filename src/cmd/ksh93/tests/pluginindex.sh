@@ -0,0 +1,98 @@
+# Tests for the plugin index enabled by KSH_PLUGININDEX
+
+unset KSH_PLUGININDEX
+
+mkdir -p "$TEST_DIR/one/bin" "$TEST_DIR/one/lib/ksh" "$TEST_DIR/two/bin" "$TEST_DIR/two/lib/ksh"
+cp "$LIBSAMPLE_PATH" "$TEST_DIR/two/lib/ksh/libsample.so"
+index=$TEST_DIR/index
+path=$TEST_DIR/one/bin:$TEST_DIR/two/bin:$PATH
+
+# ==========
+# The first search for a plugin creates the index.
+expect="This is a sample builtin"
+actual=$(PATH=$path KSH_PLUGININDEX=$index $SHELL -c 'builtin -f sample sample && sample')
+[[ $actual == "$expect" ]] || log_error "builtin -f with an index fails" "$expect" "$actual"
+[[ -f $index ]] || log_error "the plugin index is not created"
+expect=$'\t'$TEST_DIR/two/lib/ksh/libsample.so$'\t'
+[[ $(<$index) == *"$expect"* ]] || log_error "the index does not record the library" \
+    "$expect" "$(<$index)"
+[[ $(<$index) == *[$'\t ']'b_sample '* ]] || log_error "the index does not record the builtins" \
+    "b_sample" "$(<$index)"
+[[ $(ls -l "$index") == -rw-------* ]] || log_error "the index can be read by others" \
+    "-rw-------" "$(ls -l "$index")"
+
+# ==========
+# A second search uses the index and leaves it alone.
+before=$(ls -i "$index")
+expect="sample 20131127 $TEST_DIR/two/lib/ksh/libsample.so"
+actual=$(PATH=$path KSH_PLUGININDEX=$index $SHELL -c 'builtin -lf sample sample')
+[[ $actual == "$expect" ]] || log_error "builtin -f using the index fails" "$expect" "$actual"
+[[ $(ls -i "$index") == "$before" ]] || log_error "the index is rewritten when it is up to date"
+
+# ==========
+# A library added to a directory that is searched first makes the entry stale.
+cp "$LIBSAMPLE_PATH" "$TEST_DIR/one/lib/ksh/libsample.so"
+expect="sample 20131127 $TEST_DIR/one/lib/ksh/libsample.so"
+actual=$(PATH=$path KSH_PLUGININDEX=$index $SHELL -c 'builtin -lf sample sample')
+[[ $actual == "$expect" ]] || log_error "a stale index entry is used" "$expect" "$actual"
+[[ $(ls -i "$index") != "$before" ]] || log_error "a stale index entry is not replaced"
+
+# A change of PATH is a different search.
+expect="sample 20131127 $TEST_DIR/two/lib/ksh/libsample.so"
+actual=$(PATH=$TEST_DIR/two/bin:$PATH KSH_PLUGININDEX=$index $SHELL -c 'builtin -lf sample sample')
+[[ $actual == "$expect" ]] || log_error "the index ignores PATH" "$expect" "$actual"
+
+# A removed library makes the entry stale.
+rm "$TEST_DIR/one/lib/ksh/libsample.so"
+actual=$(PATH=$path KSH_PLUGININDEX=$index $SHELL -c 'builtin -lf sample sample')
+[[ $actual == "$expect" ]] || log_error "an index entry for a removed library is used" \
+    "$expect" "$actual"
+
+# ==========
+# An index that others can write is not trusted.
+print -r -- "garbage" > "$index"
+chmod 666 "$index"
+actual=$(PATH=$path KSH_PLUGININDEX=$index $SHELL -c 'builtin -lf sample sample')
+[[ $actual == "$expect" ]] || log_error "a bad index breaks builtin -f" "$expect" "$actual"
+[[ $(ls -l "$index") == -rw-------* ]] || log_error "an index others can write is not replaced" \
+    "-rw-------" "$(ls -l "$index")"
+
+# No temporary copy of the index is left behind.
+set -- "$index".*
+[[ -e $1 ]] && log_error "a temporary copy of the index is left behind" "" "$*"
+
+# The index is not written in a directory that belongs to someone else.
+if [[ $(id -u) == 0 ]] && id nobody > /dev/null 2>&1; then
+    mkdir "$TEST_DIR/other"
+    chown nobody "$TEST_DIR/other"
+    actual=$(PATH=$path KSH_PLUGININDEX=$TEST_DIR/other/index $SHELL -c 'builtin -lf sample sample')
+    [[ $actual == "$expect" ]] || log_error "builtin -f with an index in a foreign directory fails" \
+        "$expect" "$actual"
+    [[ -e $TEST_DIR/other/index ]] && log_error "the index is written in a foreign directory"
+fi
+
+# A relative pathname is ignored.
+actual=$(cd "$TEST_DIR" && PATH=$path KSH_PLUGININDEX=relindex $SHELL -c 'builtin -lf sample sample')
+[[ $actual == "$expect" ]] || log_error "builtin -f with a relative index fails" "$expect" "$actual"
+[[ -e $TEST_DIR/relindex ]] && log_error "a relative index pathname is used"
+
+# ==========
+# The index tells a PLUGIN_LIB search that a library doesn't have a builtin without loading it.
+print PLUGIN_LIB=sample > "$TEST_DIR/two/bin/.paths"
+: > "$TEST_DIR/two/bin/sample"
+chmod +x "$TEST_DIR/two/bin/sample"
+rm -f "$index"
+PATH=$path KSH_PLUGININDEX=$index $SHELL -c 'sample; sample' > /dev/null 2>&1
+expect=$'\t'$TEST_DIR/two/bin/sample$'\t'
+[[ $(<$index) == *"$expect"* ]] || log_error "a PLUGIN_LIB search is not indexed" \
+    "$expect" "$(<$index)"
+expect="This is a sample builtin"
+actual=$(PATH=$path KSH_PLUGININDEX=$index $SHELL -c 'sample; sample' 2>&1)
+[[ $actual == *"$expect"* ]] || log_error "PLUGIN_LIB with an index fails" "$expect" "$actual"
+: > "$TEST_DIR/two/bin/nosample"
+chmod +x "$TEST_DIR/two/bin/nosample"
+expect=""
+actual=$(PATH=$path KSH_PLUGININDEX=$index $SHELL -c 'nosample; grep libsample /proc/$$/maps' 2>&1)
+[[ ! -e /proc/$$/maps || $actual == "$expect" ]] ||
+    log_error "the index does not keep a library without the builtin from being loaded" \
+    "$expect" "$actual"
@@ -0,0 +1,96 @@
+# Tests for the sampling profiler enabled by KSH_PROFILE
+
+unset KSH_PROFILE
+
+profile=$TEST_DIR/profile
+sleep=$(whence -p sleep)
+cat > "$TEST_DIR/script" <<EOF2
+function busy {
+    typeset i=0
+    while ((i < 100000)); do
+        ((i++))
+    done
+}
+function outer {
+    busy
+    $sleep 0.2
+}
+outer
+EOF2
+
+# ==========
+# The stacks of functions are written in the folded format.
+KSH_PROFILE=$profile $SHELL "$TEST_DIR/script"
+[[ -f $profile ]] || log_error "the profile is not written"
+expect="$TEST_DIR/script;outer;busy [0-9]*"
+actual=$(grep ';busy ' "$profile")
+[[ $actual == $expect ]] || log_error "the stack of a function is wrong" "$expect" "$actual"
+[[ $(grep -cv '^[^ ].* [1-9][0-9]*$' "$profile") == 0 ]] ||
+    log_error "the profile has lines that are not folded stacks" "" "$(<$profile)"
+
+# Time spent waiting for a command is recorded apart from shell CPU time.
+actual=$(grep ';\[wait\] ' "$profile")
+expect="$TEST_DIR/script;outer;\[wait\] [0-9]*"
+[[ $actual == $expect ]] || log_error "waiting is not recorded" "$expect" "$actual"
+(( ${actual##* } >= 150 )) || log_error "the time spent waiting is too short" ">= 150" \
+    "${actual##* }"
+
+# ==========
+# A table of samples for each line is written next to the profile.
+[[ -f $profile.lines ]] || log_error "the line table is not written"
+expect="*cpu*wait*line*"
+actual=$(head -1 "$profile.lines")
+[[ $actual == $expect ]] || log_error "the line table has no header" "$expect" "$actual"
+expect="*[1-9]*0  $TEST_DIR/script:4 busy"
+actual=$(grep ':4 busy$' "$profile.lines")
+[[ $actual == $expect ]] || log_error "the line table has no entry for a busy line" "$expect" \
+    "$actual"
+expect="*0*[1-9]*  $TEST_DIR/script:9 outer"
+actual=$(grep ':9 outer$' "$profile.lines")
+[[ $actual == $expect ]] || log_error "the line table has no entry for a wait" "$expect" "$actual"
+
+# ==========
+# A POSIX function and a file read with `.` are frames of their own.
+print 'i=0; while ((i < 100000)); do ((i++)); done' > "$TEST_DIR/dotfile"
+rm -f "$profile"
+KSH_PROFILE=$profile $SHELL -c "pf() { . '$TEST_DIR/dotfile'; }; function kf { pf; }; kf"
+expect="*;kf;pf;$TEST_DIR/dotfile [0-9]*"
+actual=$(<$profile)
+[[ $actual == $expect ]] || log_error "the frames of POSIX functions or . are wrong" "$expect" \
+    "$actual"
+
+# ==========
+# A script run by a relative pathname is named by its full pathname in every stack and line, also
+# for the time used by its last command.
+cat > "$TEST_DIR/last" <<\EOF2
+function busy {
+    typeset i=0
+    while ((i < 100000)); do ((i++)); done
+}
+busy
+print {1..100000} > /dev/null
+EOF2
+rm -f "$profile"
+(cd "$TEST_DIR" && KSH_PROFILE=$profile $SHELL last)
+actual=$(grep -v "^$TEST_DIR/last[; ]" "$profile")
+[[ $actual ]] && log_error "a root frame is not the pathname of the script" "" "$actual"
+expect="*[1-9]*0  $TEST_DIR/last:6"
+actual=$(grep ':6$' "$profile.lines")
+[[ $actual == $expect ]] || log_error "the last command of a script is not charged to its line" \
+    "$expect" "$(<$profile.lines)"
+
+# ==========
+# The profiler doesn't get in the way of traps and exec.
+rm -f "$profile"
+expect=bye
+actual=$(KSH_PROFILE=$profile $SHELL -c 'trap "print bye" EXIT; trap "" PROF
+    i=0; while ((i < 100000)); do ((i++)); done' 2>&1)
+[[ $actual == "$expect" ]] || log_error "an EXIT trap fails with the profiler" "$expect" "$actual"
+[[ -s $profile ]] || log_error "the profile is not written when there is an EXIT trap"
+
+rm -f "$profile"
+KSH_PROFILE=$profile $SHELL -c 'i=0; while ((i < 10000)); do ((i++)); done
+    exec env -u KSH_PROFILE '"$SHELL"' -c "i=0; while ((i < 200000)); do ((i++)); done"'
+actual=$?
+[[ $actual == 0 ]] || log_error "the profiling timer is left set after exec" 0 "$actual"
+[[ -s $profile ]] || log_error "the profile is not written before exec"
@@ -477,3 +477,27 @@ esac
 
 unset IFS
 [[  ${IFS+abc} ]] && log_error "testing for unset IFS not working"
+
+# ==========
+# Words made only of text, double quotes and simple parameters expand the same way every time they
+# are run.
+cd "$TEST_DIR" || exit
+touch ab.c ab.h 'a*'
+a=ab b='x y' c='*' d='a\*'
+expect=$'<ab.c> <ab.h> <ab.c> <ab.h>\n<x> <y> <x y> <x y1>\n<a*> <ab.c> <ab.h> <*> <a*> <a\\*>\n<ab.[ch]> <ab.c> <ab.h> <ab>\n<x-y> <z> <x-y-z> <x> <y> <z>'
+for i in 1 2
+do
+    actual=$(
+        printf '<%s> ' $a.* ${a}.[ch]; print
+        printf '<%s> ' $b$1 "$b$1" "$b"1; print
+        printf '<%s> ' a$c "$c" "a$c" $d; print
+        printf '<%s> ' "$a.[ch]" $a".c" $a'.h' ${a}; print
+        IFS=-; set -- 'x-y' z; printf '<%s> ' "$1" $2 "$*" $@; print
+    )
+    actual=${actual// $'\n'/$'\n'}
+    actual=${actual% }
+    [[ $actual == "$expect" ]] || log_error "expansion of simple words differs on run $i" "$expect" "$actual"
+done
+set -f
+[[ $(print -r -- $a.*) == 'ab.*' ]] || log_error 'set -f is ignored for simple words' 'ab.*' "$(print -r -- $a.*)"
+set +f
@@ -0,0 +1,67 @@
+# Tests for the counters of .sh.stats and the statistics written to KSH_STATS
+
+unset KSH_STATS
+
+# ==========
+# Waits, here-documents and regular expression compilations are counted.
+actual=$($SHELL -c '
+    w=${.sh.stats.waits} h=${.sh.stats.heredocs} r=${.sh.stats.regcomps}
+    /bin/true
+    read x <<-END
+	hello
+	END
+    [[ abc =~ ^a.c$ ]]
+    print $(( ${.sh.stats.waits} > w )) $(( ${.sh.stats.heredocs} - h )) \
+        $(( ${.sh.stats.regcomps} > r ))')
+expect="1 1 1"
+[[ $actual == "$expect" ]] || log_error "new .sh.stats counters are wrong" "$expect" "$actual"
+
+# ==========
+# Unsetting .sh.stats resets the counters.
+actual=$($SHELL -c '/bin/true; /bin/true; unset .sh.stats
+    print ${.sh.stats.forks} ${.sh.stats.waits}')
+expect="0 0"
+[[ $actual == "$expect" ]] || log_error "unset .sh.stats does not reset the counters" \
+    "$expect" "$actual"
+actual=$($SHELL -c 'unset .sh.stats; /bin/true; print $(( ${.sh.stats.waits} > 0 ))')
+expect="1"
+[[ $actual == "$expect" ]] || log_error ".sh.stats does not count after a reset" "$expect" "$actual"
+
+# ==========
+# KSH_STATS gets a line of JSON for each shell that exits.
+file=$TEST_DIR/stats.json
+KSH_STATS=$file $SHELL -c '/bin/true; x=$(/bin/true); ( /bin/true )' ||
+    log_error "KSH_STATS breaks the shell"
+[[ -f $file ]] || log_error "KSH_STATS file is not written"
+actual=$(<$file)
+[[ $actual == '{"pid":'+([0-9])',"name":'*',"counters":{'*'}}' ]] ||
+    log_error "KSH_STATS line is not a JSON object" "{\"pid\":...}" "$actual"
+for key in forks spawns waits heredocs regcomps
+do
+    [[ $actual == *"\"$key\":"+([0-9])* ]] || log_error "KSH_STATS lacks the $key counter" \
+        "\"$key\":" "$actual"
+done
+for key in fork spawn wait comsub subshell pathsearch regcomp heredoc
+do
+    expect="\"$key\":{\"count\":+([0-9]),\"total\":+([0-9]),\"max\":+([0-9]),\"buckets\":\\["
+    [[ $actual == *$expect* ]] ||
+        log_error "KSH_STATS lacks the $key histogram" "\"$key\":{\"count\":..." "$actual"
+done
+[[ $actual == *'"wait":{"count":'[1-9]* ]] || log_error "waits are not timed" \
+    '"wait":{"count":N' "$actual"
+
+KSH_STATS=$file $SHELL -c ':'
+actual=$(wc -l < "$file")
+(( actual == 2 )) || log_error "KSH_STATS lines are not appended" 2 "$actual"
+
+# ==========
+# A shell that is replaced by exec writes its statistics first.
+rm -f "$file"
+KSH_STATS=$file $SHELL -c 'x=$(echo hi); exec /bin/true'
+[[ -f $file ]] || log_error "KSH_STATS file is not written before exec"
+
+# But only once if the exec fails.
+rm -f "$file"
+KSH_STATS=$file $SHELL -c 'exec /nonexistent/command' 2> /dev/null
+actual=$(wc -l < "$file")
+(( actual == 1 )) || log_error "KSH_STATS line is written more than once" 1 "$actual"
@@ -526,6 +526,20 @@ chmod +x $TEST_DIR/script
 )
 TIMEFORMAT='this is a test'
 [[ $({ { time :;} 2>&1;}) == "$TIMEFORMAT" ]] || log_error 'TIMEFORMAT not working'
+TIMEFORMAT='%M %f %F %I %O %w %c'
+actual=$({ { time /bin/true;} 2>&1;})
+[[ $actual == +([0-9]){6}( +([0-9])) ]] || log_error 'TIMEFORMAT resource counters not working' \
+    "seven numbers" "$actual"
+actual=$(TIMEFORMAT=%M; { { time :;} 2>&1;})
+[[ $actual == 0 ]] || log_error 'TIMEFORMAT %M counts children that were not timed' "0" "$actual"
+actual=$(KSH_XTRACEFORMAT='+ usage %3R %M' PS4='+ ' $SHELL -xc ': one; : two' 2>&1)
+expect=$'+ : one\n+ usage +([0-9]).[0-9][0-9][0-9] 0\n+ : two\n+ usage +([0-9]).[0-9][0-9][0-9] 0'
+[[ $actual == $expect ]] || log_error 'KSH_XTRACEFORMAT does not annotate traced commands' \
+    "$expect" "$actual"
+actual=$(PS4='+ ' $SHELL -xc ': one' 2>&1)
+[[ $actual == '+ : one' ]] || log_error 'xtrace is annotated without KSH_XTRACEFORMAT' \
+    '+ : one' "$actual"
+unset TIMEFORMAT
 : ${.sh.version}
 [[ $(alias integer) == *.sh.* ]] && log_error '.sh. prefixed to alias name'
 : ${.sh.version}
@@ -831,3 +845,11 @@ actual="${.sh.file}"
 actual="$(pwd -f ${.sh.pwdfd})"
 expect="$PWD"
 [[ "$actual" = "$expect" ]] || log_error ".sh.pwdfd should point to fd of current working directory"
+
+# ==========
+# Short values replacing values of about the same length reuse the old buffer.
+actual=$($SHELL -c 'a=abcdef; n=${.sh.stats.nv_strreuse}
+a=xyz; a=${a}w; a=${a:1}; typeset -R4 r=abcdef; r=xy; typeset -L3 l=abcd; l=z
+print -r -- "$a|$r|$l|$(( ${.sh.stats.nv_strreuse} > n ))"')
+expect='yzw|  xy|z  |1'
+[[ $actual == "$expect" ]] || log_error "values replaced in place are wrong" "$expect" "$actual"
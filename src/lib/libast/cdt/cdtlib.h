@@ -46,12 +46,16 @@
 #define uchar unsigned char
 #endif
 
+struct _dtvcache_s;
+
 /* This struct holds private method data created on DT_OPEN */
 struct _dtdata_s {
     pthread_mutex_t lock; /* general dictionary lock    */
     unsigned int type;    /* method type, control flags */
     ssize_t size;         /* number of objects          */
     Dtuser_t user;        /* application's data         */
+    unsigned int version; /* changes with each change   */
+    struct _dtvcache_s *vcache; /* lookups through the view */
     Dt_t dict;            /* when DT_INDATA is requested        */
 };
 
@@ -116,4 +120,11 @@ static inline void DTANNOUNCE(Dt_t *dt, void *object, int type) {
 extern Dtlink_t *_dtmake(Dt_t *, void *, int);
 extern void _dtfree(Dt_t *, Dtlink_t *, int);
 
+/* the version of a dictionary changes whenever its objects, discipline or view change, see dtview.c */
+#define DT_CHANGES                                                                         \
+    (DT_INSERT | DT_APPEND | DT_DELETE | DT_ATTACH | DT_DETACH | DT_REMOVE | DT_INSTALL | \
+     DT_RELINK | DT_CLEAR | DT_EXTRACT | DT_RESTORE)
+#define DTCHANGED(dt, type) ((type)&DT_CHANGES ? (void)((dt)->data->version += 1) : (void)0)
+extern void _dtvclose(Dt_t *);
+
 #endif  // _CDTLIB_H
@@ -54,6 +54,7 @@ int dtclose(Dt_t *dt) {
         dtview(dt, NULL);
     }
 
+    _dtvclose(dt);
     type = dt->data->type; /* save before memory is freed */
     memcpy(&pdt, dt, sizeof(Dt_t));
 
@@ -24,6 +24,7 @@
 #include <stdlib.h>
 
 #include "cdt.h"
+#include "cdtlib.h"
 
 /*      Change discipline.
 **      dt :    dictionary
@@ -72,6 +73,7 @@ Dtdisc_t *dtdisc(Dt_t *dt, Dtdisc_t *disc, int type) {
 
     dt->disc = disc;
     if (!(dt->memoryf = disc->memoryf)) dt->memoryf = dtmemory;
+    if (dt->data) dt->data->version += 1;
 
     if (list) { /* reinsert extracted objects (with new discipline) */
         dtrestore(dt, list);
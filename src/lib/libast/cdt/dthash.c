@@ -254,6 +254,7 @@ static_fn void *dthashchain(Dt_t *dt, void *obj, int type) {
     Dthash_t *hash = (Dthash_t *)dt->data;
 
     if (!(type & DT_OPERATIONS)) return NULL;
+    DTCHANGED(dt, type);
 
     DTSETLOCK(dt);
 
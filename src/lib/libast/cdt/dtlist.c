@@ -143,6 +143,7 @@ static_fn void *dtlist(Dt_t *dt, void *obj, int type) {
     Dtlist_t *list = (Dtlist_t *)dt->data;
 
     if (!(type & DT_OPERATIONS)) return NULL;
+    DTCHANGED(dt, type);
 
     DTSETLOCK(dt);
 
@@ -61,6 +61,9 @@ Dtmethod_t *dtmethod(Dt_t *dt, Dtmethod_t *meth) {
     dt->meth = oldmt;
     dt->data = olddt;
     if (newdt) {  // switch was successful, remove old data
+        newdt->version = olddt->version + 1;
+        newdt->vcache = olddt->vcache;
+        olddt->vcache = NULL;
         (void)(*dt->meth->eventf)(dt, DT_CLOSE, NULL);
 
         if (dt->searchf == oldmt->searchf) dt->searchf = meth->searchf;
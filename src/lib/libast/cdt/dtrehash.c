@@ -440,6 +440,7 @@ static_fn void *dthashtrie(Dt_t *dt, void *obj, int type) {
     uint share = hash->data.type & DT_SHARE;
 
     if (!(type & DT_OPERATIONS) || !hash->root) return NULL;
+    DTCHANGED(dt, type);
 
     /* wipe cached data as they may become stale after these ops */
     if (type & (H_INSERT | H_DELETE | DT_CLEAR)) fngr->here = NULL;
@@ -384,6 +384,7 @@ static_fn void *dttree(Dt_t *dt, void *obj, int type) {
     Dttree_t *tree = (Dttree_t *)dt->data;
 
     if (!(type & DT_OPERATIONS)) return NULL;
+    DTCHANGED(dt, type);
 
     DTSETLOCK(dt);
 
@@ -22,8 +22,10 @@
 #include "config_ast.h"  // IWYU pragma: keep
 
 #include <stddef.h>
+#include <stdlib.h>
 
 #include "cdt.h"
+#include "cdtlib.h"
 
 /*      Set a view path from dict to view.
 **
@@ -35,6 +37,92 @@
     (DT_INSERT | DT_APPEND | DT_DELETE | DT_ATTACH | DT_DETACH | DT_RELINK | DT_CLEAR | \
      DT_FLATTEN | DT_EXTRACT | DT_RESTORE | DT_STAT)
 
+/* The objects found by DT_MATCH and DT_SEARCH through a view path are remembered by the dictionary
+** at the start of the path, along with the dictionaries of the path and their versions. An entry is
+** used only while none of those dictionaries has changed, so a lookup costs one hash, a check of
+** the path and one comparison however many dictionaries it has to pass. Changes to dictionaries
+** that are not on the path leave the entries alone.
+*/
+#define DTV_CACHE 64 /* number of entries, a power of two */
+#define DTV_DEPTH 4  /* longest view path remembered */
+
+typedef struct _dtvent_s {
+    Dt_t *path[DTV_DEPTH + 1];      /* the view path, ending with NULL */
+    unsigned int version[DTV_DEPTH]; /* the version of each dictionary on it */
+    Dt_t *found;                    /* dictionary holding the object */
+    void *obj;                      /* the object */
+} Dtvent_t;
+
+struct _dtvcache_s {
+    Dtvent_t ent[DTV_CACHE];
+};
+
+static_fn Dtvent_t *dtvcache(Dt_t *dt, void *key) {
+    Dtdisc_t *disc = dt->disc;
+    Dt_t *d;
+    unsigned int h;
+    int n;
+
+    if (!key) return NULL;
+    for (n = 0, d = dt; d; d = d->view, n++) {
+        if (n == DTV_DEPTH || (d->data->type & DT_SHARE)) return NULL;
+    }
+    if (disc->hashf) {
+        h = (*disc->hashf)(dt, key, disc);
+    } else if (disc->size > 0 && disc->comparf) { /* the key may not be addressable */
+        return NULL;
+    } else {
+        h = dtstrhash(0, (char *)key, disc->size);
+    }
+    if (!dt->data->vcache && !(dt->data->vcache = calloc(1, sizeof(struct _dtvcache_s)))) {
+        return NULL;
+    }
+    return &dt->data->vcache->ent[h & (DTV_CACHE - 1)];
+}
+
+static_fn void *dtvlookup(Dt_t *dt, void *obj, int type) {
+    Dtvent_t *vc;
+    Dt_t *d;
+    void *o, *key = (type & DT_MATCH) ? obj : _DTKEY(dt->disc, obj);
+    int n;
+
+    if ((vc = dtvcache(dt, key))) {
+        for (d = dt, n = 0; d == vc->path[n]; d = d->view, n++) {
+            if (!d) {
+                d = vc->found;
+                if (_DTCMP(d, key, _DTKEY(d->disc, vc->obj), d->disc) != 0) break;
+                dt->walk = d;
+                return vc->obj;
+            }
+            if (d->data->version != vc->version[n]) break;
+        }
+    }
+
+    o = NULL;
+    for (d = dt; d; d = d->view) {
+        if ((o = (*(d->meth->searchf))(d, obj, type))) break;
+    }
+    dt->walk = d;
+    if (o && vc) {
+        for (d = dt, n = 0; d; d = d->view, n++) {
+            vc->path[n] = d;
+            vc->version[n] = d->data->version;
+        }
+        vc->path[n] = NULL;
+        vc->found = dt->walk;
+        vc->obj = o;
+    }
+    return o;
+}
+
+/* free the lookups remembered by dt when it is closed */
+void _dtvclose(Dt_t *dt) {
+    if (dt->data) {
+        free(dt->data->vcache);
+        dt->data->vcache = NULL;
+    }
+}
+
 static_fn void *dtvsearch(Dt_t *dt, void *obj, int type) {
     int cmp;
     Dt_t *d, *p;
@@ -44,10 +132,10 @@ static_fn void *dtvsearch(Dt_t *dt, void *obj, int type) {
 
     o = NULL;
 
+    if (type & (DT_MATCH | DT_SEARCH)) return dtvlookup(dt, obj, type);
+
     /* these ops look for the first appearance of an object of the right type */
-    if ((type & (DT_MATCH | DT_SEARCH)) ||
-        ((type & (DT_FIRST | DT_LAST | DT_ATLEAST | DT_ATMOST)) &&
-         !(dt->meth->type & DT_ORDERED))) {
+    if ((type & (DT_FIRST | DT_LAST | DT_ATLEAST | DT_ATMOST)) && !(dt->meth->type & DT_ORDERED)) {
         for (d = dt; d; d = d->view) {
             if ((o = (*(d->meth->searchf))(d, obj, type))) break;
         }
@@ -132,6 +220,9 @@ Dt_t *dtview(Dt_t *dt, Dt_t *view) {
         if (d == dt) return NULL;
     }
 
+    /* lookups remembered through the old view path are no longer valid */
+    dt->data->version += 1;
+
     /* no more viewing lower dictionary */
     if ((d = dt->view)) d->nview -= 1;
     dt->view = dt->walk = NULL;
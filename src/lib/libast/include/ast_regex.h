@@ -28,6 +28,7 @@
 #undef regex_t
 #undef regmatch_t
 
+#include <stdint.h>
 #include <wchar.h>
 
 #define REG_VERSION 20100930L
@@ -199,6 +200,8 @@ extern int regrexec(const regex_t *, const char *, size_t, size_t, regmatch_t *,
                     void *, regrecord_t);
 extern regstat_t *regstat(const regex_t *);
 extern regex_t *regcache(const char *, regflags_t, int *);
+// If set, regcache() calls this with a pattern it compiled and the nanoseconds that took.
+extern void (*regcache_compiled)(const char *, uint64_t);
 extern int regsubflags(regex_t *, const char *, char **, int, const regflags_t *, int *,
                        regflags_t *);
 extern void regsubfree(regex_t *);
@@ -25,6 +25,10 @@
 #ifndef _SHCMD_H
 #define _SHCMD_H 1
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
 #define SH_PLUGIN_VERSION 20111111L
 
 // #define SHLIB(m)
@@ -45,8 +49,64 @@ struct Shbltin_s {
     int flags;
     int invariant;
     int pwdfd;
+    const struct Shapi_s *api;  // see below
 };
 
+//
+// Variable access for plugins. The shell passes a table of these functions in the `api` member
+// of the context of a builtin. Its `version` is SH_API_VERSION of the shell; members are only
+// ever added at the end and a plugin must not use one the version it sees doesn't have.
+//
+// Array functions work on the current element of an array, which is chosen by (*select)() or by
+// (*next)(), the same way `name[sub]` picks the element a shell expansion or assignment uses.
+// Numbers are read and stored without going through strings when the variable has a numeric
+// type. Strings returned by (*borrow)() are the value itself and stay valid until the variable is
+// changed or the builtin calls back into the shell.
+//
+#define SH_API_VERSION 1
+
+// Flags for (*open)(), (*member)() and (*select)().
+#define SH_API_CREATE 0x1   // create the variable or element if it doesn't exist
+#define SH_API_INDEXED 0x2  // make a new variable an indexed array
+#define SH_API_ASSOC 0x4    // make a new variable an associative array
+
+// Values returned by (*kind)(). SH_API_NUMERIC is or'ed in for numeric types.
+#define SH_API_UNSET 0
+#define SH_API_SCALAR 1
+#define SH_API_ARRAY 2
+#define SH_API_MAP 3
+#define SH_API_COMPOUND 4
+#define SH_API_NUMERIC 0x10
+
+// State of a walk over the elements of an array. Start with {.array = np} and call (*next)() until
+// it returns false. The array must not be changed other than through the current element while
+// it is walked.
+typedef struct Shapi_iter_s {
+    Namval_t *array;  // the array
+    Namval_t *node;   // the current element; a compound element has a node of its own
+    const char *sub;  // its subscript, valid until the next call
+    long index;       // its index, or -1 in an associative array
+} Shapi_iter_t;
+
+typedef struct Shapi_s {
+    unsigned long version;
+    Namval_t *(*open)(Shell_t *, const char *, int);
+    Namval_t *(*member)(Namval_t *, const char *, int);
+    int (*kind)(Namval_t *);
+    long (*count)(Namval_t *);
+    bool (*next)(Shapi_iter_t *);
+    bool (*select)(Namval_t *, const char *, long, int);
+    const char *(*borrow)(Namval_t *, size_t *);
+    bool (*getint)(Namval_t *, int64_t *);
+    bool (*getnum)(Namval_t *, double *);
+    void (*putstr)(Namval_t *, const char *);
+    void (*putint)(Namval_t *, int64_t);
+    void (*putnum)(Namval_t *, double);
+    long (*append)(Namval_t *, const char *const *, size_t);
+    long (*appendint)(Namval_t *, const int64_t *, size_t);
+    long (*appendnum)(Namval_t *, const double *, size_t);
+} Shapi_t;
+
 // The following symbols used to have a `sh_` prefix and were meant to mask the functions of the
 // same name when used in a builtin (e.g., code in src/lib/libcmd). That has been changed because
 // that sort or redirection obfuscates what is actually happening and makes reasoning about the
@@ -43,6 +43,7 @@
 
 #include "ast.h"
 #include "ast_assert.h"
+#include "sfhdr.h"
 #include "sfio.h"
 #include "stk.h"
 
@@ -81,6 +82,10 @@
 #define STK_FSIZE 4096
 #endif
 
+// The first frame of a STK_SMALL stack. Such stacks hold the parse tree of a single function or
+// the state of a single regular expression match, which rarely need a whole page.
+#define STK_SMALLSIZE 1024
+
 #define STK_HDRSIZE (sizeof(Sfio_t) + sizeof(Sfdisc_t))
 
 typedef char *(*_stk_overflow_)(int);
@@ -237,8 +242,12 @@ Sfio_t *stkopen(int flags) {
     } else {
         sp->stkoverflow = stkcur ? stkcur->stkoverflow : overflow;
     }
-    bsize = init + sizeof(struct frame);
-    bsize = roundof(bsize, STK_FSIZE);
+    if ((flags & STK_SMALL) && init <= 1) {
+        bsize = STK_SMALLSIZE;
+    } else {
+        bsize = init + sizeof(struct frame);
+        bsize = roundof(bsize, STK_FSIZE);
+    }
     fp = calloc(1, bsize);
     if (!fp) {
         free(stream);
@@ -251,6 +260,17 @@ Sfio_t *stkopen(int flags) {
     fp->end = sp->stkend = cp + bsize;
     if (!sfnew(stream, cp, bsize, -1, SF_STRING | SF_WRITE | SF_STATIC | SF_EOF)) return NULL;
     sfdisc(stream, dp);
+    // A stack never needs syncing, so take it back out of the pool it was just appended to. Stacks
+    // are opened and closed for every function definition and there can be thousands of them, which
+    // would otherwise make each sfsync(NULL) and sfclose() walk all of them.
+    if (stream->pool == &_Sfpool) {
+        POOLMTXLOCK(&_Sfpool);
+        if (_Sfpool.n_sf > 0 && _Sfpool.sf[_Sfpool.n_sf - 1] == stream) {
+            _Sfpool.n_sf -= 1;
+            stream->pool = NULL;
+        }
+        POOLMTXUNLOCK(&_Sfpool);
+    }
     return stream;
 }
 
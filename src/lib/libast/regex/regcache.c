@@ -26,8 +26,10 @@
 #include "config_ast.h"  // IWYU pragma: keep
 
 #include <locale.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "ast.h"
 #include "ast_regex.h"
@@ -55,6 +57,15 @@ typedef struct State_s {
 
 static State_t matchstate;
 
+void (*regcache_compiled)(const char *, uint64_t);
+
+static_fn uint64_t regex_clock(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
 /*
  * flush the cache
  */
@@ -82,6 +93,7 @@ regex_t *regcache(const char *pattern, regflags_t reflags, int *status) {
     int unused;
     int old;
     Key_t key;
+    uint64_t start;
 
     /*
      * 0 pattern flushes the cache and reflags>0 extends cache
@@ -169,7 +181,9 @@ regex_t *regcache(const char *pattern, regflags_t reflags, int *status) {
         strcpy(cp->pattern, pattern);
         while (++i < sizeof(Key_t)) cp->pattern[i] = 0;
         pattern = (const char *)cp->pattern;
+        start = regcache_compiled ? regex_clock() : 0;
         i = regcomp(&cp->re, pattern, reflags);
+        if (regcache_compiled) (*regcache_compiled)(pattern, regex_clock() - start);
         if (i) {
             if (status) *status = i;
             return NULL;
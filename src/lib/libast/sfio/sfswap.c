@@ -21,6 +21,7 @@
  ***********************************************************************/
 #include "config_ast.h"  // IWYU pragma: keep
 
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -38,6 +39,7 @@
 Sfio_t *sfswap(Sfio_t *f1, Sfio_t *f2) {
     Sfio_t tmp;
     int f1pool, f2pool, f1mode, f2mode, f1flags, f2flags;
+    bool samepool;
 
     if (!f1 || (f1->mode & SF_AVAIL) || (SFFROZEN(f1) && (f1->mode & SF_PUSH))) return NULL;
     if (f2 && SFFROZEN(f2) && (f2->mode & SF_PUSH)) return NULL;
@@ -67,14 +69,19 @@ Sfio_t *sfswap(Sfio_t *f1, Sfio_t *f2) {
         f2mode = SF_AVAIL;
     }
 
-    if (!f1->pool) {
+    /* Streams that are both in the default pool stay members after the swap and the
+    ** order of that pool does not matter, so don't bother finding their slots. This
+    ** keeps stack switches O(1) when many stacks are open.
+    */
+    samepool = f1->pool == &_Sfpool && f2->pool == &_Sfpool;
+    if (!f1->pool || samepool) {
         f1pool = -1;
     } else {
         for (f1pool = f1->pool->n_sf - 1; f1pool >= 0; --f1pool) {
             if (f1->pool->sf[f1pool] == f1) break;
         }
     }
-    if (!f2->pool) {
+    if (!f2->pool || samepool) {
         f2pool = -1;
     } else {
         for (f2pool = f2->pool->n_sf - 1; f2pool >= 0; --f2pool) {
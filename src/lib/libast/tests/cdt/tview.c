@@ -29,6 +29,9 @@ Dtdisc_t Disc = {0, sizeof(long), -1, newint, NULL, compare, hashint, NULL, NULL
 
 static int Count, See[10];
 
+static Dtmethod_t **Methods[] = {&Dtset, &Dtbag,   &Dtoset,  &Dtobag,  &Dtlist,
+                                 &Dtstack, &Dtqueue, &Dtdeque, &Dtrhset, &Dtrhbag};
+
 static int visit(Dt_t *dt, void *obj, void *data) {
     UNUSED(dt);
     UNUSED(data);
@@ -94,6 +97,51 @@ tmain() {
     if ((long)dtatmost(dt1, 9L) != 8L) terror("dtatmost failed on an order set");
     if ((long)dtatleast(dt1, 9L) != 10L) terror("dtatleast failed on an order set");
 
+    /* lookups through the view path see every change to the dictionaries on it */
+    for (k = 0; k < 2; ++k) {
+        if ((long)dtsearch(dt1, 7L) != 7L || dt1->walk != dt3) {
+            terror("Should find 7 in dt3");
+        }
+    }
+    dtinsert(dt2, 7L);
+    if ((long)dtsearch(dt1, 7L) != 7L || dt1->walk != dt2) terror("Should find 7 in dt2");
+    dtdelete(dt2, 7L);
+    dtdelete(dt3, 7L);
+    if (dtsearch(dt1, 7L)) terror("7 should be gone");
+    dtinsert(dt3, 7L);
+    dtview(dt2, NULL);
+    if (dtsearch(dt1, 7L)) terror("7 should not be seen without dt3");
+    dtview(dt2, dt3);
+    if ((long)dtsearch(dt1, 7L) != 7L) terror("Should find 7 again");
+
+    /* the lookups of every method see objects that are deleted or cleared */
+    for (k = 0; k < (long)(sizeof(Methods) / sizeof(Methods[0])); ++k) {
+        Dt_t *top, *bot;
+        const char *name = (*Methods[k])->name;
+
+        if (!(top = dtopen(&Disc, *Methods[k])) || !(bot = dtopen(&Disc, *Methods[k]))) {
+            terror("Opening %s", name);
+        }
+        dtview(top, bot);
+        dtinsert(bot, 5L);
+        for (i = 0; i < 2; ++i) {
+            if ((long)dtmatch(top, 5L) != 5L) terror("%s: should find 5 through the view", name);
+        }
+        dtdelete(bot, 5L);
+        if (dtmatch(top, 5L)) terror("%s: 5 was deleted", name);
+        dtinsert(bot, 5L);
+        if ((long)dtmatch(top, 5L) != 5L) terror("%s: should find 5 again", name);
+        dtclear(bot);
+        if (dtmatch(top, 5L)) terror("%s: 5 was cleared", name);
+        dtinsert(top, 5L);
+        if ((long)dtmatch(top, 5L) != 5L) terror("%s: 5 is on top", name);
+        dtdelete(top, 5L);
+        if (dtmatch(top, 5L)) terror("%s: 5 was deleted from the top", name);
+        dtview(top, NULL);
+        dtclose(top);
+        dtclose(bot);
+    }
+
     /* dt1: 1 3 5 2
        dt2: 2 4 6 3
        dt3: 2 7 6 8 10
@@ -20,6 +20,8 @@
 
 #include "config_ast.h"  // IWYU pragma: keep
 
+#include <string.h>
+
 #include "sfio.h"
 #include "stk.h"
 #include "terror.h"
@@ -71,5 +73,25 @@ tmain() {
         terror("stkclose() should return -1!");
     }
 
+    // Small stacks start with less than a page and grow as needed
+    Sfio_t *small[2000];
+    char *words[2000];
+    char big[3000];
+    memset(big, 'x', sizeof(big) - 1);
+    big[sizeof(big) - 1] = 0;
+    for (int i = 0; i < 2000; i++) {
+        small[i] = stkopen(STK_SMALL);
+        if (!small[i]) terror("stkopen(STK_SMALL) failed");
+        words[i] = stkcopy(small[i], i % 2 ? big : "small");
+    }
+    if (sfsync(NULL) < 0) terror("sfsync(NULL) failed with small stacks open");
+    for (int i = 0; i < 2000; i++) {
+        if (!stkon(small[i], words[i]) || strcmp(words[i], i % 2 ? big : "small")) {
+            terror("Small stack %d lost its contents", i);
+        }
+    }
+    for (int i = 1999; i >= 0; i -= 2) stkclose(small[i]);
+    for (int i = 0; i < 2000; i += 2) stkclose(small[i]);
+
     texit(0);
 }
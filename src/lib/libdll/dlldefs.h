@@ -92,6 +92,7 @@ typedef struct Dllscan_s {
     int prelen;
     int suflen;
     char **lib;
+    Sfio_t *dirs;  // if not NULL each directory searched is added on a line of its own
     char nam[64];
     char pat[64];
     char buf[64];
@@ -108,6 +109,8 @@ extern void *dlllook(void *, const char *);
 extern int dllcheck(void *, const char *, unsigned long, unsigned long *);
 extern unsigned long dllversion(void *, const char *);
 extern char *dllerror(int);
+extern int dllindex(const char *);
+extern int dllindexsym(const char *, const char *, const char *, unsigned long, const char *);
 
 extern Dllscan_t *dllsopen(const char *, const char *, const char *);
 extern Dllent_t *dllsread(Dllscan_t *);
@@ -0,0 +1,433 @@
+//
+// Plugin index.
+//
+// dllplugin() finds a library by looking in the sibling directories of the $PATH directories,
+// which costs a lookup or a directory read for each of them, and loads each candidate to check its
+// plugin version. When an index file is set with dllindex() the outcome of each search is kept in
+// it: the library that was found, its plugin version, the b_* symbols it exports, and the
+// modification times of the directories the search looked in and of the library itself. A later
+// search with the same arguments and the same $PATH goes straight to the library as long as none
+// of those has changed. dllindexsym() uses the same entries to tell whether a library exports a
+// symbol without loading it.
+//
+// The index is a text file with one entry per line and tab separated fields:
+//
+//      lib name version release PATH library plugin-version symbols count {mtime pathname}...
+//
+// The first pathname of an entry is the library. A missing file has an mtime of -1. The file is
+// not used unless it is owned by the user and writable only by the user. It is replaced by renaming
+// a new copy into place, which is only done in a directory that is owned by the user.
+//
+#include "config_ast.h"  // IWYU pragma: keep
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if _hdr_elf
+#include <elf.h>
+#endif
+
+#include "ast.h"
+#include "dlldefs.h"
+#include "dlllib.h"
+#include "sfio.h"
+#include "tv.h"
+
+#define INDEX_MAGIC "#dllindex 1"
+
+typedef struct Dllindexent_s {
+    struct Dllindexent_s *next;
+    char *key;              // lib, name, version, release and PATH
+    char *path;             // the library
+    unsigned long version;  // its plugin version
+    char *syms;             // the b_* symbols it exports, each followed by a space, or NULL
+    char *files;            // the mtime and pathname of each file the entry depends on
+} Dllindexent_t;
+
+static struct {
+    char *file;             // index file or NULL
+    bool loaded;            // entries have been read from the file
+    Dllindexent_t *entries;
+} ix;
+
+//
+// Return the modification time of <path> in the form used in the index.
+//
+static void filetime(const char *path, char *buf, size_t size) {
+    struct stat statb;
+
+    if (stat(path, &statb) < 0) {
+        sfsprintf(buf, size, "-1");
+    } else {
+        sfsprintf(buf, size, "%lld.%09ld", (long long)statb.st_mtime,
+                  (long)ST_MTIME_NSEC_GET(&statb));
+    }
+}
+
+static void freeent(Dllindexent_t *ep) {
+    free(ep->key);
+    free(ep->path);
+    free(ep->syms);
+    free(ep->files);
+    free(ep);
+}
+
+static void indexclear(void) {
+    Dllindexent_t *ep;
+
+    while ((ep = ix.entries)) {
+        ix.entries = ep->next;
+        freeent(ep);
+    }
+    ix.loaded = false;
+}
+
+//
+// Set the index file. A NULL or empty <file> turns the index off.
+//
+int dllindex(const char *file) {
+    if (file && !*file) file = NULL;
+    if (file && ix.file && !strcmp(file, ix.file)) return 0;
+    if (!file && !ix.file) return 0;
+    indexclear();
+    free(ix.file);
+    ix.file = NULL;
+    if (file && !(ix.file = strdup(file))) return -1;
+    return 0;
+}
+
+static char *field(char **cp) {
+    char *s = *cp, *t;
+
+    if (!s) return NULL;
+    if ((t = strchr(s, '\t'))) {
+        *t++ = 0;
+    }
+    *cp = t;
+    return s;
+}
+
+//
+// Read the entries of the index file. Lines that can't be parsed are dropped.
+//
+static void indexload(void) {
+    Sfio_t *fp;
+    struct stat statb;
+    Dllindexent_t *ep, **last = &ix.entries;
+    char *line, *cp, *key[5], *path, *version, *syms;
+    int i;
+
+    ix.loaded = true;
+    if (!(fp = sfopen(NULL, ix.file, "r"))) return;
+    if (fstat(sffileno(fp), &statb) < 0 || statb.st_uid != geteuid() ||
+        (statb.st_mode & (S_IWGRP | S_IWOTH)) || !(line = sfgetr(fp, '\n', 1)) ||
+        strcmp(line, INDEX_MAGIC)) {
+        sfclose(fp);
+        return;
+    }
+    while ((line = sfgetr(fp, '\n', 1))) {
+        cp = line;
+        for (i = 0; i < 5; i++) key[i] = field(&cp);
+        path = field(&cp);
+        version = field(&cp);
+        syms = field(&cp);
+        field(&cp);  // the number of files, which is only there for the reader
+        if (!cp) continue;
+        if (!(ep = calloc(1, sizeof(Dllindexent_t)))) break;
+        ep->key = strdup(sfprints("%s\t%s\t%s\t%s\t%s", key[0], key[1], key[2], key[3], key[4]));
+        ep->path = strdup(path);
+        ep->version = strtoul(version, NULL, 10);
+        ep->syms = strcmp(syms, "?") ? strdup(syms) : NULL;
+        ep->files = strdup(cp);
+        if (!ep->key || !ep->path || !ep->files) {
+            freeent(ep);
+            break;
+        }
+        *last = ep;
+        last = &ep->next;
+    }
+    sfclose(fp);
+}
+
+//
+// Write the entries to a new copy of the index file and rename it into place. The copy gets a name
+// that can't be guessed and is created only if it doesn't exist yet, and nothing is written unless
+// the directory belongs to the user, so that nobody else can swap either file for a link.
+//
+static void indexsave(void) {
+    Sfio_t *fp;
+    Dllindexent_t *ep;
+    struct stat statb;
+    char *tmp;
+    int fd, n;
+    char *cp;
+
+    if (!(tmp = strdup(sfprints("%s.XXXXXX", ix.file)))) return;
+    cp = strrchr(tmp, '/');
+    if (cp == tmp) {
+        n = stat("/", &statb);
+    } else if (cp) {
+        *cp = 0;
+        n = stat(tmp, &statb);
+        *cp = '/';
+    } else {
+        n = stat(".", &statb);
+    }
+    if (n < 0 || statb.st_uid != geteuid() || (fd = mkostemp(tmp, O_CLOEXEC)) < 0) {
+        free(tmp);
+        return;
+    }
+    if (!(fp = sfnew(NULL, NULL, SF_UNBOUND, fd, SF_WRITE))) {
+        close(fd);
+        unlink(tmp);
+        free(tmp);
+        return;
+    }
+    sfprintf(fp, "%s\n", INDEX_MAGIC);
+    for (ep = ix.entries; ep; ep = ep->next) {
+        for (n = 0, cp = ep->files; (cp = strchr(cp, '\t')); cp++) n++;
+        sfprintf(fp, "%s\t%s\t%lu\t%s\t%d\t%s\n", ep->key, ep->path, ep->version,
+                 ep->syms ? ep->syms : "?", (n + 1) / 2, ep->files);
+    }
+    if (sfclose(fp) < 0 || rename(tmp, ix.file) < 0) unlink(tmp);
+    free(tmp);
+}
+
+//
+// Return the key for a search with these arguments in a buffer that must be freed, or NULL if the
+// search can't be indexed.
+//
+static char *indexkey(const char *lib, const char *name, const char *ver, unsigned long rel) {
+    const char *path = pathbin();
+
+    if (!name || strpbrk(name, "\t\n") || (lib && strpbrk(lib, "\t\n")) ||
+        (ver && strpbrk(ver, "\t\n")) || strpbrk(path, "\t\n")) {
+        return NULL;
+    }
+    return strdup(
+        sfprints("%s\t%s\t%s\t%lu\t%s", lib ? lib : "-", name, ver ? ver : "-", rel, path));
+}
+
+//
+// Return true if none of the files that entry <ep> depends on has changed.
+//
+static bool indexvalid(Dllindexent_t *ep) {
+    char *cp = ep->files, *mp, *tp;
+    char buf[64], name[PATH_MAX];
+    size_t m, n;
+
+    while (cp && *cp) {
+        mp = cp;
+        if (!(tp = strchr(mp, '\t'))) return false;
+        m = tp - mp;
+        cp = tp + 1;
+        tp = strchr(cp, '\t');
+        n = tp ? (size_t)(tp - cp) : strlen(cp);
+        if (n >= sizeof(name)) return false;
+        memcpy(name, cp, n);
+        name[n] = 0;
+        filetime(name, buf, sizeof(buf));
+        if (strlen(buf) != m || memcmp(buf, mp, m)) return false;
+        cp = tp ? tp + 1 : NULL;
+    }
+    return true;
+}
+
+//
+// Return the entry for a search with these arguments if none of the files it depends on has
+// changed.
+//
+static Dllindexent_t *indexfind(const char *lib, const char *name, const char *ver,
+                                unsigned long rel) {
+    Dllindexent_t *ep;
+    char *key;
+
+    if (!ix.file) return NULL;
+    if (!ix.loaded) indexload();
+    if (!(key = indexkey(lib, name, ver, rel))) return NULL;
+    for (ep = ix.entries; ep; ep = ep->next) {
+        if (!strcmp(ep->key, key)) break;
+    }
+    free(key);
+    return ep && indexvalid(ep) ? ep : NULL;
+}
+
+#if _hdr_elf
+
+#if __SIZEOF_POINTER__ == 8
+#define ELF_CLASS ELFCLASS64
+typedef Elf64_Ehdr Elf_Ehdr;
+typedef Elf64_Shdr Elf_Shdr;
+typedef Elf64_Sym Elf_Sym;
+#define ELF_ST_BIND ELF64_ST_BIND
+#else
+#define ELF_CLASS ELFCLASS32
+typedef Elf32_Ehdr Elf_Ehdr;
+typedef Elf32_Shdr Elf_Shdr;
+typedef Elf32_Sym Elf_Sym;
+#define ELF_ST_BIND ELF32_ST_BIND
+#endif
+
+static void *readat(int fd, off_t offset, size_t size) {
+    void *buf;
+
+    if (size > 64 * 1024 * 1024 || !(buf = malloc(size ? size : 1))) return NULL;
+    if (pread(fd, buf, size, offset) != (ssize_t)size) {
+        free(buf);
+        return NULL;
+    }
+    return buf;
+}
+
+//
+// Return the b_* functions defined in the dynamic symbol table of the library <path>, each
+// followed by a space, or NULL if the library can't be read. A library with a lib_init() function
+// may add builtins when it is loaded so its symbols don't tell what it provides.
+//
+static char *libsyms(const char *path) {
+    Elf_Ehdr eh;
+    Elf_Shdr *sh = NULL;
+    Elf_Sym *sym = NULL;
+    char *str = NULL, *name, *syms = NULL;
+    Sfio_t *sp = NULL;
+    size_t i, n, nsyms;
+    int fd;
+
+    if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) return NULL;
+    if (pread(fd, &eh, sizeof(eh), 0) != sizeof(eh) || memcmp(eh.e_ident, ELFMAG, SELFMAG) ||
+        eh.e_ident[EI_CLASS] != ELF_CLASS || eh.e_shentsize != sizeof(Elf_Shdr) ||
+        !(sh = readat(fd, eh.e_shoff, eh.e_shnum * sizeof(Elf_Shdr)))) {
+        goto done;
+    }
+    for (i = 0; i < eh.e_shnum && sh[i].sh_type != SHT_DYNSYM; i++) {
+        ;  // empty loop
+    }
+    if (i == eh.e_shnum || sh[i].sh_link >= eh.e_shnum || sh[i].sh_entsize != sizeof(Elf_Sym)) {
+        goto done;
+    }
+    n = sh[sh[i].sh_link].sh_size;
+    nsyms = sh[i].sh_size / sizeof(Elf_Sym);
+    if (!(sym = readat(fd, sh[i].sh_offset, sh[i].sh_size)) ||
+        !(str = readat(fd, sh[sh[i].sh_link].sh_offset, n)) || !n || str[n - 1] ||
+        !(sp = sfstropen())) {
+        goto done;
+    }
+    for (i = 0; i < nsyms; i++) {
+        if (sym[i].st_name >= n || sym[i].st_shndx == SHN_UNDEF) continue;
+        if (ELF_ST_BIND(sym[i].st_info) != STB_GLOBAL && ELF_ST_BIND(sym[i].st_info) != STB_WEAK) {
+            continue;
+        }
+        name = str + sym[i].st_name;
+        if (!strcmp(name, "lib_init")) goto done;
+        if (name[0] == 'b' && name[1] == '_' && !strpbrk(name, " \t\n")) sfprintf(sp, "%s ", name);
+    }
+    if ((name = sfstruse(sp))) syms = strdup(name);
+done:
+    if (sp) sfstrclose(sp);
+    free(str);
+    free(sym);
+    free(sh);
+    close(fd);
+    return syms;
+}
+
+#else
+
+static char *libsyms(const char *path) {
+    UNUSED(path);
+    return NULL;
+}
+
+#endif  // _hdr_elf
+
+//
+// Return the library recorded for a search with these arguments, and its plugin version in <ver>,
+// if nothing it depends on has changed.
+//
+const char *dllindexget(const char *lib, const char *name, const char *ver, unsigned long rel,
+                        unsigned long *version) {
+    Dllindexent_t *ep = indexfind(lib, name, ver, rel);
+
+    if (!ep) return NULL;
+    if (version) *version = ep->version;
+    return ep->path;
+}
+
+//
+// Record that a search with these arguments found <path> with plugin version <version> after it
+// looked in the directories listed one per line in <dirs>.
+//
+void dllindexput(const char *lib, const char *name, const char *ver, unsigned long rel,
+                 const char *path, unsigned long version, const char *dirs) {
+    Dllindexent_t *ep, **pp;
+    Sfio_t *sp;
+    const char *cp, *end;
+    char *key, *dir, *files;
+    char buf[64];
+
+    if (!ix.file || strpbrk(path, "\t\n")) return;
+    if (!ix.loaded) indexload();
+    if (!(key = indexkey(lib, name, ver, rel))) return;
+    if (!(sp = sfstropen())) {
+        free(key);
+        return;
+    }
+    filetime(path, buf, sizeof(buf));
+    sfprintf(sp, "%s\t%s", buf, path);
+    for (cp = dirs; cp && *cp; cp = end + 1) {
+        if (!(end = strchr(cp, '\n'))) break;
+        if (end == cp || memchr(cp, '\t', end - cp)) continue;
+        dir = sfprints("%.*s", (int)(end - cp), cp);
+        filetime(dir, buf, sizeof(buf));
+        sfprintf(sp, "\t%s\t%s", buf, dir);
+    }
+    files = sfstruse(sp);
+    for (pp = &ix.entries; (ep = *pp); pp = &ep->next) {
+        if (!strcmp(ep->key, key)) {
+            *pp = ep->next;
+            freeent(ep);
+            break;
+        }
+    }
+    if ((ep = calloc(1, sizeof(Dllindexent_t)))) {
+        ep->key = key;
+        ep->path = strdup(path);
+        ep->version = version;
+        ep->syms = libsyms(path);
+        ep->files = files ? strdup(files) : NULL;
+        if (ep->key && ep->path && ep->files) {
+            ep->next = ix.entries;
+            ix.entries = ep;
+            indexsave();
+        } else {
+            freeent(ep);
+        }
+    } else {
+        free(key);
+    }
+    sfstrclose(sp);
+}
+
+//
+// Return 1 if the library that dllplugin() would find for these arguments exports <sym>, 0 if it
+// does not, and -1 if the index can't tell.
+//
+int dllindexsym(const char *lib, const char *name, const char *ver, unsigned long rel,
+                const char *sym) {
+    Dllindexent_t *ep = indexfind(lib, name, ver, rel);
+    const char *cp;
+    size_t n = strlen(sym);
+
+    if (!ep || !ep->syms) return -1;
+    for (cp = ep->syms; (cp = strstr(cp, sym)); cp += n) {
+        if ((cp == ep->syms || cp[-1] == ' ') && cp[n] == ' ') return 1;
+    }
+    return 0;
+}
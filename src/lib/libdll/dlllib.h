@@ -33,4 +33,9 @@ typedef struct Dllstate_s {
 
 extern Dllstate_t state;
 
+extern const char *dllindexget(const char *, const char *, const char *, unsigned long,
+                               unsigned long *);
+extern void dllindexput(const char *, const char *, const char *, unsigned long, const char *,
+                        unsigned long, const char *);
+
 #endif  // _DLLLIB_H
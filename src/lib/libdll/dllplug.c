@@ -35,6 +35,8 @@
 // at least one dlopen() is called to initialize dlerror()
 // if path!=0 then library path up to size chars copied to path with trailing 0
 // if name contains a directory prefix then library search is limited to the dir and siblings
+// if an index was set by dllindex() then a library found by an earlier search is tried first
+// and the outcome of a search is added to the index
 //
 
 extern void *dllplugin(const char *lib, const char *name, const char *ver, unsigned long rel,
@@ -44,11 +46,24 @@ extern void *dllplugin(const char *lib, const char *name, const char *ver, unsig
     int hit;
     Dllscan_t *dls;
     Dllent_t *dle;
+    Sfio_t *dirs = NULL;
+    const char *arg = lib;
+    const char *ent;
+    unsigned long version;
 
+    if ((ent = dllindexget(lib, name, ver, rel, &version)) &&
+        (dll = dllopen(ent, flags | RTLD_GLOBAL | RTLD_PARENT))) {
+        if (dllcheck(dll, ent, rel, cur)) {
+            if (path && size) strlcpy(path, ent, size);
+            return dll;
+        }
+        dlclose(dll);
+    }
     err = hit = 0;
     for (;;) {
         dls = dllsopen(lib, name, ver);
         if (dls) {
+            if (lib == arg && !dirs) dls->dirs = dirs = sfstropen();
             while ((dle = dllsread(dls))) {
                 hit = 1;
 #if 0
@@ -63,6 +78,10 @@ extern void *dllplugin(const char *lib, const char *name, const char *ver, unsig
                         continue;
                     }
                     if (path && size) strlcpy(path, dle->path, size);
+                    if (dirs) {
+                        dllindexput(arg, name, ver, rel, dle->path, dllversion(dll, dle->path),
+                                    sfstruse(dirs));
+                    }
                     break;
                 } else {
 #if 0
@@ -95,6 +114,10 @@ extern void *dllplugin(const char *lib, const char *name, const char *ver, unsig
             }
             dllsclose(dls);
         }
+        if (dirs) {
+            sfstrclose(dirs);
+            dirs = NULL;
+        }
         if (hit) {
             if (!dll) state.error = err;
             return dll;
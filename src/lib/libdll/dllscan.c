@@ -342,6 +342,7 @@ again:
                     sfprintf(scan->tmp, "%-.*s/%s", scan->pp - scan->pb, scan->pb, *scan->sp);
             }
             scan->sp++;
+            if (scan->dirs) sfprintf(scan->dirs, "%.*s\n", scan->off, sfstrbase(scan->tmp));
             if (!(scan->flags & DLL_MATCH_NAME)) {
                 sfprintf(scan->tmp, "/%s", scan->nam);
                 p = sfstruse(scan->tmp);
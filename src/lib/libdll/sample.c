@@ -1,6 +1,9 @@
 #include "config_ast.h"  // IWYU pragma: keep
 
 #include <stdio.h>
+#include <stdlib.h>
+
+#include "shcmd.h"
 
 // Version of the libast API that plugin is linked to.
 unsigned long plugin_version(void) { return 20131127; }
@@ -13,3 +16,122 @@ int b_sample(int argc, char *argv[]) {
     fflush(stdout);
     return 0;
 }
+
+// The variable access functions of the shell, or NULL if it is too old.
+static const Shapi_t *sample_api(Shbltin_t *context) {
+    if (!context->api || context->api->version < SH_API_VERSION) {
+        fprintf(stderr, "the shell has no plugin API version %d\n", SH_API_VERSION);
+        return NULL;
+    }
+    return context->api;
+}
+
+// The builtins below leave their results in REPLY rather than write them, since their output would
+// not be captured by a command substitution.
+static Namval_t *sample_reply(Shbltin_t *context, int flags) {
+    return (*context->api->open)(context->shp, "REPLY", SH_API_CREATE | flags);
+}
+
+// sample_sum name
+// Set REPLY to the number of elements of an array and the sum of those that are numbers.
+int b_sample_sum(int argc, char *argv[], Shbltin_t *context) {
+    const Shapi_t *api = sample_api(context);
+    Shapi_iter_t it = {.array = NULL};
+    Namval_t *np;
+    double n, sum = 0;
+    long count = 0;
+    char buf[64];
+
+    if (!api || argc != 2) return 2;
+    if (!(it.array = (*api->open)(context->shp, argv[1], 0))) return 1;
+    while ((*api->next)(&it)) {
+        count++;
+        if ((*api->getnum)(it.node, &n)) sum += n;
+    }
+    if (!(np = sample_reply(context, 0))) return 1;
+    snprintf(buf, sizeof(buf), "%ld %.15g", count, sum);
+    (*api->putstr)(np, buf);
+    return 0;
+}
+
+// sample_squares name count
+// Append the squares of 0 through count-1 to an indexed array.
+int b_sample_squares(int argc, char *argv[], Shbltin_t *context) {
+    const Shapi_t *api = sample_api(context);
+    Namval_t *np;
+    int64_t *vals;
+    long i, n;
+
+    if (!api || argc != 3 || (n = strtol(argv[2], NULL, 10)) < 0) return 2;
+    if (!(np = (*api->open)(context->shp, argv[1], SH_API_CREATE | SH_API_INDEXED))) return 1;
+    if (!(vals = malloc(n * sizeof(*vals) + 1))) return 1;
+    for (i = 0; i < n; i++) vals[i] = (int64_t)i * i;
+    i = (*api->appendint)(np, vals, n);
+    free(vals);
+    return i < 0;
+}
+
+// sample_dump name
+// Append a line for the array and one for each of its elements to the array REPLY. An element is
+// shown as subscript (index) =value, or with the members x and y of a compound element.
+int b_sample_dump(int argc, char *argv[], Shbltin_t *context) {
+    const Shapi_t *api = sample_api(context);
+    Shapi_iter_t it = {.array = NULL};
+    Namval_t *np, *mp;
+    const char *val;
+    char buf[256];
+    const char *line = buf;
+    size_t n;
+    int64_t l;
+    int kind;
+
+    if (!api || argc != 2) return 2;
+    if (!(it.array = (*api->open)(context->shp, argv[1], 0))) return 1;
+    if (!(np = sample_reply(context, SH_API_INDEXED))) return 1;
+    kind = (*api->kind)(it.array);
+    snprintf(buf, sizeof(buf), "kind=%d count=%ld", kind & ~SH_API_NUMERIC,
+             (*api->count)(it.array));
+    (*api->append)(np, &line, 1);
+    while ((*api->next)(&it)) {
+        n = snprintf(buf, sizeof(buf), "%s (%ld)", it.sub, it.index);
+        if ((*api->kind)(it.node) == SH_API_COMPOUND) {
+            if ((mp = (*api->member)(it.node, "x", 0)) && (val = (*api->borrow)(mp, NULL))) {
+                n += snprintf(buf + n, sizeof(buf) - n, " x=%s", val);
+            }
+            if ((mp = (*api->member)(it.node, "y", 0)) && (val = (*api->borrow)(mp, NULL))) {
+                n += snprintf(buf + n, sizeof(buf) - n, " y=%s", val);
+            }
+        } else if (kind & SH_API_NUMERIC) {
+            if ((*api->getint)(it.node, &l)) {
+                snprintf(buf + n, sizeof(buf) - n, " =%lld", (long long)l);
+            }
+        } else if ((val = (*api->borrow)(it.node, NULL))) {
+            snprintf(buf + n, sizeof(buf) - n, " =%s", val);
+        }
+        (*api->append)(np, &line, 1);
+    }
+    return 0;
+}
+
+// sample_set name sub value
+// Assign a string to an element of an associative array, or an integer to an element of an
+// indexed array when sub is a number.
+int b_sample_set(int argc, char *argv[], Shbltin_t *context) {
+    const Shapi_t *api = sample_api(context);
+    Namval_t *np;
+    char *cp;
+    long index;
+
+    if (!api || argc != 4) return 2;
+    index = strtol(argv[2], &cp, 10);
+    if (*cp) {
+        np = (*api->open)(context->shp, argv[1], SH_API_CREATE | SH_API_ASSOC);
+        if (!np || !(*api->select)(np, argv[2], 0, SH_API_CREATE)) return 1;
+        (*api->putstr)(np, argv[3]);
+    } else {
+        np = (*api->open)(context->shp, argv[1], SH_API_CREATE | SH_API_INDEXED);
+        if (!np || !(*api->select)(np, NULL, index, SH_API_CREATE)) return 1;
+        (*api->putint)(np, strtoll(argv[3], NULL, 10));
+    }
+    return 0;
+}